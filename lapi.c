@@ -13,6 +13,7 @@
 #include <limits.h>
 #include <stdarg.h>
 #include <string.h>
+#include <time.h>
 
 #include "lua.h"
 
@@ -578,6 +579,36 @@ LUA_API void lua_pushcclosure (lua_State *L, lua_CFunction fn, int n) {
 }
 
 
+/*
+** Pushes a C function 'fn' with a fast version 'ff'. 'sig' gives the
+** kind of each argument of 'ff' (see FARGKINDS), optionally followed
+** by FARGEXTRA.
+*/
+LUA_API void lua_pushfastcfunction (lua_State *L, lua_CFunction fn,
+                                    lua_FastCFunction ff, const char *sig) {
+  CClosure *cl;
+  int n;
+  lua_lock(L);
+  cl = luaF_newCclosure(L, 0);
+  cl->f = fn;
+  cl->ff = ff;
+  for (n = 0; sig[n] != '\0' && sig[n] != FARGEXTRA; n++) {
+    const char *k = strchr(FARGKINDS, sig[n]);
+    api_check(L, k != NULL, "invalid signature for fast function");
+    api_check(L, n < LUA_FASTMAXARGS, "too many arguments for fast function");
+    cl->fsig |= cast(unsigned short, (k - FARGKINDS) << (n * 3));
+  }
+  api_check(L, sig[n] == '\0' || sig[n + 1] == '\0',
+                "invalid signature for fast function");
+  cl->nfargs = cast_byte(n);
+  cl->fvararg = (sig[n] == FARGEXTRA);
+  setclCvalue(L, s2v(L->top), cl);
+  api_incr_top(L);
+  luaC_checkGC(L);
+  lua_unlock(L);
+}
+
+
 LUA_API void lua_pushboolean (lua_State *L, int b) {
   lua_lock(L);
   if (b)
@@ -796,7 +827,7 @@ static void auxsetstr (lua_State *L, const TValue *t, const char *k) {
   const TValue *slot;
   TString *str = luaS_new(L, k);
   api_checknelems(L, 1);
-  if (luaV_fastget(L, t, str, slot, luaH_getstr)) {
+  if (luaV_fastset(L, t, str, slot, luaH_getstr)) {
     luaV_finishfastset(L, t, slot, s2v(L->top - 1));
     L->top--;  /* pop value */
   }
@@ -824,7 +855,7 @@ LUA_API void lua_settable (lua_State *L, int idx) {
   lua_lock(L);
   api_checknelems(L, 2);
   t = index2value(L, idx);
-  if (luaV_fastget(L, t, s2v(L->top - 2), slot, luaH_get)) {
+  if (luaV_fastset(L, t, s2v(L->top - 2), slot, luaH_get)) {
     luaV_finishfastset(L, t, slot, s2v(L->top - 1));
   }
   else
@@ -846,7 +877,7 @@ LUA_API void lua_seti (lua_State *L, int idx, lua_Integer n) {
   lua_lock(L);
   api_checknelems(L, 1);
   t = index2value(L, idx);
-  if (luaV_fastgeti(L, t, n, slot)) {
+  if (luaV_fastseti(L, t, n, slot)) {
     luaV_finishfastset(L, t, slot, s2v(L->top - 1));
   }
   else {
@@ -859,12 +890,24 @@ LUA_API void lua_seti (lua_State *L, int idx, lua_Integer n) {
 }
 
 
+/*
+** Get the table at index 'idx' for a raw modification.
+*/
+static Table *getmodtable (lua_State *L, int idx) {
+  TValue *t = index2value(L, idx);
+  api_check(L, ttistable(t), "table expected");
+  if (unlikely(isfrozen(hvalue(t))))
+    luaG_frozenerror(L, t);
+  return hvalue(t);
+}
+
+
 static void aux_rawset (lua_State *L, int idx, TValue *key, int n) {
   Table *t;
   TValue *slot;
   lua_lock(L);
   api_checknelems(L, n);
-  t = gettable(L, idx);
+  t = getmodtable(L, idx);
   slot = luaH_set(L, t, key);
   setobj2t(L, slot, s2v(L->top - 1));
   invalidateTMcache(t);
@@ -890,7 +933,7 @@ LUA_API void lua_rawseti (lua_State *L, int idx, lua_Integer n) {
   Table *t;
   lua_lock(L);
   api_checknelems(L, 1);
-  t = gettable(L, idx);
+  t = getmodtable(L, idx);
   luaH_setint(L, t, n, s2v(L->top - 1));
   luaC_barrierback(L, obj2gco(t), s2v(L->top - 1));
   L->top--;
@@ -898,6 +941,31 @@ LUA_API void lua_rawseti (lua_State *L, int idx, lua_Integer n) {
 }
 
 
+LUA_API void lua_cleartable (lua_State *L, int idx) {
+  Table *t;
+  lua_lock(L);
+  t = getmodtable(L, idx);
+  luaH_clear(t);
+  lua_unlock(L);
+}
+
+
+LUA_API void lua_freeze (lua_State *L, int idx) {
+  Table *t;
+  lua_lock(L);
+  t = gettable(L, idx);
+  luaH_getn(t);  /* leave a valid 'border' for later length queries */
+  setfrozen(t);
+  lua_unlock(L);
+}
+
+
+LUA_API int lua_isfrozen (lua_State *L, int idx) {
+  const TValue *o = index2value(L, idx);
+  return (ttistable(o) && isfrozen(hvalue(o)));
+}
+
+
 LUA_API int lua_setmetatable (lua_State *L, int objindex) {
   TValue *obj;
   Table *mt;
@@ -912,6 +980,8 @@ LUA_API int lua_setmetatable (lua_State *L, int objindex) {
   }
   switch (ttype(obj)) {
     case LUA_TTABLE: {
+      if (unlikely(isfrozen(hvalue(obj))))
+        luaG_frozenerror(L, obj);
       hvalue(obj)->metatable = mt;
       if (mt) {
         luaC_objbarrier(L, gcvalue(obj), mt);
@@ -1188,6 +1258,48 @@ LUA_API int lua_gc (lua_State *L, int what, ...) {
       luaC_changemode(L, KGC_INC);
       break;
     }
+    case LUA_GCPARALLEL: {
+      int nworkers = va_arg(argp, int);
+#if defined(LUA_USE_PARALLELGC)
+      res = g->gcnworkers;
+      if (nworkers > LUAI_GCMAXWORKERS)
+        nworkers = LUAI_GCMAXWORKERS;
+      if (nworkers > 0)
+        g->gcnworkers = cast_byte(nworkers);
+#else
+      UNUSED(nworkers);  /* no support for parallel marking */
+#endif
+      break;
+    }
+    case LUA_GCDEFERFIN: {
+      int defer = va_arg(argp, int);
+      res = g->gcdeferfin;
+      g->gcdeferfin = (defer != 0);
+      break;
+    }
+    case LUA_GCRUNFINALIZERS: {
+      int n = va_arg(argp, int);
+      res = luaC_runfinalizers(L, n);
+      break;
+    }
+    case LUA_GCFINSTATS: {
+      lua_Number *stats = va_arg(argp, lua_Number *);
+      g->gcfintimed = 1;  /* time finalizers from now on */
+      if (stats != NULL) {
+        stats[0] = cast_num(g->finstats.count);
+        stats[1] = g->finstats.time;
+        stats[2] = g->finstats.maxtime;
+      }
+      res = luaC_countfinalizers(g);
+      break;
+    }
+    case LUA_GCSTACKSHRINK: {
+      int cycles = va_arg(argp, int);
+      res = g->stackshrink;
+      if (cycles > 0)
+        g->stackshrink = cast_byte((cycles > UCHAR_MAX) ? UCHAR_MAX : cycles);
+      break;
+    }
     default: res = -1;  /* invalid option */
   }
   va_end(argp);
@@ -1196,6 +1308,105 @@ LUA_API int lua_gc (lua_State *L, int what, ...) {
 }
 
 
+/*
+** Control of the pool of dead threads kept for reuse. Options that
+** set a value ignore negative 'data' and return the previous value.
+** Changing the stack size empties the pool, as all its threads must
+** have stacks of that size.
+*/
+LUA_API lua_Integer lua_threadpool (lua_State *L, int what, int data) {
+  lua_Integer res = 0;
+  global_State *g;
+  lua_lock(L);
+  g = G(L);
+  switch (what) {
+    case LUA_TPSIZE: {
+      res = g->poolsize;
+      if (data >= 0) {
+        g->poolsize = data;
+        luaE_shrinkpool(L, data);
+      }
+      break;
+    }
+    case LUA_TPSTACK: {
+      res = g->threadstack;
+      if (data >= 0) {
+        if (data < MIN_STACK_SIZE) data = MIN_STACK_SIZE;
+        else if (data > LUAI_MAXSTACK) data = LUAI_MAXSTACK;
+        if (data != g->threadstack) {
+          g->threadstack = data;
+          luaE_shrinkpool(L, 0);
+        }
+      }
+      break;
+    }
+    case LUA_TPCOUNT: {
+      res = g->npooled;
+      break;
+    }
+    case LUA_TPREUSED: {
+      res = l_castU2S(g->nreused);
+      break;
+    }
+    default: res = -1;  /* invalid option */
+  }
+  lua_unlock(L);
+  return res;
+}
+
+
+/*
+** Statistics about the stack of thread 'L'.
+*/
+LUA_API lua_Integer lua_stackinfo (lua_State *L, int what) {
+  lua_Integer res;
+  lua_lock(L);
+  switch (what) {
+    case LUA_STKSIZE: res = stacksize(L); break;
+    case LUA_STKINUSE: res = luaD_stackinuse(L); break;
+    case LUA_STKPEAK: res = L->stackpeak; break;
+    case LUA_STKGROWS: res = L->stackgrows; break;
+    case LUA_STKSHRINKS: res = L->stackshrinks; break;
+    default: res = -1;  /* invalid option */
+  }
+  lua_unlock(L);
+  return res;
+}
+
+
+/*
+** Budget of thread 'L': each backward jump and each call to a Lua
+** function costs one unit. When 'L' runs out of units, it yields or
+** raises an error, according to 'mode'; see 'luaD_outofbudget'.
+*/
+LUA_API void lua_setbudget (lua_State *L, lua_Integer n, int mode) {
+  lua_lock(L);
+  api_check(L, mode == LUA_BUDGETOFF || mode == LUA_BUDGETYIELD ||
+               mode == LUA_BUDGETERROR, "invalid budget mode");
+  if (mode == LUA_BUDGETOFF || n <= 0) {  /* no budget? */
+    mode = LUA_BUDGETOFF;
+    n = MAX_LMEM;  /* run (practically) forever */
+  }
+  else if (n > MAX_LMEM)
+    n = MAX_LMEM;
+  L->budgetmode = cast_byte(mode);
+  L->budgetgrace = 0;
+  L->budget = L->budgetslice = cast(l_mem, n);
+  lua_unlock(L);
+}
+
+
+LUA_API lua_Integer lua_getbudget (lua_State *L, int *mode) {
+  lua_Integer res;
+  lua_lock(L);
+  if (mode)
+    *mode = L->budgetmode;
+  res = (L->budgetmode == LUA_BUDGETOFF) ? 0
+                                         : cast(lua_Integer, L->budget);
+  lua_unlock(L);
+  return res;
+}
+
 
 /*
 ** miscellaneous functions
@@ -1250,6 +1461,16 @@ LUA_API void lua_toclose (lua_State *L, int idx) {
 }
 
 
+LUA_API int lua_setshortlen (lua_State *L, int n) {
+  int res;
+  lua_lock(L);
+  api_check(L, MINSHORTLEN <= n && n <= LIMSHORTLEN, "invalid length");
+  res = luaS_setshortlen(L, n);
+  lua_unlock(L);
+  return res;
+}
+
+
 LUA_API void lua_concat (lua_State *L, int n) {
   lua_lock(L);
   api_checknelems(L, n);
@@ -0,0 +1,893 @@
+/*
+** $Id: lasynclib.c $
+** Asynchronous I/O library (coroutine scheduler over epoll)
+** See Copyright Notice in lua.h
+*/
+
+#define lasynclib_c
+#define LUA_LIB
+
+#include "lprefix.h"
+
+
+#include <errno.h>
+#include <string.h>
+
+#include "lua.h"
+
+#include "lauxlib.h"
+#include "lualib.h"
+
+
+#if defined(LUA_USE_LINUX)	/* { */
+
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+
+
+/* maximum number of events handled by each call to 'epoll_wait' */
+#if !defined(LUA_ASYNCEVENTS)
+#define LUA_ASYNCEVENTS		64
+#endif
+
+/*
+** (On Linux, EWOULDBLOCK is equal to EAGAIN, so all tests for a
+** would-block condition use only EAGAIN.)
+*/
+
+/* minimum free space in a read buffer before each 'read' */
+#define ASYNCCHUNK	LUAL_BUFFERSIZE
+
+
+#define ASYNC_FILE	"async.file"
+
+
+/*
+** The scheduler. It is kept as the first upvalue of all functions in
+** the library. Its first user value is the queue of tasks ready to run
+** and its second user value maps descriptors being waited on to their
+** files (or to the sleeping task, for timers).
+*/
+typedef struct Loop {
+  int epfd;  /* epoll descriptor */
+  int ntasks;  /* number of live tasks */
+  int nwaiting;  /* number of tasks waiting for events */
+  int waited;  /* running task yielded to wait for an event */
+  lua_Integer head, tail;  /* bounds of the ready queue */
+  lua_State *current;  /* task being run (NULL if none) */
+} Loop;
+
+
+/*
+** An asynchronous file. Its first and second user values are the tasks
+** waiting to read and to write it, respectively.
+*/
+typedef struct AFile {
+  int fd;  /* -1 if closed */
+  int issock;  /* socket (use 'send') */
+  int islisten;  /* listening socket */
+  int events;  /* events being waited for in epoll */
+  char *buff;  /* read buffer */
+  size_t first, last, size;  /* pending data is buff[first..last) */
+} AFile;
+
+
+#define LOOPIDX		lua_upvalueindex(1)
+
+#define getloop(L)	((Loop *)lua_touserdata(L, LOOPIDX))
+
+#define tofile(L,i)	((AFile *)luaL_checkudata(L, i, ASYNC_FILE))
+
+
+static AFile *toopenfile (lua_State *L, int idx) {
+  AFile *f = tofile(L, idx);
+  if (f->fd < 0)
+    luaL_error(L, "attempt to use a closed file");
+  return f;
+}
+
+
+static int setnonblock (int fd) {
+  int fl = fcntl(fd, F_GETFL);
+  return (fl < 0 || fcntl(fd, F_SETFL, fl | O_NONBLOCK) < 0 ||
+          fcntl(fd, F_SETFD, FD_CLOEXEC) < 0) ? -1 : 0;
+}
+
+
+/*
+** {======================================================
+** Scheduler
+** =======================================================
+*/
+
+/* the epoll descriptor is created only when first needed */
+static int getepfd (lua_State *L, Loop *lp) {
+  if (lp->epfd < 0) {
+    lp->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (lp->epfd < 0)
+      luaL_error(L, "cannot create epoll descriptor: %s", strerror(errno));
+  }
+  return lp->epfd;
+}
+
+
+/* push thread at index 'idx' into the ready queue */
+static void enqueue (lua_State *L, Loop *lp, int idx) {
+  idx = lua_absindex(L, idx);
+  lua_getiuservalue(L, LOOPIDX, 1);
+  lua_pushvalue(L, idx);
+  lua_seti(L, -2, lp->tail++);
+  lua_pop(L, 1);
+}
+
+
+/* wake the task waiting in slot 'slot' of file at index 'idx', if any */
+static void wakeslot (lua_State *L, Loop *lp, int idx, int slot) {
+  idx = lua_absindex(L, idx);
+  if (lua_getiuservalue(L, idx, slot) == LUA_TTHREAD) {
+    enqueue(L, lp, -1);
+    lp->nwaiting--;
+    lua_pushnil(L);
+    lua_setiuservalue(L, idx, slot);
+  }
+  lua_pop(L, 1);
+}
+
+
+/*
+** Changes the events being waited for file 'f' (at index 'idx').
+*/
+static void setevents (lua_State *L, Loop *lp, AFile *f, int idx,
+                                                int events) {
+  struct epoll_event ev;
+  int op;
+  if (events == f->events)
+    return;  /* nothing to change */
+  else if (f->events == 0)
+    op = EPOLL_CTL_ADD;
+  else if (events == 0)
+    op = EPOLL_CTL_DEL;
+  else
+    op = EPOLL_CTL_MOD;
+  ev.events = events;
+  ev.data.fd = f->fd;
+  if (epoll_ctl(getepfd(L, lp), op, f->fd, &ev) < 0)
+    luaL_error(L, "cannot wait for file: %s", strerror(errno));
+  idx = lua_absindex(L, idx);
+  lua_getiuservalue(L, LOOPIDX, 2);
+  if (events == 0) lua_pushnil(L);
+  else lua_pushvalue(L, idx);
+  lua_seti(L, -2, f->fd);
+  lua_pop(L, 1);
+  f->events = events;
+}
+
+
+/*
+** Waits until file 'f' (at index 'idx') is ready for 'ev' ('EPOLLIN' or
+** 'EPOLLOUT'). The running task yields to the scheduler and does not
+** return from here: it retries the operation in continuation 'k'.
+** Outside a task, this call just blocks and then returns, so that the
+** caller retries the operation itself.
+*/
+static void waitfile (lua_State *L, AFile *f, int idx, int ev,
+                      lua_KContext ctx, lua_KFunction k) {
+  Loop *lp = getloop(L);
+  int slot = (ev == EPOLLIN) ? 1 : 2;
+  if (lp->current != L) {  /* not called from a task? */
+    struct pollfd p;
+    p.fd = f->fd;
+    p.events = (ev == EPOLLIN) ? POLLIN : POLLOUT;
+    while (poll(&p, 1, -1) < 0 && errno == EINTR) { /* retry */ }
+    return;
+  }
+  idx = lua_absindex(L, idx);
+  if (lua_getiuservalue(L, idx, slot) != LUA_TNIL)
+    luaL_error(L, "file already in use by another task");
+  lua_pop(L, 1);
+  setevents(L, lp, f, idx, f->events | ev);
+  lua_pushthread(L);
+  lua_setiuservalue(L, idx, slot);
+  lp->nwaiting++;
+  lp->waited = 1;
+  lua_yieldk(L, 0, ctx, k);
+}
+
+
+/*
+** Handles one event from 'epoll_wait'
+*/
+static void dispatch (lua_State *L, Loop *lp, struct epoll_event *e) {
+  lua_getiuservalue(L, LOOPIDX, 2);
+  switch (lua_geti(L, -1, e->data.fd)) {
+    case LUA_TTHREAD: {  /* a timer expired */
+      close(e->data.fd);
+      enqueue(L, lp, -1);
+      lp->nwaiting--;
+      lua_pushnil(L);
+      lua_seti(L, -3, e->data.fd);
+      break;
+    }
+    case LUA_TUSERDATA: {
+      AFile *f = (AFile *)lua_touserdata(L, -1);
+      int ready = (int)e->events & (EPOLLIN | EPOLLOUT);
+      if (e->events & (EPOLLERR | EPOLLHUP))
+        ready = f->events;  /* wake everybody */
+      if (ready & EPOLLIN) wakeslot(L, lp, -1, 1);
+      if (ready & EPOLLOUT) wakeslot(L, lp, -1, 2);
+      setevents(L, lp, f, -1, f->events & ~ready);
+      break;
+    }
+    default: break;  /* file closed before its event was handled */
+  }
+  lua_pop(L, 2);
+}
+
+
+/*
+** Runs the task at the top of the stack until it yields or finishes.
+*/
+static void runtask (lua_State *L, Loop *lp) {
+  lua_State *co = lua_tothread(L, -1);
+  int nargs = 0, nres, status;
+  if (lua_status(co) == LUA_OK)  /* not started yet? */
+    nargs = lua_gettop(co) - 1;  /* arguments from 'spawn' */
+  lp->current = co;
+  lp->waited = 0;
+  status = lua_resume(co, L, nargs, &nres);
+  lp->current = NULL;
+  if (status == LUA_YIELD) {
+    lua_pop(co, nres);
+    if (!lp->waited)  /* a plain yield? */
+      enqueue(L, lp, -1);  /* give other tasks a chance to run */
+  }
+  else {
+    lp->ntasks--;
+    if (status != LUA_OK) {  /* error in the task? */
+      lua_xmove(co, L, 1);  /* move error message */
+      lua_resetthread(co);  /* close its tbc variables */
+      lua_error(L);  /* propagate error */
+    }
+    lua_pop(co, nres);
+  }
+}
+
+
+static int async_run (lua_State *L) {
+  Loop *lp = getloop(L);
+  struct epoll_event evs[LUA_ASYNCEVENTS];
+  if (lp->current != NULL)
+    return luaL_error(L, "cannot run the scheduler from inside a task");
+  lua_getiuservalue(L, LOOPIDX, 1);  /* ready queue */
+  for (;;) {
+    int i, n;
+    while (lp->head < lp->tail) {  /* run all ready tasks */
+      lua_geti(L, -1, lp->head);
+      lua_pushnil(L);
+      lua_seti(L, -3, lp->head++);
+      runtask(L, lp);
+      lua_pop(L, 1);  /* remove task */
+    }
+    lp->head = lp->tail = 1;  /* queue is empty */
+    if (lp->ntasks == 0)
+      break;
+    else if (lp->nwaiting == 0)
+      return luaL_error(L, "tasks suspended outside the scheduler");
+    n = epoll_wait(lp->epfd, evs, LUA_ASYNCEVENTS, -1);
+    if (n < 0 && errno != EINTR)  /* EINTR: 'n' is not used */
+      return luaL_error(L, "epoll_wait: %s", strerror(errno));
+    for (i = 0; i < n; i++)
+      dispatch(L, lp, &evs[i]);
+  }
+  return 0;
+}
+
+
+static int async_spawn (lua_State *L) {
+  Loop *lp = getloop(L);
+  int n = lua_gettop(L);
+  lua_State *co;
+  luaL_checktype(L, 1, LUA_TFUNCTION);
+  co = lua_newthread(L);
+  lua_rotate(L, 1, 1);  /* move thread below function and arguments */
+  lua_xmove(L, co, n);  /* move function and arguments to the task */
+  enqueue(L, lp, 1);
+  lp->ntasks++;
+  return 1;
+}
+
+
+static int async_sleep (lua_State *L) {
+  Loop *lp = getloop(L);
+  lua_Number t = luaL_checknumber(L, 1);
+  struct itimerspec its;
+  struct epoll_event ev;
+  int tfd;
+  luaL_argcheck(L, t <= 1e9, 1, "out of range");
+  if (t <= 0) {  /* just give other tasks a chance to run */
+    if (lp->current != L) return 0;
+    lp->waited = 0;
+    return lua_yield(L, 0);
+  }
+  memset(&its, 0, sizeof(its));
+  its.it_value.tv_sec = (time_t)t;
+  its.it_value.tv_nsec = (long)((t - (lua_Number)its.it_value.tv_sec) * 1e9);
+  if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0)
+    its.it_value.tv_nsec = 1;  /* 0 would disarm the timer */
+  if (lp->current != L) {  /* not called from a task? */
+    while (nanosleep(&its.it_value, &its.it_value) < 0 && errno == EINTR)
+      { /* continue sleeping */ }
+    return 0;
+  }
+  tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (tfd < 0)
+    return luaL_fileresult(L, 0, NULL);
+  ev.events = EPOLLIN;
+  ev.data.fd = tfd;
+  if (timerfd_settime(tfd, 0, &its, NULL) < 0 ||
+      epoll_ctl(getepfd(L, lp), EPOLL_CTL_ADD, tfd, &ev) < 0) {
+    int en = errno;
+    close(tfd);
+    errno = en;
+    return luaL_fileresult(L, 0, NULL);
+  }
+  lua_getiuservalue(L, LOOPIDX, 2);
+  lua_pushthread(L);
+  lua_seti(L, -2, tfd);  /* timer wakes this task */
+  lua_pop(L, 1);
+  lp->nwaiting++;
+  lp->waited = 1;
+  return lua_yield(L, 0);
+}
+
+
+static int async_running (lua_State *L) {
+  Loop *lp = getloop(L);
+  lua_pushboolean(L, lp->current == L);
+  lua_pushinteger(L, lp->ntasks);
+  return 2;
+}
+
+
+static int loop_gc (lua_State *L) {
+  Loop *lp = (Loop *)lua_touserdata(L, 1);
+  if (lp->epfd >= 0) {
+    lua_getiuservalue(L, 1, 2);
+    lua_pushnil(L);
+    while (lua_next(L, -2)) {  /* close pending timers */
+      if (lua_isthread(L, -1))
+        close((int)lua_tointeger(L, -2));
+      lua_pop(L, 1);
+    }
+    close(lp->epfd);
+    lp->epfd = -1;
+  }
+  return 0;
+}
+
+/* }====================================================== */
+
+
+/*
+** {======================================================
+** Files
+** =======================================================
+*/
+
+static AFile *anewfile (lua_State *L, int fd, int issock) {
+  AFile *f = (AFile *)lua_newuserdatauv(L, sizeof(AFile), 2);
+  f->fd = fd;
+  f->issock = issock;
+  f->islisten = 0;
+  f->events = 0;
+  f->buff = NULL;
+  f->first = f->last = f->size = 0;
+  luaL_setmetatable(L, ASYNC_FILE);
+  return f;
+}
+
+
+static void freebuff (lua_State *L, AFile *f) {
+  void *ud;
+  lua_Alloc allocf = lua_getallocf(L, &ud);
+  allocf(ud, f->buff, f->size, 0);
+  f->buff = NULL;
+  f->first = f->last = f->size = 0;
+}
+
+
+/*
+** Reads more data into the buffer of 'f'. Returns 1 if it read
+** something, 0 at end of file, -1 if the read would block, and
+** -2 on errors.
+*/
+static int fillbuff (lua_State *L, AFile *f) {
+  ssize_t r;
+  if (f->first > 0) {  /* move pending data to the beginning */
+    memmove(f->buff, f->buff + f->first, f->last - f->first);
+    f->last -= f->first;
+    f->first = 0;
+  }
+  if (f->size - f->last < ASYNCCHUNK) {  /* not enough space? */
+    void *ud;
+    lua_Alloc allocf = lua_getallocf(L, &ud);
+    size_t newsize = (f->size == 0) ? ASYNCCHUNK : f->size * 2;
+    char *nb = (char *)allocf(ud, f->buff, f->size, newsize);
+    if (nb == NULL)
+      luaL_error(L, "not enough memory");
+    f->buff = nb;
+    f->size = newsize;
+  }
+  do {
+    r = read(f->fd, f->buff + f->last, f->size - f->last);
+  } while (r < 0 && errno == EINTR);
+  if (r > 0) {
+    f->last += (size_t)r;
+    return 1;
+  }
+  else if (r == 0)
+    return 0;
+  else if (errno == EAGAIN)
+    return -1;
+  else
+    return -2;
+}
+
+
+/* push 'n' bytes from the buffer, skipping 'skip' more bytes after them */
+static void pushbuff (lua_State *L, AFile *f, size_t n, size_t skip) {
+  lua_pushlstring(L, f->buff + f->first, n);
+  f->first += n + skip;
+  if (f->first == f->last)
+    f->first = f->last = 0;
+}
+
+
+/*
+** Reads one format. Returns 1 if it pushed a result, 0 at end of
+** file (pushing nothing), and the (negative) results from 'fillbuff'
+** otherwise.
+*/
+static int readformat (lua_State *L, AFile *f, int arg) {
+  for (;;) {
+    size_t avail = f->last - f->first;
+    int r;
+    if (lua_type(L, arg) == LUA_TNUMBER) {
+      size_t n = (size_t)luaL_checkinteger(L, arg);
+      if (avail > 0 || n == 0) {
+        pushbuff(L, f, (n < avail) ? n : avail, 0);
+        return 1;
+      }
+    }
+    else {
+      const char *p = luaL_checkstring(L, arg);
+      if (*p == '*') p++;  /* skip optional '*' (for compatibility) */
+      switch (*p) {
+        case 'l': case 'L': {
+          const char *nl = (avail > 0)
+                         ? (const char *)memchr(f->buff + f->first, '\n', avail)
+                         : NULL;
+          if (nl != NULL) {
+            size_t len = (size_t)(nl - (f->buff + f->first));
+            if (*p == 'L') pushbuff(L, f, len + 1, 0);
+            else pushbuff(L, f, len, 1);
+            return 1;
+          }
+          break;
+        }
+        case 'a': break;  /* read until end of file */
+        default:
+          return luaL_argerror(L, arg, "invalid format");
+      }
+      r = fillbuff(L, f);
+      if (r == 0) {  /* end of file? */
+        avail = f->last - f->first;
+        if (*p != 'a' && avail == 0)
+          return 0;  /* no line */
+        pushbuff(L, f, avail, 0);  /* last line or whole contents */
+        return 1;
+      }
+      else if (r < 0)
+        return r;
+      continue;
+    }
+    r = fillbuff(L, f);
+    if (r <= 0)
+      return r;
+  }
+}
+
+
+/*
+** Continuation for 'read'. The stack has the file, the formats, and
+** the results already read; 'ctx' is the number of results.
+*/
+static int readk (lua_State *L, int status, lua_KContext ctx) {
+  AFile *f = toopenfile(L, 1);
+  int nfmt = lua_gettop(L) - 1 - (int)ctx;
+  int i;
+  (void)status;
+  for (i = (int)ctx; i < nfmt; i++) {
+    int r;
+    while ((r = readformat(L, f, 2 + i)) == -1)  /* would block? */
+      waitfile(L, f, 1, EPOLLIN, i, readk);
+    if (r == -2)
+      return luaL_fileresult(L, 0, NULL);
+    else if (r == 0) {  /* end of file */
+      luaL_pushfail(L);
+      return i + 1;
+    }
+  }
+  return nfmt;
+}
+
+
+static int af_read (lua_State *L) {
+  toopenfile(L, 1);
+  if (lua_gettop(L) == 1)  /* no formats? */
+    lua_pushliteral(L, "l");  /* read a line */
+  return readk(L, LUA_OK, 0);
+}
+
+
+/*
+** Continuation for 'write'; 'ctx' is the number of bytes already
+** written from all arguments.
+*/
+static int writek (lua_State *L, int status, lua_KContext ctx) {
+  AFile *f = toopenfile(L, 1);
+  int n = lua_gettop(L);
+  size_t skip = (size_t)ctx;
+  int arg;
+  (void)status;
+  for (arg = 2; arg <= n; arg++) {
+    size_t l;
+    const char *s = luaL_checklstring(L, arg, &l);
+    while (skip < l) {
+      ssize_t r;
+      if (f->issock)
+        r = send(f->fd, s + skip, l - skip, MSG_NOSIGNAL);
+      else
+        r = write(f->fd, s + skip, l - skip);
+      if (r >= 0) {
+        skip += (size_t)r;
+        ctx += r;
+      }
+      else if (errno == EAGAIN)
+        waitfile(L, f, 1, EPOLLOUT, ctx, writek);
+      else if (errno != EINTR)
+        return luaL_fileresult(L, 0, NULL);
+    }
+    skip -= l;
+  }
+  lua_settop(L, 1);  /* return file */
+  return 1;
+}
+
+
+static int af_write (lua_State *L) {
+  toopenfile(L, 1);
+  return writek(L, LUA_OK, 0);
+}
+
+
+static int acceptk (lua_State *L, int status, lua_KContext ctx) {
+  AFile *f = toopenfile(L, 1);
+  int fd;
+  (void)status;
+  luaL_argcheck(L, f->islisten, 1, "not a listening socket");
+  while ((fd = accept(f->fd, NULL, NULL)) < 0) {
+    if (errno == EAGAIN)
+      waitfile(L, f, 1, EPOLLIN, ctx, acceptk);
+    else if (errno != EINTR && errno != ECONNABORTED)
+      return luaL_fileresult(L, 0, NULL);
+  }
+  if (setnonblock(fd) < 0) {
+    int en = errno;
+    close(fd);
+    errno = en;
+    return luaL_fileresult(L, 0, NULL);
+  }
+  anewfile(L, fd, 1);
+  return 1;
+}
+
+
+static int af_accept (lua_State *L) {
+  return acceptk(L, LUA_OK, 0);
+}
+
+
+static int aaux_close (lua_State *L, AFile *f) {
+  if (f->events != 0) {  /* tasks waiting for it? */
+    Loop *lp = getloop(L);
+    wakeslot(L, lp, 1, 1);  /* they will find a closed file */
+    wakeslot(L, lp, 1, 2);
+    setevents(L, lp, f, 1, 0);
+  }
+  freebuff(L, f);
+  return luaL_fileresult(L, close(f->fd) == 0, NULL);
+}
+
+
+static int af_close (lua_State *L) {
+  AFile *f = toopenfile(L, 1);
+  int res = aaux_close(L, f);
+  f->fd = -1;
+  return res;
+}
+
+
+static int af_tbcclose (lua_State *L) {
+  AFile *f = tofile(L, 1);
+  if (f->fd >= 0) {
+    aaux_close(L, f);
+    f->fd = -1;
+  }
+  return 0;
+}
+
+
+static int af_gc (lua_State *L) {
+  AFile *f = tofile(L, 1);
+  if (f->fd >= 0) {
+    close(f->fd);  /* it cannot be waited for when collected */
+    f->fd = -1;
+  }
+  freebuff(L, f);
+  return 0;
+}
+
+
+static int af_fileno (lua_State *L) {
+  lua_pushinteger(L, toopenfile(L, 1)->fd);
+  return 1;
+}
+
+
+static int af_tostring (lua_State *L) {
+  AFile *f = tofile(L, 1);
+  if (f->fd < 0)
+    lua_pushliteral(L, "async file (closed)");
+  else
+    lua_pushfstring(L, "async file (%p)", (void *)f);
+  return 1;
+}
+
+/* }====================================================== */
+
+
+/*
+** {======================================================
+** Creating files
+** =======================================================
+*/
+
+static int async_pipe (lua_State *L) {
+  int fds[2];
+  if (pipe(fds) < 0)
+    return luaL_fileresult(L, 0, NULL);
+  if (setnonblock(fds[0]) < 0 || setnonblock(fds[1]) < 0) {
+    int en = errno;
+    close(fds[0]); close(fds[1]);
+    errno = en;
+    return luaL_fileresult(L, 0, NULL);
+  }
+  anewfile(L, fds[0], 0);
+  anewfile(L, fds[1], 0);
+  return 2;
+}
+
+
+static int async_socketpair (lua_State *L) {
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+    return luaL_fileresult(L, 0, NULL);
+  if (setnonblock(fds[0]) < 0 || setnonblock(fds[1]) < 0) {
+    int en = errno;
+    close(fds[0]); close(fds[1]);
+    errno = en;
+    return luaL_fileresult(L, 0, NULL);
+  }
+  anewfile(L, fds[0], 1);
+  anewfile(L, fds[1], 1);
+  return 2;
+}
+
+
+static int async_fdopen (lua_State *L) {
+  int fd = (int)luaL_checkinteger(L, 1);
+  int type;
+  socklen_t len = sizeof(type);
+  if (setnonblock(fd) < 0)
+    return luaL_fileresult(L, 0, NULL);
+  anewfile(L, fd, getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &len) == 0);
+  return 1;
+}
+
+
+/*
+** Creates a Unix socket and fills 'addr' with the path at index 1.
+*/
+static int unixsocket (lua_State *L, struct sockaddr_un *addr) {
+  size_t l;
+  const char *path = luaL_checklstring(L, 1, &l);
+  int fd;
+  luaL_argcheck(L, l < sizeof(addr->sun_path), 1, "path too long");
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  memcpy(addr->sun_path, path, l);
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd >= 0 && setnonblock(fd) < 0) {
+    int en = errno;
+    close(fd);
+    errno = en;
+    fd = -1;
+  }
+  return fd;
+}
+
+
+static int sockfail (lua_State *L, int fd) {
+  int en = errno;
+  close(fd);
+  errno = en;
+  return luaL_fileresult(L, 0, lua_tostring(L, 1));
+}
+
+
+static int async_listen (lua_State *L) {
+  struct sockaddr_un addr;
+  int backlog = (int)luaL_optinteger(L, 2, SOMAXCONN);
+  int fd = unixsocket(L, &addr);
+  if (fd < 0)
+    return luaL_fileresult(L, 0, NULL);
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+      listen(fd, backlog) < 0)
+    return sockfail(L, fd);
+  anewfile(L, fd, 1)->islisten = 1;
+  return 1;
+}
+
+
+/*
+** Continuation for 'connect', after the socket became writable. The
+** stack has the path and the new file.
+*/
+static int connectk (lua_State *L, int status, lua_KContext ctx) {
+  AFile *f = toopenfile(L, 2);
+  int err;
+  socklen_t len = sizeof(err);
+  (void)status; (void)ctx;
+  if (getsockopt(f->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0)
+    err = errno;
+  if (err != 0) {
+    close(f->fd);
+    f->fd = -1;
+    errno = err;
+    return luaL_fileresult(L, 0, lua_tostring(L, 1));
+  }
+  return 1;
+}
+
+
+static int async_connect (lua_State *L) {
+  struct sockaddr_un addr;
+  int fd = unixsocket(L, &addr);
+  lua_settop(L, 1);
+  if (fd < 0)
+    return luaL_fileresult(L, 0, NULL);
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    if (errno != EINPROGRESS)
+      return sockfail(L, fd);
+    waitfile(L, anewfile(L, fd, 1), 2, EPOLLOUT, 0, connectk);
+    return connectk(L, LUA_OK, 0);
+  }
+  anewfile(L, fd, 1);
+  return 1;
+}
+
+/* }====================================================== */
+
+
+static const luaL_Reg async_funcs[] = {
+  {"spawn", async_spawn},
+  {"run", async_run},
+  {"sleep", async_sleep},
+  {"running", async_running},
+  {"pipe", async_pipe},
+  {"socketpair", async_socketpair},
+  {"fdopen", async_fdopen},
+  {"listen", async_listen},
+  {"connect", async_connect},
+  {NULL, NULL}
+};
+
+
+/*
+** methods for files
+*/
+static const luaL_Reg ameth[] = {
+  {"read", af_read},
+  {"write", af_write},
+  {"accept", af_accept},
+  {"close", af_close},
+  {"fileno", af_fileno},
+  {NULL, NULL}
+};
+
+
+/*
+** metamethods for files
+*/
+static const luaL_Reg ametameth[] = {
+  {"__index", NULL},  /* place holder */
+  {"__gc", af_gc},
+  {"__close", af_tbcclose},
+  {"__tostring", af_tostring},
+  {NULL, NULL}
+};
+
+
+static void createloop (lua_State *L) {
+  Loop *lp = (Loop *)lua_newuserdatauv(L, sizeof(Loop), 2);
+  lp->epfd = -1;
+  lp->ntasks = lp->nwaiting = lp->waited = 0;
+  lp->head = lp->tail = 1;
+  lp->current = NULL;
+  lua_createtable(L, 0, 1);  /* metatable for the loop */
+  lua_pushcfunction(L, loop_gc);
+  lua_setfield(L, -2, "__gc");
+  lua_setmetatable(L, -2);
+  lua_newtable(L);  /* ready queue */
+  lua_setiuservalue(L, -2, 1);
+  lua_newtable(L);  /* waited descriptors */
+  lua_setiuservalue(L, -2, 2);
+}
+
+
+LUAMOD_API int luaopen_async (lua_State *L) {
+  luaL_newlibtable(L, async_funcs);
+  createloop(L);
+  luaL_newmetatable(L, ASYNC_FILE);  /* metatable for files */
+  lua_pushvalue(L, -2);  /* loop is an upvalue for all functions */
+  luaL_setfuncs(L, ametameth, 1);
+  luaL_newlibtable(L, ameth);  /* method table */
+  lua_pushvalue(L, -3);  /* loop */
+  luaL_setfuncs(L, ameth, 1);
+  lua_setfield(L, -2, "__index");
+  lua_pop(L, 1);  /* pop metatable */
+  luaL_setfuncs(L, async_funcs, 1);  /* pops loop */
+  return 1;
+}
+
+#else				/* }{ */
+
+/*
+** Without epoll, the library exists but all its functions fail.
+*/
+static int notavailable (lua_State *L) {
+  return luaL_error(L, "async library not available on this platform");
+}
+
+
+LUAMOD_API int luaopen_async (lua_State *L) {
+  static const char *const names[] = {"spawn", "run", "sleep", "running",
+    "pipe", "socketpair", "fdopen", "listen", "connect", NULL};
+  int i;
+  lua_newtable(L);
+  for (i = 0; names[i] != NULL; i++) {
+    lua_pushcfunction(L, notavailable);
+    lua_setfield(L, -2, names[i]);
+  }
+  return 1;
+}
+
+#endif				/* } */
+
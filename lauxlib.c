@@ -918,6 +918,17 @@ LUALIB_API void luaL_setfuncs (lua_State *L, const luaL_Reg *l, int nup) {
 }
 
 
+/*
+** set functions with fast versions from list 'l' into table at top
+*/
+LUALIB_API void luaL_setfastfuncs (lua_State *L, const luaL_FastReg *l) {
+  for (; l->name != NULL; l++) {
+    lua_pushfastcfunction(L, l->func, l->fast, l->sig);
+    lua_setfield(L, -2, l->name);
+  }
+}
+
+
 /*
 ** ensure that stack[idx][fname] has a table and push that table
 ** into the stack
@@ -40,6 +40,14 @@ typedef struct luaL_Reg {
 } luaL_Reg;
 
 
+typedef struct luaL_FastReg {
+  const char *name;
+  lua_CFunction func;
+  lua_FastCFunction fast;  /* fast version of 'func' */
+  const char *sig;  /* signature of 'fast' */
+} luaL_FastReg;
+
+
 #define LUAL_NUMSIZES	(sizeof(lua_Integer)*16 + sizeof(lua_Number))
 
 LUALIB_API void (luaL_checkversion_) (lua_State *L, lua_Number ver, size_t sz);
@@ -107,6 +115,7 @@ LUALIB_API const char *(luaL_gsub) (lua_State *L, const char *s,
                                     const char *p, const char *r);
 
 LUALIB_API void (luaL_setfuncs) (lua_State *L, const luaL_Reg *l, int nup);
+LUALIB_API void (luaL_setfastfuncs) (lua_State *L, const luaL_FastReg *l);
 
 LUALIB_API int (luaL_getsubtable) (lua_State *L, int idx, const char *fname);
 
@@ -202,6 +211,31 @@ LUALIB_API char *(luaL_buffinitsize) (lua_State *L, luaL_Buffer *B, size_t sz);
 
 
 
+/*
+** {======================================================
+** String buffers
+** =======================================================
+*/
+
+#define LUA_STRBUFHANDLE	"STRBUF*"
+
+
+/*
+** A string buffer (created by 'string.buffer') is a userdata with
+** metatable 'LUA_STRBUFHANDLE' and initial structure 'luaL_StrBuf'.
+** Its memory comes from the state's allocation function and is kept
+** when the buffer is reset.
+*/
+typedef struct luaL_StrBuf {
+  char *b;  /* buffer address (NULL if there is no memory) */
+  size_t size;  /* buffer size */
+  size_t n;  /* number of characters in buffer */
+} luaL_StrBuf;
+
+/* }====================================================== */
+
+
+
 /*
 ** {======================================================
 ** File handles for IO library
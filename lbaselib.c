@@ -190,10 +190,12 @@ static int pushmode (lua_State *L, int oldmode) {
 static int luaB_collectgarbage (lua_State *L) {
   static const char *const opts[] = {"stop", "restart", "collect",
     "count", "step", "setpause", "setstepmul",
-    "isrunning", "generational", "incremental", NULL};
+    "isrunning", "generational", "incremental", "parallel",
+    "deferfinalizers", "runfinalizers", "finalizers", "stackshrink", NULL};
   static const int optsnum[] = {LUA_GCSTOP, LUA_GCRESTART, LUA_GCCOLLECT,
     LUA_GCCOUNT, LUA_GCSTEP, LUA_GCSETPAUSE, LUA_GCSETSTEPMUL,
-    LUA_GCISRUNNING, LUA_GCGEN, LUA_GCINC};
+    LUA_GCISRUNNING, LUA_GCGEN, LUA_GCINC, LUA_GCPARALLEL,
+    LUA_GCDEFERFIN, LUA_GCRUNFINALIZERS, LUA_GCFINSTATS, LUA_GCSTACKSHRINK};
   int o = optsnum[luaL_checkoption(L, 1, "collect", opts)];
   switch (o) {
     case LUA_GCCOUNT: {
@@ -209,7 +211,9 @@ static int luaB_collectgarbage (lua_State *L) {
       return 1;
     }
     case LUA_GCSETPAUSE:
-    case LUA_GCSETSTEPMUL: {
+    case LUA_GCSETSTEPMUL:
+    case LUA_GCPARALLEL:
+    case LUA_GCSTACKSHRINK: {
       int p = (int)luaL_optinteger(L, 2, 0);
       int previous = lua_gc(L, o, p);
       lua_pushinteger(L, previous);
@@ -231,6 +235,25 @@ static int luaB_collectgarbage (lua_State *L) {
       int stepsize = (int)luaL_optinteger(L, 4, 0);
       return pushmode(L, lua_gc(L, o, pause, stepmul, stepsize));
     }
+    case LUA_GCDEFERFIN: {
+      int defer = lua_toboolean(L, 2);
+      lua_pushboolean(L, lua_gc(L, o, defer));
+      return 1;
+    }
+    case LUA_GCRUNFINALIZERS: {
+      int n = (int)luaL_optinteger(L, 2, 0);
+      lua_pushinteger(L, lua_gc(L, o, n));
+      return 1;
+    }
+    case LUA_GCFINSTATS: {
+      lua_Number stats[3];
+      int pending = lua_gc(L, o, stats);
+      lua_pushinteger(L, pending);
+      lua_pushinteger(L, (lua_Integer)stats[0]);
+      lua_pushnumber(L, stats[1]);
+      lua_pushnumber(L, stats[2]);
+      return 4;
+    }
     default: {
       int res = lua_gc(L, o);
       lua_pushinteger(L, res);
@@ -429,6 +452,30 @@ static int luaB_select (lua_State *L) {
 }
 
 
+/*
+** Fast version of 'select': 'v[1].i' is the number of values after
+** the selector; a selector that is not '#' or an integer, or an index
+** out of range, goes to the regular version.
+*/
+static int fast_select (lua_FastValue *v) {
+  lua_Integer n = v[1].i;
+  if (v[0].str.s != NULL) {  /* string? */
+    if (*v[0].str.s != '#')
+      return LUA_FASTFAIL;
+    v[0].i = n;
+    return LUA_FASTINT;
+  }
+  else {
+    lua_Integer i = v[0].i;
+    if (i < 0) i = n + 1 + i;
+    if (i < 1)
+      return LUA_FASTFAIL;
+    v[0].i = i;  /* values from the i-th one after the selector */
+    return LUA_FASTEXTRA;
+  }
+}
+
+
 /*
 ** Continuation function for 'pcall' and 'xpcall'. Both functions
 ** already pushed a 'true' before doing the call, so in case of success
@@ -516,6 +563,8 @@ LUAMOD_API int luaopen_base (lua_State *L) {
   /* open lib into global table */
   lua_pushglobaltable(L);
   luaL_setfuncs(L, base_funcs, 0);
+  lua_pushfastcfunction(L, luaB_select, fast_select, "x*");
+  lua_setfield(L, -2, "select");
   /* set global _G */
   lua_pushvalue(L, -1);
   lua_setfield(L, -2, LUA_GNAME);
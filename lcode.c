@@ -1783,6 +1783,34 @@ static int finaltarget (Instruction *code, int i) {
 }
 
 
+/*
+** Fuse pairs of consecutive instructions into superinstructions (see
+** 'luaP_fusedops'). Only the opcode of the first instruction changes,
+** and all first components fall through to the next instruction.
+** Superinstructions can be turned off by defining LUAI_NOFUSEOPS;
+** the interpreter runs fused code either way.
+*/
+static void fuseops (FuncState *fs) {
+#if !defined(LUAI_NOFUSEOPS)
+  Proto *p = fs->f;
+  int i;
+  for (i = 0; i + 1 < fs->pc; i++) {
+    OpCode op1 = GET_OPCODE(p->code[i]);
+    OpCode op2 = GET_OPCODE(p->code[i + 1]);
+    int f;
+    for (f = 0; f < NUM_FUSEDOPS; f++) {
+      if (luaP_fusedops[f][0] == op1 && luaP_fusedops[f][1] == op2) {
+        SET_OPCODE(p->code[i], FIRSTFUSEDOP + f);
+        break;
+      }
+    }
+  }
+#else
+  UNUSED(fs);
+#endif
+}
+
+
 /*
 ** Do a final pass over the code of a function, doing small peephole
 ** optimizations and adjustments.
@@ -1815,4 +1843,5 @@ void luaK_finish (FuncState *fs) {
       default: break;
     }
   }
+  fuseops(fs);
 }
@@ -10,6 +10,7 @@
 #include "lprefix.h"
 
 
+#include <limits.h>
 #include <stdlib.h>
 
 #include "lua.h"
@@ -186,6 +187,83 @@ static int luaB_close (lua_State *L) {
 }
 
 
+/*
+** pool([size [, stacksize]]) -> size, stacksize, count, reused
+*/
+static int luaB_pool (lua_State *L) {
+  lua_Integer size = luaL_optinteger(L, 1, -1);
+  lua_Integer stacksize = luaL_optinteger(L, 2, -1);
+  luaL_argcheck(L, -1 <= size && size <= INT_MAX, 1, "out of range");
+  luaL_argcheck(L, -1 <= stacksize && stacksize <= INT_MAX, 2,
+                   "out of range");
+  lua_threadpool(L, LUA_TPSIZE, (int)size);
+  lua_threadpool(L, LUA_TPSTACK, (int)stacksize);
+  lua_pushinteger(L, lua_threadpool(L, LUA_TPSIZE, -1));
+  lua_pushinteger(L, lua_threadpool(L, LUA_TPSTACK, -1));
+  lua_pushinteger(L, lua_threadpool(L, LUA_TPCOUNT, 0));
+  lua_pushinteger(L, lua_threadpool(L, LUA_TPREUSED, 0));
+  return 4;
+}
+
+
+/*
+** stackinfo([co]) -> table with statistics about the stack of 'co'
+*/
+static int luaB_stackinfo (lua_State *L) {
+  static const char *const names[] = {"size", "inuse", "peak", "grows",
+                                      "shrinks"};
+  static const int opts[] = {LUA_STKSIZE, LUA_STKINUSE, LUA_STKPEAK,
+                             LUA_STKGROWS, LUA_STKSHRINKS};
+  lua_State *co = lua_isnone(L, 1) ? L : getco(L);
+  int i;
+  lua_createtable(L, 0, 5);
+  for (i = 0; i < 5; i++) {
+    lua_pushinteger(L, lua_stackinfo(co, opts[i]));
+    lua_setfield(L, -2, names[i]);
+  }
+  return 1;
+}
+
+
+static const char *const budgetmodes[] = {"yield", "error", NULL};
+
+
+/*
+** setbudget([co,] n [, mode]) -> nil
+** A nil 'n' removes the budget of 'co'.
+*/
+static int luaB_setbudget (lua_State *L) {
+  int arg = lua_isthread(L, 1);
+  lua_State *co = arg ? getco(L) : L;
+  if (lua_isnoneornil(L, arg + 1))
+    lua_setbudget(co, 0, LUA_BUDGETOFF);
+  else {
+    lua_Integer n = luaL_checkinteger(L, arg + 1);
+    int mode = luaL_checkoption(L, arg + 2, "yield", budgetmodes);
+    luaL_argcheck(L, n > 0, arg + 1, "out of range");
+    lua_setbudget(co, n, (mode == 0) ? LUA_BUDGETYIELD : LUA_BUDGETERROR);
+  }
+  return 0;
+}
+
+
+/*
+** getbudget([co]) -> units left, mode  (or nil if there is no budget)
+*/
+static int luaB_getbudget (lua_State *L) {
+  lua_State *co = lua_isnone(L, 1) ? L : getco(L);
+  int mode;
+  lua_Integer n = lua_getbudget(co, &mode);
+  if (mode == LUA_BUDGETOFF) {
+    luaL_pushfail(L);
+    return 1;
+  }
+  lua_pushinteger(L, n);
+  lua_pushstring(L, budgetmodes[(mode == LUA_BUDGETYIELD) ? 0 : 1]);
+  return 2;
+}
+
+
 static const luaL_Reg co_funcs[] = {
   {"create", luaB_cocreate},
   {"resume", luaB_coresume},
@@ -195,6 +273,10 @@ static const luaL_Reg co_funcs[] = {
   {"yield", luaB_yield},
   {"isyieldable", luaB_yieldable},
   {"close", luaB_close},
+  {"pool", luaB_pool},
+  {"stackinfo", luaB_stackinfo},
+  {"setbudget", luaB_setbudget},
+  {"getbudget", luaB_getbudget},
   {NULL, NULL}
 };
 
@@ -21,6 +21,7 @@
 #include "ldebug.h"
 #include "ldo.h"
 #include "lfunc.h"
+#include "lgc.h"
 #include "lobject.h"
 #include "lopcodes.h"
 #include "lstate.h"
@@ -29,6 +30,10 @@
 #include "ltm.h"
 #include "lvm.h"
 
+#if defined(LUA_VMSTATS)
+#include "lopnames.h"
+#endif
+
 
 
 #define noLuaClosure(f)		((f) == NULL || (f)->c.tt == LUA_VCCL)
@@ -469,11 +474,11 @@ static int findsetreg (const Proto *p, int lastpc, int reg) {
   int pc;
   int setreg = -1;  /* keep last instruction that changed 'reg' */
   int jmptarget = 0;  /* any code before this address is conditional */
-  if (testMMMode(GET_OPCODE(p->code[lastpc])))
+  if (testMMMode(GET_BASEOP(p->code[lastpc])))
     lastpc--;  /* previous instruction was not actually executed */
   for (pc = 0; pc < lastpc; pc++) {
     Instruction i = p->code[pc];
-    OpCode op = GET_OPCODE(i);
+    OpCode op = GET_BASEOP(i);
     int a = GETARG_A(i);
     int change;  /* true if current instruction changed 'reg' */
     switch (op) {
@@ -536,7 +541,7 @@ static const char *getobjname (const Proto *p, int lastpc, int reg,
   pc = findsetreg(p, lastpc, reg);
   if (pc != -1) {  /* could find instruction? */
     Instruction i = p->code[pc];
-    OpCode op = GET_OPCODE(i);
+    OpCode op = GET_BASEOP(i);
     switch (op) {
       case OP_MOVE: {
         int b = GETARG_B(i);  /* move from 'b' to 'a' */
@@ -604,7 +609,7 @@ static const char *funcnamefromcode (lua_State *L, CallInfo *ci,
     *name = "?";
     return "hook";
   }
-  switch (GET_OPCODE(i)) {
+  switch (GET_BASEOP(i)) {
     case OP_CALL:
     case OP_TAILCALL:
       return getobjname(p, pc, GETARG_A(i), name);  /* get function name */
@@ -697,6 +702,11 @@ l_noret luaG_typeerror (lua_State *L, const TValue *o, const char *op) {
 }
 
 
+l_noret luaG_frozenerror (lua_State *L, const TValue *o) {
+  luaG_runerror(L, "attempt to modify a frozen table%s", varinfo(L, o));
+}
+
+
 l_noret luaG_forerror (lua_State *L, const TValue *o, const char *what) {
   luaG_runerror(L, "bad 'for' %s (number expected, got %s)",
                    what, luaT_objtypename(L, o));
@@ -850,3 +860,133 @@ int luaG_traceexec (lua_State *L, const Instruction *pc) {
   return 1;  /* keep 'trap' on */
 }
 
+
+
+/*
+** {======================================================
+** Execution statistics (see LUA_VMSTATS)
+** =======================================================
+*/
+
+#if defined(LUA_VMSTATS)
+
+/*
+** Visit all live prototypes. Prototypes are never finalized, so they
+** all live in list 'allgc'; dead ones stay there until swept.
+*/
+#define forallprotos(g,o)  \
+	for (o = (g)->allgc; o != NULL; o = o->next) \
+	  if (o->tt == LUA_VPROTO && !isdead(g, o))
+
+
+/*
+** Returns the number of executions of opcode 'op' and its name, or -1
+** if there is no such opcode.
+*/
+LUA_API lua_Integer lua_vmopcount (lua_State *L, int op, const char **name) {
+  lua_Integer res = -1;
+  lua_lock(L);
+  if (0 <= op && op < NUM_OPCODES) {
+    if (name)
+      *name = opnames[op];
+    res = l_castU2S(G(L)->opcount[op]);
+  }
+  lua_unlock(L);
+  return res;
+}
+
+
+/*
+** Make room for a new spot with 'count' in list 's' (with '*n' entries,
+** at most 'max'), kept in decreasing order of counts. Returns NULL if
+** the count is not among the largest ones.
+*/
+static lua_VMSpot *addspot (lua_VMSpot *s, int *n, int max, lu_mem count) {
+  int i;
+  if (count == 0 || (*n == max && count <= l_castS2U(s[max - 1].count)))
+    return NULL;  /* not hot enough */
+  if (*n < max) (*n)++;
+  for (i = *n - 1; i > 0 && l_castS2U(s[i - 1].count) < count; i--)
+    s[i] = s[i - 1];  /* open space for new entry */
+  s[i].count = l_castU2S(count);
+  return &s[i];
+}
+
+
+/* fill the description of instruction 'pc' of 'p' (or 'p' if 'pc' < 0) */
+static void setspot (lua_VMSpot *s, const Proto *p, int pc) {
+  if (p->source == NULL)
+    strcpy(s->short_src, "?");
+  else
+    luaO_chunkid(s->short_src, getstr(p->source), tsslen(p->source));
+  s->pc = pc + 1;
+  if (pc < 0) {
+    s->line = p->linedefined;
+    s->op = NULL;
+  }
+  else {
+    s->line = luaG_getfuncline(p, pc);
+    s->op = opnames[GET_OPCODE(p->code[pc])];
+  }
+}
+
+
+/*
+** Fill 's' with the (at most) 'max' most executed instructions or, if
+** 'calls', most called functions, in decreasing order. Sets '*total'
+** to the sum of all their counts. Returns the number of entries. (It
+** does not allocate memory, so the collector cannot run meanwhile.)
+*/
+LUA_API int lua_vmspots (lua_State *L, lua_VMSpot *s, int max, int calls,
+                         lua_Integer *total) {
+  global_State *g;
+  GCObject *o;
+  lu_mem sum = 0;
+  int n = 0;
+  lua_lock(L);
+  api_check(L, max > 0, "invalid number of entries");
+  g = G(L);
+  forallprotos(g, o) {
+    Proto *p = gco2p(o);
+    lua_VMSpot *e;
+    if (calls) {
+      sum += p->ncalls;
+      if ((e = addspot(s, &n, max, p->ncalls)) != NULL)
+        setspot(e, p, -1);
+    }
+    else if (p->execcount != NULL) {
+      int pc;
+      for (pc = 0; pc < p->sizecode; pc++) {
+        sum += p->execcount[pc];
+        if ((e = addspot(s, &n, max, p->execcount[pc])) != NULL)
+          setspot(e, p, pc);
+      }
+    }
+  }
+  if (total)
+    *total = l_castU2S(sum);
+  lua_unlock(L);
+  return n;
+}
+
+
+LUA_API void lua_vmreset (lua_State *L) {
+  global_State *g;
+  GCObject *o;
+  lua_lock(L);
+  g = G(L);
+  memset(g->opcount, 0, sizeof(g->opcount));
+  for (o = g->allgc; o != NULL; o = o->next) {
+    if (o->tt == LUA_VPROTO) {
+      Proto *p = gco2p(o);
+      p->ncalls = 0;
+      if (p->execcount != NULL)
+        memset(p->execcount, 0, p->sizecode * sizeof(lu_mem));
+    }
+  }
+  lua_unlock(L);
+}
+
+#endif
+
+/* }====================================================== */
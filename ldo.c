@@ -196,6 +196,8 @@ int luaD_reallocstack (lua_State *L, int newsize, int raiseerror) {
   correctstack(L, L->stack, newstack);
   L->stack = newstack;
   L->stack_last = L->stack + newsize;
+  if (newsize > L->stackpeak)
+    L->stackpeak = newsize;
   return 1;
 }
 
@@ -222,6 +224,8 @@ int luaD_growstack (lua_State *L, int n, int raiseerror) {
       newsize = LUAI_MAXSTACK;
     if (newsize < needed)  /* but must respect what was asked for */
       newsize = needed;
+    L->stackcycles = 0;  /* stack is not oversized anymore */
+    L->stackgrows++;
     if (likely(newsize <= LUAI_MAXSTACK))
       return luaD_reallocstack(L, newsize, raiseerror);
     else {  /* stack overflow */
@@ -235,7 +239,7 @@ int luaD_growstack (lua_State *L, int n, int raiseerror) {
 }
 
 
-static int stackinuse (lua_State *L) {
+int luaD_stackinuse (lua_State *L) {
   CallInfo *ci;
   int res;
   StkId lim = L->top;
@@ -258,9 +262,13 @@ static int stackinuse (lua_State *L) {
 ** it is not, 'max' (limited by LUAI_MAXSTACK) will be smaller than
 ** stacksize (equal to ERRORSTACKSIZE in this case), and so the stack
 ** will be reduced to a "regular" size.
+** When called by the collector ('fromgc'), the stack shrinks only after
+** it has been found oversized in 'g->stackshrink' consecutive cycles,
+** so that threads whose depth oscillates do not keep reallocating their
+** stacks and CallInfo lists. (Any growth restarts that count.)
 */
-void luaD_shrinkstack (lua_State *L) {
-  int inuse = stackinuse(L);
+void luaD_shrinkstack (lua_State *L, int fromgc) {
+  int inuse = luaD_stackinuse(L);
   int nsize = inuse * 2;  /* proposed new size */
   int max = inuse * 3;  /* maximum "reasonable" size */
   if (max > LUAI_MAXSTACK) {
@@ -270,10 +278,18 @@ void luaD_shrinkstack (lua_State *L) {
   }
   /* if thread is currently not handling a stack overflow and its
      size is larger than maximum "reasonable" size, shrink it */
-  if (inuse <= LUAI_MAXSTACK && stacksize(L) > max)
-    luaD_reallocstack(L, nsize, 0);  /* ok if that fails */
-  else  /* don't change stack */
+  if (inuse <= LUAI_MAXSTACK && stacksize(L) > max) {
+    if (fromgc && stacksize(L) <= LUAI_MAXSTACK &&
+        ++L->stackcycles < G(L)->stackshrink)
+      return;  /* wait more cycles (keeping the CI list, too) */
+    L->stackcycles = 0;
+    if (luaD_reallocstack(L, nsize, 0))  /* ok if that fails */
+      L->stackshrinks++;
+  }
+  else {  /* don't change stack */
+    L->stackcycles = 0;
     condmovestack(L,{},{});  /* (change only for debugging) */
+  }
   luaE_shrinkCI(L);  /* shrink CI list */
 }
 
@@ -454,8 +470,10 @@ void luaD_pretailcall (lua_State *L, CallInfo *ci, StkId func, int narg1) {
   int fsize = p->maxstacksize;  /* frame size */
   int nfixparams = p->numparams;
   int i;
-  for (i = 0; i < narg1; i++)  /* move down function and arguments */
-    setobjs2s(L, ci->func + i, func + i);
+  if (func != ci->func) {  /* not in place yet? */
+    for (i = 0; i < narg1; i++)  /* move down function and arguments */
+      setobjs2s(L, ci->func + i, func + i);
+  }
   checkstackGC(L, fsize);
   func = ci->func;  /* moved-down function */
   for (; narg1 <= nfixparams; narg1++)
@@ -464,6 +482,7 @@ void luaD_pretailcall (lua_State *L, CallInfo *ci, StkId func, int narg1) {
   lua_assert(ci->top <= L->stack_last);
   ci->u.l.savedpc = p->code;  /* starting point */
   ci->callstatus |= CIST_TAIL;
+  luaF_countcall(p);
   L->top = func + narg1;  /* set top */
 }
 
@@ -522,6 +541,7 @@ CallInfo *luaD_precall (lua_State *L, StkId func, int nresults) {
       for (; narg < nfixparams; narg++)
         setnilvalue(s2v(L->top++));  /* complete missing arguments */
       lua_assert(ci->top <= L->stack_last);
+      luaF_countcall(p);
       return ci;
     }
     default: {  /* not a function */
@@ -533,6 +553,106 @@ CallInfo *luaD_precall (lua_State *L, StkId func, int nresults) {
 }
 
 
+/*
+** Tries to call the fast version of the C function at 'func', which
+** runs without a CallInfo. Its fixed arguments go from 'func + 1' to
+** the top; its 'nextra' extra arguments (if it accepts them) start at
+** 'extra', which can be anywhere in the stack outside the call.
+** Arguments are unboxed according to the function signature; returns
+** 0 if they do not match it or if the fast version declines the call,
+** so that the caller must do a regular call instead. Otherwise, leaves
+** the results at 'func' like 'moveresults' and returns 1.
+*/
+int luaD_fastcallv (lua_State *L, StkId func, int nresults,
+                    StkId extra, int nextra) {
+  CClosure *cl = clCvalue(s2v(func));
+  int nargs = cast_int(L->top - func) - 1;
+  lua_FastValue v[LUA_FASTMAXARGS + 1];
+  int i, nres;
+  if (nargs != cl->nfargs || (nextra > 0 && !cl->fvararg))
+    return 0;
+  for (i = 0; i < nargs; i++) {
+    const TValue *arg = s2v(func + 1 + i);
+    switch (getfarg(cl->fsig, i)) {
+      case FARGINT:
+        if (!ttisinteger(arg)) return 0;
+        v[i].i = ivalue(arg);
+        break;
+      case FARGFLT:
+        if (!ttisfloat(arg)) return 0;
+        v[i].n = fltvalue(arg);
+        break;
+      case FARGNUM:
+        if (ttisfloat(arg)) v[i].n = fltvalue(arg);
+        else if (ttisinteger(arg)) v[i].n = cast_num(ivalue(arg));
+        else return 0;
+        break;
+      case FARGINTSTR:
+        if (ttisinteger(arg)) {
+          v[i].i = ivalue(arg);
+          v[i].str.s = NULL;
+          break;
+        }
+        /* else must be a string */  /* FALLTHROUGH */
+      default:
+        if (!ttisstring(arg)) return 0;
+        v[i].str.s = svalue(arg);
+        v[i].str.l = tsslen(tsvalue(arg));
+        break;
+    }
+  }
+  v[nargs].i = nextra;
+  switch (cl->ff(v)) {
+    case LUA_FASTINT: setivalue(s2v(func), v[0].i); nres = 1; break;
+    case LUA_FASTFLT: setfltvalue(s2v(func), v[0].n); nres = 1; break;
+    case LUA_FASTEXTRA: {  /* results are extra arguments */
+      lua_Integer k = v[0].i;  /* first extra argument to be returned */
+      lua_assert(cl->fvararg && 1 <= k);
+      nres = (k > nextra) ? 0 : nextra - cast_int(k) + 1;
+      extra += nextra - nres;
+      if (nresults == LUA_MULTRET && extra < func) {  /* results below? */
+        ptrdiff_t fr = savestack(L, func);
+        ptrdiff_t er = savestack(L, extra);
+        L->top = func;
+        luaD_checkstack(L, nres);  /* ensure space for all results */
+        func = restorestack(L, fr);
+        extra = restorestack(L, er);
+      }
+      for (i = 0; i < nres && i != nresults; i++)  /* move results */
+        setobjs2s(L, func + i, extra + i);
+      break;
+    }
+    default: return 0;
+  }
+  if (nresults == LUA_MULTRET)
+    nresults = nres;
+  for (i = nres; i < nresults; i++)  /* complete wanted number of results */
+    setnilvalue(s2v(func + i));
+  L->top = func + nresults;  /* top points after the last result */
+  return 1;
+}
+
+
+/*
+** Tries to call the fast version of the C function at 'func', with
+** all arguments from 'func + 1' to the top.
+*/
+int luaD_fastcall (lua_State *L, StkId func, int nresults) {
+  CClosure *cl = clCvalue(s2v(func));
+  int nextra = cast_int(L->top - func) - 1 - cl->nfargs;
+  if (nextra <= 0)  /* no extra arguments? */
+    return luaD_fastcallv(L, func, nresults, NULL, 0);
+  else {
+    StkId extra = L->top - nextra;
+    L->top = extra;  /* fixed arguments end at the extra ones */
+    if (luaD_fastcallv(L, func, nresults, extra, nextra))
+      return 1;
+    L->top = extra + nextra;  /* restore top for a regular call */
+    return 0;
+  }
+}
+
+
 /*
 ** Call a function (C or Lua) through C. 'inc' can be 1 (increment
 ** number of recursive invocations in the C stack) or nyci (the same
@@ -646,7 +766,7 @@ static int recover (lua_State *L, int status) {
   status = luaF_close(L, oldtop, status);  /* may change the stack */
   oldtop = restorestack(L, ci->u2.funcidx);
   luaD_seterrorobj(L, status, oldtop);
-  luaD_shrinkstack(L);   /* restore stack size in case of overflow */
+  luaD_shrinkstack(L, 0);   /* restore stack size in case of overflow */
   L->errfunc = ci->u.c.old_errfunc;
   return 1;  /* continue running the coroutine */
 }
@@ -683,7 +803,7 @@ static void resume (lua_State *L, void *ud) {
     lua_assert(L->status == LUA_YIELD);
     L->status = LUA_OK;  /* mark that it is running (again) */
     luaE_incCstack(L);  /* control the C stack */
-    if (isLua(ci))  /* yielded inside a hook? */
+    if (isLua(ci))  /* yielded inside a hook or out of budget? */
       luaV_execute(L, ci);  /* just continue running Lua code */
     else {  /* 'common' yield */
       if (ci->u.c.k != NULL) {  /* does it have a continuation function? */
@@ -738,6 +858,40 @@ LUA_API int lua_isyieldable (lua_State *L) {
 }
 
 
+/*
+** Called by the interpreter when the running thread has spent its
+** budget, at a point where it can stop: after a backward jump or at
+** the entry of a Lua function. In mode 'error', the first time the
+** budget runs out the thread gets a small grace allowance, so that the
+** message handler and the '__close' metamethods of the error can run;
+** after that, the budget stays exhausted, so that the error repeats
+** at every new charge until someone resets the budget. In mode
+** 'yield', the thread gets a new slice and, if it can, yields with no
+** values, as if from a hook. (If it cannot yield, it just goes on.)
+*/
+void luaD_outofbudget (lua_State *L) {
+  if (L->budgetmode == LUA_BUDGETERROR) {
+    if (!L->budgetgrace) {
+      L->budgetgrace = 1;
+      L->budget = LUAI_BUDGETGRACE;
+    }
+    else
+      L->budget = 0;
+    luaG_runerror(L, "instruction budget exhausted");
+  }
+  L->budget = L->budgetslice;
+  if (L->budgetmode == LUA_BUDGETYIELD && yieldable(L)) {
+    CallInfo *ci = L->ci;
+    Proto *p = ci_func(ci)->p;
+    if (ci->u.l.savedpc == p->code && !p->is_vararg)
+      L->budget++;  /* resume will charge the function entry again */
+    L->status = LUA_YIELD;
+    ci->u2.nyield = 0;  /* no results */
+    luaD_throw(L, LUA_YIELD);
+  }
+}
+
+
 LUA_API int lua_yieldk (lua_State *L, int nresults, lua_KContext ctx,
                         lua_KFunction k) {
   CallInfo *ci;
@@ -789,7 +943,7 @@ int luaD_pcall (lua_State *L, Pfunc func, void *u,
     status = luaF_close(L, oldtop, status);
     oldtop = restorestack(L, old_top);  /* previous call may change stack */
     luaD_seterrorobj(L, status, oldtop);
-    luaD_shrinkstack(L);   /* restore stack size in case of overflow */
+    luaD_shrinkstack(L, 0);   /* restore stack size in case of overflow */
   }
   L->errfunc = old_errfunc;
   return status;
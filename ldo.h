@@ -49,6 +49,15 @@
 	luaD_checkstackaux(L, (fsize), luaC_checkGC(L), (void)0)
 
 
+/*
+** Check whether the call of 'func' can try its fast version: it must
+** be a C function with a fast version and there can be no hooks.
+*/
+#define luaD_isfastcall(L,func)  \
+	(ttisCclosure(s2v(func)) && clCvalue(s2v(func))->ff != NULL && \
+	 L->hookmask == 0)
+
+
 /* type of protected functions, to be ran by 'runprotected' */
 typedef void (*Pfunc) (lua_State *L, void *ud);
 
@@ -58,8 +67,12 @@ LUAI_FUNC int luaD_protectedparser (lua_State *L, ZIO *z, const char *name,
 LUAI_FUNC void luaD_hook (lua_State *L, int event, int line,
                                         int fTransfer, int nTransfer);
 LUAI_FUNC void luaD_hookcall (lua_State *L, CallInfo *ci);
+LUAI_FUNC void luaD_outofbudget (lua_State *L);
 LUAI_FUNC void luaD_pretailcall (lua_State *L, CallInfo *ci, StkId func, int n);
 LUAI_FUNC CallInfo *luaD_precall (lua_State *L, StkId func, int nResults);
+LUAI_FUNC int luaD_fastcallv (lua_State *L, StkId func, int nResults,
+                                            StkId extra, int nextra);
+LUAI_FUNC int luaD_fastcall (lua_State *L, StkId func, int nResults);
 LUAI_FUNC void luaD_call (lua_State *L, StkId func, int nResults);
 LUAI_FUNC void luaD_callnoyield (lua_State *L, StkId func, int nResults);
 LUAI_FUNC void luaD_tryfuncTM (lua_State *L, StkId func);
@@ -68,7 +81,8 @@ LUAI_FUNC int luaD_pcall (lua_State *L, Pfunc func, void *u,
 LUAI_FUNC void luaD_poscall (lua_State *L, CallInfo *ci, int nres);
 LUAI_FUNC int luaD_reallocstack (lua_State *L, int newsize, int raiseerror);
 LUAI_FUNC int luaD_growstack (lua_State *L, int n, int raiseerror);
-LUAI_FUNC void luaD_shrinkstack (lua_State *L);
+LUAI_FUNC void luaD_shrinkstack (lua_State *L, int fromgc);
+LUAI_FUNC int luaD_stackinuse (lua_State *L);
 LUAI_FUNC void luaD_inctop (lua_State *L);
 
 LUAI_FUNC l_noret luaD_throw (lua_State *L, int errcode);
@@ -11,6 +11,7 @@
 
 
 #include <stddef.h>
+#include <string.h>
 
 #include "lua.h"
 
@@ -28,6 +29,9 @@ CClosure *luaF_newCclosure (lua_State *L, int nupvals) {
   GCObject *o = luaC_newobj(L, LUA_VCCL, sizeCclosure(nupvals));
   CClosure *c = gco2ccl(o);
   c->nupvalues = cast_byte(nupvals);
+  c->nfargs = c->fvararg = 0;
+  c->fsig = 0;
+  c->ff = NULL;
   return c;
 }
 
@@ -266,10 +270,27 @@ Proto *luaF_newproto (lua_State *L) {
   f->linedefined = 0;
   f->lastlinedefined = 0;
   f->source = NULL;
+#if defined(LUA_VMSTATS)
+  f->execcount = NULL;
+  f->ncalls = 0;
+#endif
   return f;
 }
 
 
+#if defined(LUA_VMSTATS)
+/*
+** Create the execution counters for a function, after its code is
+** complete.
+*/
+void luaF_newcounters (lua_State *L, Proto *f) {
+  lua_assert(f->execcount == NULL);
+  f->execcount = luaM_newvector(L, f->sizecode, lu_mem);
+  memset(f->execcount, 0, f->sizecode * sizeof(lu_mem));
+}
+#endif
+
+
 void luaF_freeproto (lua_State *L, Proto *f) {
   luaM_freearray(L, f->code, f->sizecode);
   luaM_freearray(L, f->p, f->sizep);
@@ -278,6 +299,10 @@ void luaF_freeproto (lua_State *L, Proto *f) {
   luaM_freearray(L, f->abslineinfo, f->sizeabslineinfo);
   luaM_freearray(L, f->locvars, f->sizelocvars);
   luaM_freearray(L, f->upvalues, f->sizeupvalues);
+#if defined(LUA_VMSTATS)
+  if (f->execcount != NULL)  /* counters were created? */
+    luaM_freearray(L, f->execcount, f->sizecode);
+#endif
   luaM_free(L, f);
 }
 
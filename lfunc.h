@@ -18,6 +18,25 @@
                          cast_int(sizeof(TValue *)) * (n))
 
 
+/*
+** Kinds of arguments of fast C functions, as they appear in their
+** signatures; 'fsig' in a C closure keeps the kind of each argument
+** in three bits. A final FARGEXTRA in a signature means that the
+** function accepts any number of extra arguments.
+*/
+#define FARGKINDS	"ifnsx"
+
+#define FARGINT		0	/* integer */
+#define FARGFLT		1	/* float */
+#define FARGNUM		2	/* any number, converted to a float */
+#define FARGSTR		3	/* string */
+#define FARGINTSTR	4	/* integer or string */
+
+#define FARGEXTRA	'*'
+
+#define getfarg(sig,i)	(((sig) >> ((i) * 3)) & 7)
+
+
 /* test whether thread is in 'twups' list */
 #define isintwups(L)	(L->twups != L)
 
@@ -65,5 +84,13 @@ LUAI_FUNC void luaF_freeproto (lua_State *L, Proto *f);
 LUAI_FUNC const char *luaF_getlocalname (const Proto *func, int local_number,
                                          int pc);
 
+#if defined(LUA_VMSTATS)
+LUAI_FUNC void luaF_newcounters (lua_State *L, Proto *f);
+#define luaF_countcall(p)	((p)->ncalls++)
+#else
+#define luaF_newcounters(L,f)	((void)0)
+#define luaF_countcall(p)	((void)0)
+#endif
+
 
 #endif
@@ -11,6 +11,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 
 
 #include "lua.h"
@@ -632,6 +633,12 @@ static int traversethread (global_State *g, lua_State *th) {
   for (uv = th->openupval; uv != NULL; uv = uv->u.open.next)
     markobject(g, uv);  /* open upvalues cannot be collected */
   if (g->gcstate == GCSatomic) {  /* final traversal? */
+    /* each thread has exactly one atomic traversal per cycle, in both
+       modes; do not change stack in emergency cycle */
+    if (!g->gcemergency) {
+      luaD_shrinkstack(th, 1);
+      o = th->top;  /* stack may have moved */
+    }
     for (; o < th->stack_last + EXTRA_STACK; o++)
       setnilvalue(s2v(o));  /* clear dead stack slice */
     /* 'remarkupvals' may have removed thread from 'twups' list */
@@ -640,8 +647,6 @@ static int traversethread (global_State *g, lua_State *th) {
       g->twups = th;
     }
   }
-  else if (!g->gcemergency)
-    luaD_shrinkstack(th); /* do not change stack in emergency cycle */
   return 1 + stacksize(th);
 }
 
@@ -665,8 +670,376 @@ static lu_mem propagatemark (global_State *g) {
 }
 
 
+
+/*
+** {======================================================
+** Parallel marking
+** =======================================================
+*/
+
+#if defined(LUA_USE_PARALLELGC)
+
+#include <pthread.h>
+
+/*
+** Minimum memory in use for the collector to use parallel marking.
+** (Below that, the cost of starting the threads is not worth it.)
+*/
+#if !defined(LUAI_GCPARMINMEM)
+#define LUAI_GCPARMINMEM	(cast(lu_mem, 1) << 24)  /* 16 MB */
+#endif
+
+/* maximum number of gray objects moved at once to/from the pool */
+#define GCPARBATCH	64
+
+
+/*
+** Parallel marking works only on full atomic traversals of the
+** incremental collector. (In generational mode, ages must be
+** maintained by the traversals; emergency collections must not
+** depend on creating threads.)
+*/
+#define markinparallel(g)  \
+	((g)->gcnworkers > 1 && !(g)->gcemergency && \
+	 (g)->gckind == KGC_INC && (g)->gray != NULL && \
+	 gettotalbytes(g) >= LUAI_GCPARMINMEM)
+
+
+/*
+** Colors are changed with atomic operations while marking in
+** parallel. Other bits in 'marked' are not changed during the
+** parallel phase.
+*/
+#define loadmarked(o)	__atomic_load_n(&(o)->marked, __ATOMIC_RELAXED)
+#define pset2black(o)  \
+	__atomic_fetch_or(&(o)->marked, bitmask(BLACKBIT), __ATOMIC_RELAXED)
+
+
+typedef struct GCPar {
+  global_State *g;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  GCObject *pool;  /* shared list of gray objects */
+  int nidle;  /* number of workers waiting for work (see 'sharework') */
+  int nworkers;  /* number of running workers */
+} GCPar;
+
+
+typedef struct GCWorker {
+  GCPar *par;
+  GCObject *gray;  /* private list of gray objects */
+  int ngray;  /* number of elements in 'gray' */
+  GCObject *deferred;  /* objects left for the main thread */
+  lu_mem work;  /* work done by this worker */
+  pthread_t thread;
+} GCWorker;
+
+
+static void pushgray (GCWorker *w, GCObject *o) {
+  *getgclist(o) = w->gray;
+  w->gray = o;
+  w->ngray++;
+}
+
+
+/*
+** Parallel version of 'reallymarkobject'. Each object is atomically
+** claimed (turned from white to gray) by exactly one worker, which
+** will traverse it.
+*/
+static void pmarkobject (GCWorker *w, GCObject *o) {
+  lu_byte old = loadmarked(o);
+  lu_byte newm;
+  int leaf;  /* true if object can go directly to black */
+  switch (o->tt) {
+    case LUA_VSHRSTR: case LUA_VLNGSTR: leaf = 1; break;
+    case LUA_VUPVAL: leaf = !upisopen(gco2upv(o)); break;
+    case LUA_VUSERDATA: leaf = (gco2u(o)->nuvalue == 0); break;
+    default: leaf = 0; break;
+  }
+  do {
+    if (!(old & WHITEBITS))
+      return;  /* already claimed by someone */
+    newm = cast_byte(old & ~maskcolors);  /* gray */
+    if (leaf)
+      newm |= bitmask(BLACKBIT);
+  } while (!__atomic_compare_exchange_n(&o->marked, &old, newm, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+  switch (o->tt) {
+    case LUA_VUPVAL: {
+      TValue *v = gco2upv(o)->v;
+      if (iscollectable(v))
+        pmarkobject(w, gcvalue(v));
+      break;
+    }
+    case LUA_VUSERDATA: {
+      Udata *u = gco2u(o);
+      if (leaf) {
+        if (u->metatable)
+          pmarkobject(w, obj2gco(u->metatable));
+      }
+      else
+        pushgray(w, o);
+      break;
+    }
+    case LUA_VLCL: case LUA_VCCL: case LUA_VTABLE:
+    case LUA_VTHREAD: case LUA_VPROTO: {
+      pushgray(w, o);
+      break;
+    }
+    default: break;  /* strings: nothing else to do */
+  }
+}
+
+
+#define pmarkvalue(w,v)  \
+	{ if (iscollectable(v)) pmarkobject(w, gcvalue(v)); }
+
+#define pmarkobjectN(w,o)	{ if (o) pmarkobject(w, obj2gco(o)); }
+
+
+/*
+** Tables with a '__mode' field go to the main thread. (The metatable
+** is searched without 'gfasttm', which would update its cache.)
+*/
+static int pisweak (global_State *g, Table *h) {
+  Table *mt = h->metatable;
+  return (mt != NULL && !(mt->flags & (1u << TM_MODE)) &&
+          ttisstring(luaH_getshortstr(mt, g->tmname[TM_MODE])));
+}
+
+
+/*
+** Traverse gray object 'o'. Threads and weak tables, whose traversals
+** change global structures, are deferred to the main thread (still
+** gray); everything else is traversed like in the sequential
+** collector.
+*/
+static void ptraverse (GCWorker *w, GCObject *o) {
+  lu_mem work;
+  switch (o->tt) {
+    case LUA_VTABLE: {
+      Table *h = gco2t(o);
+      Node *n, *limit = gnodelast(h);
+      unsigned int i;
+      unsigned int asize = luaH_realasize(h);
+      if (pisweak(w->par->g, h))
+        goto defer;
+      pmarkobjectN(w, h->metatable);
+      for (i = 0; i < asize; i++)
+        pmarkvalue(w, &h->array[i]);
+      for (n = gnode(h, 0); n < limit; n++) {
+        if (isempty(gval(n)))  /* entry is empty? */
+          clearkey(n);  /* clear its key */
+        else {
+          if (keyiscollectable(n))
+            pmarkobject(w, gckey(n));
+          pmarkvalue(w, gval(n));
+        }
+      }
+      work = 1 + h->alimit + 2 * allocsizenode(h);
+      break;
+    }
+    case LUA_VUSERDATA: {
+      Udata *u = gco2u(o);
+      int i;
+      pmarkobjectN(w, u->metatable);
+      for (i = 0; i < u->nuvalue; i++)
+        pmarkvalue(w, &u->uv[i].uv);
+      work = 1 + u->nuvalue;
+      break;
+    }
+    case LUA_VLCL: {
+      LClosure *cl = gco2lcl(o);
+      int i;
+      pmarkobjectN(w, cl->p);
+      for (i = 0; i < cl->nupvalues; i++)
+        pmarkobjectN(w, cl->upvals[i]);
+      work = 1 + cl->nupvalues;
+      break;
+    }
+    case LUA_VCCL: {
+      CClosure *cl = gco2ccl(o);
+      int i;
+      for (i = 0; i < cl->nupvalues; i++)
+        pmarkvalue(w, &cl->upvalue[i]);
+      work = 1 + cl->nupvalues;
+      break;
+    }
+    case LUA_VPROTO: {
+      Proto *f = gco2p(o);
+      int i;
+      pmarkobjectN(w, f->source);
+      for (i = 0; i < f->sizek; i++)
+        pmarkvalue(w, &f->k[i]);
+      for (i = 0; i < f->sizeupvalues; i++)
+        pmarkobjectN(w, f->upvalues[i].name);
+      for (i = 0; i < f->sizep; i++)
+        pmarkobjectN(w, f->p[i]);
+      for (i = 0; i < f->sizelocvars; i++)
+        pmarkobjectN(w, f->locvars[i].varname);
+      work = 1 + f->sizek + f->sizeupvalues + f->sizep + f->sizelocvars;
+      break;
+    }
+    default: goto defer;  /* threads */
+  }
+  pset2black(o);
+  w->work += work;
+  return;
+ defer:
+  *getgclist(o) = w->deferred;
+  w->deferred = o;
+}
+
+
+/*
+** Move up to GCPARBATCH objects from the front of list '*from' to
+** list '*to'. Returns the number of objects moved.
+*/
+static int movebatch (GCObject **from, GCObject **to) {
+  int n = 0;
+  while (*from != NULL && n < GCPARBATCH) {
+    GCObject *o = *from;
+    *from = *getgclist(o);
+    *getgclist(o) = *to;
+    *to = o;
+    n++;
+  }
+  return n;
+}
+
+
+/*
+** Get a batch of objects from the shared pool, waiting for other
+** workers to share some work if needed. Returns false when all workers
+** are idle and there is no more work to be done.
+*/
+static int getwork (GCWorker *w) {
+  GCPar *p = w->par;
+  int res;
+  pthread_mutex_lock(&p->lock);
+  __atomic_add_fetch(&p->nidle, 1, __ATOMIC_RELAXED);
+  while (p->pool == NULL && p->nidle < p->nworkers)
+    pthread_cond_wait(&p->cond, &p->lock);
+  if (p->pool != NULL) {
+    w->ngray += movebatch(&p->pool, &w->gray);
+    __atomic_sub_fetch(&p->nidle, 1, __ATOMIC_RELAXED);
+    res = 1;
+  }
+  else {  /* everybody is idle; marking is over */
+    pthread_cond_broadcast(&p->cond);
+    res = 0;
+  }
+  pthread_mutex_unlock(&p->lock);
+  return res;
+}
+
+
+/*
+** Give some work to idle workers (if there are any). 'nidle' is
+** changed only with the lock held, but it is read here without the
+** lock, so all its updates must be atomic.
+*/
+static void sharework (GCWorker *w) {
+  GCPar *p = w->par;
+  if (__atomic_load_n(&p->nidle, __ATOMIC_RELAXED) > 0) {
+    pthread_mutex_lock(&p->lock);
+    if (p->pool == NULL) {
+      w->ngray -= movebatch(&w->gray, &p->pool);
+      pthread_cond_broadcast(&p->cond);
+    }
+    pthread_mutex_unlock(&p->lock);
+  }
+}
+
+
+static void *workermain (void *ud) {
+  GCWorker *w = cast(GCWorker *, ud);
+  do {
+    while (w->gray != NULL) {
+      GCObject *o = w->gray;
+      w->gray = *getgclist(o);
+      w->ngray--;
+      ptraverse(w, o);
+      if (w->ngray > GCPARBATCH)
+        sharework(w);
+    }
+  } while (getwork(w));
+  return NULL;
+}
+
+
+/*
+** Mark all objects reachable from the 'gray' list using
+** 'g->gcnworkers' threads (including the calling one). Objects left
+** by the workers are traversed sequentially, which can create more
+** gray objects, and so the process repeats until the gray list is
+** empty.
+*/
+static lu_mem parallelpropagate (global_State *g) {
+  GCWorker w[LUAI_GCMAXWORKERS];
+  lu_mem work = 0;
+  while (g->gray != NULL) {
+    GCPar p;
+    int i;
+    int n = g->gcnworkers;
+    p.g = g;
+    p.pool = g->gray;
+    p.nidle = 0;
+    p.nworkers = n;
+    g->gray = NULL;
+    pthread_mutex_init(&p.lock, NULL);
+    pthread_cond_init(&p.cond, NULL);
+    for (i = 0; i < n; i++) {
+      w[i].par = &p;
+      w[i].gray = w[i].deferred = NULL;
+      w[i].ngray = 0;
+      w[i].work = 0;
+    }
+    for (i = 1; i < n; i++) {
+      if (pthread_create(&w[i].thread, NULL, workermain, &w[i]) != 0) {
+        pthread_mutex_lock(&p.lock);
+        p.nworkers -= n - i;  /* cannot create the remaining workers */
+        pthread_cond_broadcast(&p.cond);
+        pthread_mutex_unlock(&p.lock);
+        n = i;
+        break;
+      }
+    }
+    workermain(&w[0]);  /* main thread works too */
+    for (i = 1; i < n; i++)
+      pthread_join(w[i].thread, NULL);
+    pthread_cond_destroy(&p.cond);
+    pthread_mutex_destroy(&p.lock);
+    lua_assert(p.pool == NULL);
+    for (i = 0; i < n; i++) {  /* traverse deferred objects */
+      work += w[i].work;
+      while (w[i].deferred != NULL) {
+        GCObject *o = w[i].deferred;
+        w[i].deferred = *getgclist(o);
+        *getgclist(o) = g->gray;  /* put it in front of 'gray' list... */
+        g->gray = o;
+        work += propagatemark(g);  /* ...and traverse it */
+      }
+    }
+  }
+  return work;
+}
+
+#else
+
+#define markinparallel(g)	0
+#define parallelpropagate(g)	0
+
+#endif
+
+/* }====================================================== */
+
+
 static lu_mem propagateall (global_State *g) {
   lu_mem tot = 0;
+  if (markinparallel(g))
+    return parallelpropagate(g);
   while (g->gray)
     tot += propagatemark(g);
   return tot;
@@ -896,6 +1269,33 @@ static void dothecall (lua_State *L, void *ud) {
 }
 
 
+/*
+** luai_clocktime returns a monotonic wall-clock time, in seconds, used
+** to time finalizers. (A finalizer blocked on I/O is slow for whoever
+** waits for it, so processor time is not what matters here; it would
+** also include the time of the threads doing parallel marking.)
+*/
+#if !defined(luai_clocktime)
+
+#if defined(CLOCK_MONOTONIC)
+
+static lua_Number l_clocktime (void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return cast_num(ts.tv_sec) + cast_num(ts.tv_nsec) / 1e9;
+}
+
+#define luai_clocktime()	l_clocktime()
+
+#else		/* no monotonic clock; use processor time */
+
+#define luai_clocktime()	(cast_num(clock()) / CLOCKS_PER_SEC)
+
+#endif
+
+#endif
+
+
 static void GCTM (lua_State *L) {
   global_State *g = G(L);
   const TValue *tm;
@@ -905,6 +1305,8 @@ static void GCTM (lua_State *L) {
   tm = luaT_gettmbyobj(L, &v, TM_GC);
   if (!notm(tm)) {  /* is there a finalizer? */
     int status;
+    int timed = g->gcdeferfin || g->gcfintimed;
+    lua_Number start = 0;
     lu_byte oldah = L->allowhook;
     int running  = g->gcrunning;
     L->allowhook = 0;  /* stop debug hooks during GC metamethod */
@@ -912,8 +1314,17 @@ static void GCTM (lua_State *L) {
     setobj2s(L, L->top++, tm);  /* push finalizer... */
     setobj2s(L, L->top++, &v);  /* ... and its argument */
     L->ci->callstatus |= CIST_FIN;  /* will run a finalizer */
+    if (timed)
+      start = luai_clocktime();
     status = luaD_pcall(L, dothecall, NULL, savestack(L, L->top - 2), 0);
     L->ci->callstatus &= ~CIST_FIN;  /* not running a finalizer anymore */
+    g->finstats.count++;  /* update statistics */
+    if (timed) {
+      lua_Number elapsed = luai_clocktime() - start;
+      g->finstats.time += elapsed;
+      if (elapsed > g->finstats.maxtime)
+        g->finstats.maxtime = elapsed;
+    }
     L->allowhook = oldah;  /* restore hooks */
     g->gcrunning = running;  /* restore state */
     if (unlikely(status != LUA_OK)) {  /* error while running __gc? */
@@ -946,6 +1357,32 @@ static void callallpendingfinalizers (lua_State *L) {
 }
 
 
+/*
+** Call up to 'n' pending finalizers ('n <= 0' means all of them).
+** Used to run finalizers in deferred mode, when the collector only
+** queues the objects to be finalized.
+*/
+int luaC_runfinalizers (lua_State *L, int n) {
+  global_State *g = G(L);
+  int i;
+  for (i = 0; (n <= 0 || i < n) && g->tobefnz; i++)
+    GCTM(L);
+  return i;
+}
+
+
+/*
+** Number of objects waiting to be finalized.
+*/
+int luaC_countfinalizers (global_State *g) {
+  GCObject *o;
+  int n = 0;
+  for (o = g->tobefnz; o != NULL; o = o->next)
+    n++;
+  return n;
+}
+
+
 /*
 ** find last 'next' field in list 'p' list (to add elements in its end)
 */
@@ -1211,7 +1648,7 @@ static void finishgencycle (lua_State *L, global_State *g) {
   correctgraylists(g);
   checkSizes(L, g);
   g->gcstate = GCSpropagate;  /* skip restart */
-  if (!g->gcemergency)
+  if (!g->gcemergency && !g->gcdeferfin)
     callallpendingfinalizers(L);
 }
 
@@ -1610,11 +2047,11 @@ static lu_mem singlestep (lua_State *L) {
       return 0;
     }
     case GCScallfin: {  /* call remaining finalizers */
-      if (g->tobefnz && !g->gcemergency) {
+      if (g->tobefnz && !g->gcemergency && !g->gcdeferfin) {
         int n = runafewfinalizers(L, GCFINMAX);
         return n * GCFINALIZECOST;
       }
-      else {  /* emergency mode or no more finalizers */
+      else {  /* emergency/deferred mode or no more finalizers */
         g->gcstate = GCSpause;  /* finish collection */
         return 0;
       }
@@ -1687,6 +2124,8 @@ static void fullinc (lua_State *L, global_State *g) {
     entersweep(L); /* sweep everything to turn them back to white */
   /* finish any pending sweep phase to start a new cycle */
   luaC_runtilstate(L, bitmask(GCSpause));
+  luaC_runtilstate(L, bitmask(GCSpropagate));  /* start new cycle */
+  propagateall(g);  /* mark everything (in parallel, if possible) */
   luaC_runtilstate(L, bitmask(GCScallfin));  /* run up to finalizers */
   /* estimate must be correct after a full GC cycle */
   lua_assert(g->GCestimate == gettotalbytes(g));
@@ -140,6 +140,11 @@
 /* how much to allocate before next GC step (log2) */
 #define LUAI_GCSTEPSIZE 13      /* 8 KB */
 
+/* maximum number of threads for parallel marking */
+#if !defined(LUAI_GCMAXWORKERS)
+#define LUAI_GCMAXWORKERS	32
+#endif
+
 
 /*
 ** Check whether the declared GC mode is generational. While in
@@ -184,6 +189,8 @@ LUAI_FUNC void luaC_barrier_ (lua_State *L, GCObject *o, GCObject *v);
 LUAI_FUNC void luaC_barrierback_ (lua_State *L, GCObject *o);
 LUAI_FUNC void luaC_checkfinalizer (lua_State *L, GCObject *o, Table *mt);
 LUAI_FUNC void luaC_changemode (lua_State *L, int newmode);
+LUAI_FUNC int luaC_runfinalizers (lua_State *L, int n);
+LUAI_FUNC int luaC_countfinalizers (global_State *g);
 
 
 #endif
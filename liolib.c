@@ -664,6 +664,11 @@ static int g_write (lua_State *L, FILE *f, int arg) {
                              (LUAI_UACNUMBER)lua_tonumber(L, arg));
       status = status && (len > 0);
     }
+    else if (luaL_testudata(L, arg, LUA_STRBUFHANDLE)) {  /* buffer? */
+      luaL_StrBuf *sb = (luaL_StrBuf *)lua_touserdata(L, arg);
+      status = status && (sb->n == 0 ||
+                          fwrite(sb->b, sizeof(char), sb->n, f) == sb->n);
+    }
     else {
       size_t l;
       const char *s = luaL_checklstring(L, arg, &l);
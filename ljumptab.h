@@ -15,6 +15,11 @@
 
 #define vmbreak		vmfetch(); vmdispatch(GET_OPCODE(i));
 
+#undef vmfuse
+#define vmfuse(l)	\
+  if (trap) { vmbreak; } \
+  else { vmfetchnext(); lua_assert(GET_BASEOP(i) == l); goto L_##l; }
+
 
 static const void *const disptab[NUM_OPCODES] = {
 
@@ -107,6 +112,11 @@ static const void *const disptab[NUM_OPCODES] = {
 &&L_OP_CLOSURE,
 &&L_OP_VARARG,
 &&L_OP_VARARGPREP,
-&&L_OP_EXTRAARG
+&&L_OP_EXTRAARG,
+&&L_OP_MOVE_CALL,
+&&L_OP_GETTABUP_GETFIELD,
+&&L_OP_GETFIELD_CALL,
+&&L_OP_SELF_CALL,
+&&L_OP_FORLOOPGET
 
 };
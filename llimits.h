@@ -200,11 +200,21 @@ typedef l_uint32 Instruction;
 ** internalized. (Cannot be smaller than reserved words or tags for
 ** metamethods, as these strings must be internalized;
 ** #("function") = 8, #("__newindex") = 10.)
+** This is the default value; each state can change it (see
+** 'lua_setshortlen') to any value between MINSHORTLEN and LIMSHORTLEN.
+** (The later comes from the size of field 'shrlen' in TString.)
 */
 #if !defined(LUAI_MAXSHORTLEN)
 #define LUAI_MAXSHORTLEN	40
 #endif
 
+#define MINSHORTLEN	10
+#define LIMSHORTLEN	255
+
+#if LUAI_MAXSHORTLEN < MINSHORTLEN || LUAI_MAXSHORTLEN > LIMSHORTLEN
+#error "invalid value for LUAI_MAXSHORTLEN"
+#endif
+
 
 /*
 ** Initial size for the string table (must be power of 2).
@@ -245,6 +255,16 @@ typedef l_uint32 Instruction;
 #endif
 
 
+/*
+** LUAI_BUDGETGRACE is the number of units a thread with an exhausted
+** budget in mode 'error' gets once, so that its message handlers and
+** '__close' metamethods can run (see 'luaD_outofbudget').
+*/
+#if !defined(LUAI_BUDGETGRACE)
+#define LUAI_BUDGETGRACE	1000
+#endif
+
+
 /*
 ** macros that are executed whenever program enters the Lua core
 ** ('lua_lock') and leaves the core ('lua_unlock')
@@ -292,6 +312,15 @@ typedef l_uint32 Instruction;
 #endif
 
 
+/*
+** macro executed by the interpreter for each instruction 'i' that
+** it executes
+*/
+#if !defined(luai_opexec)
+#define luai_opexec(L,i)	((void)L)
+#endif
+
+
 
 /*
 ** The luai_num* macros define the primitive operations over numbers.
@@ -701,6 +701,139 @@ static int math_log10 (lua_State *L) {
 
 
 
+/*
+** {==================================================================
+** Fast versions
+** ===================================================================
+*/
+
+static int fast_abs (lua_FastValue *v) {
+  v[0].n = l_mathop(fabs)(v[0].n);
+  return LUA_FASTFLT;
+}
+
+static int fast_sin (lua_FastValue *v) {
+  v[0].n = l_mathop(sin)(v[0].n);
+  return LUA_FASTFLT;
+}
+
+static int fast_cos (lua_FastValue *v) {
+  v[0].n = l_mathop(cos)(v[0].n);
+  return LUA_FASTFLT;
+}
+
+static int fast_tan (lua_FastValue *v) {
+  v[0].n = l_mathop(tan)(v[0].n);
+  return LUA_FASTFLT;
+}
+
+static int fast_asin (lua_FastValue *v) {
+  v[0].n = l_mathop(asin)(v[0].n);
+  return LUA_FASTFLT;
+}
+
+static int fast_acos (lua_FastValue *v) {
+  v[0].n = l_mathop(acos)(v[0].n);
+  return LUA_FASTFLT;
+}
+
+static int fast_atan (lua_FastValue *v) {
+  v[0].n = l_mathop(atan2)(v[0].n, l_mathop(1.0));
+  return LUA_FASTFLT;
+}
+
+static int fast_sqrt (lua_FastValue *v) {
+  v[0].n = l_mathop(sqrt)(v[0].n);
+  return LUA_FASTFLT;
+}
+
+static int fast_log (lua_FastValue *v) {
+  v[0].n = l_mathop(log)(v[0].n);
+  return LUA_FASTFLT;
+}
+
+static int fast_exp (lua_FastValue *v) {
+  v[0].n = l_mathop(exp)(v[0].n);
+  return LUA_FASTFLT;
+}
+
+static int fast_deg (lua_FastValue *v) {
+  v[0].n = v[0].n * (l_mathop(180.0) / PI);
+  return LUA_FASTFLT;
+}
+
+static int fast_rad (lua_FastValue *v) {
+  v[0].n = v[0].n * (PI / l_mathop(180.0));
+  return LUA_FASTFLT;
+}
+
+
+/* same as 'pushnumint' */
+static int fastnumint (lua_FastValue *v, lua_Number d) {
+  if (lua_numbertointeger(d, &v[0].i))  /* does 'd' fit in an integer? */
+    return LUA_FASTINT;  /* result is integer */
+  else {
+    v[0].n = d;
+    return LUA_FASTFLT;  /* result is float */
+  }
+}
+
+static int fast_floor (lua_FastValue *v) {
+  return fastnumint(v, l_mathop(floor)(v[0].n));
+}
+
+static int fast_ceil (lua_FastValue *v) {
+  return fastnumint(v, l_mathop(ceil)(v[0].n));
+}
+
+static int fast_fmod (lua_FastValue *v) {
+  v[0].n = l_mathop(fmod)(v[0].n, v[1].n);
+  return LUA_FASTFLT;
+}
+
+static int fast_min (lua_FastValue *v) {
+  if (v[1].n < v[0].n)
+    v[0].n = v[1].n;
+  return LUA_FASTFLT;
+}
+
+static int fast_max (lua_FastValue *v) {
+  if (v[0].n < v[1].n)
+    v[0].n = v[1].n;
+  return LUA_FASTFLT;
+}
+
+
+/*
+** Functions whose results depend on the subtypes of their arguments
+** only take floats ('f') in their fast versions. The fast versions of
+** 'log' and 'atan' handle only calls with one argument.
+*/
+static const luaL_FastReg mathfast[] = {
+  {"abs",   math_abs, fast_abs, "f"},
+  {"acos",  math_acos, fast_acos, "n"},
+  {"asin",  math_asin, fast_asin, "n"},
+  {"atan",  math_atan, fast_atan, "n"},
+  {"ceil",  math_ceil, fast_ceil, "f"},
+  {"cos",   math_cos, fast_cos, "n"},
+  {"deg",   math_deg, fast_deg, "n"},
+  {"exp",   math_exp, fast_exp, "n"},
+  {"floor", math_floor, fast_floor, "f"},
+  {"fmod",  math_fmod, fast_fmod, "ff"},
+  {"log",   math_log, fast_log, "n"},
+  {"max",   math_max, fast_max, "ff"},
+  {"min",   math_min, fast_min, "ff"},
+  {"rad",   math_rad, fast_rad, "n"},
+  {"sin",   math_sin, fast_sin, "n"},
+  {"sqrt",  math_sqrt, fast_sqrt, "n"},
+  {"tan",   math_tan, fast_tan, "n"},
+  {NULL, NULL, NULL, NULL}
+};
+
+/* }================================================================== */
+
+
+
 static const luaL_Reg mathlib[] = {
   {"abs",   math_abs},
   {"acos",  math_acos},
@@ -749,6 +882,7 @@ static const luaL_Reg mathlib[] = {
 */
 LUAMOD_API int luaopen_math (lua_State *L) {
   luaL_newlib(L, mathlib);
+  luaL_setfastfuncs(L, mathfast);  /* replace functions with fast versions */
   lua_pushnumber(L, PI);
   lua_setfield(L, -2, "pi");
   lua_pushnumber(L, (lua_Number)HUGE_VAL);
@@ -215,6 +215,376 @@ static lua_Number lua_strx2number (const char *s, char **endptr) {
 /* }====================================================== */
 
 
+/*
+** {==================================================================
+** Fast conversions between doubles and decimal numerals
+** ===================================================================
+*/
+
+#if LUA_FLOAT_TYPE == LUA_FLOAT_DOUBLE && defined(ULLONG_MAX)
+
+#define L_FASTFLT
+
+typedef unsigned long long l_uint64;
+
+/*
+** 128-bit approximations of the powers of 5 in the range
+** [MINPOW5, MAXPOW5], normalized so that their highest bit is 1:
+** 5^q ~ pow5[q - MINPOW5] * 2^(floorlog2pow5(q) - 127). Entries for
+** negative powers are rounded up, the others are truncated (as the
+** Eisel-Lemire algorithm expects). Numbers needing powers out of this
+** range are rare, and are handled by the C library.
+*/
+#define MINPOW5		(-64)
+#define MAXPOW5		64
+
+static const l_uint64 pow5[MAXPOW5 - MINPOW5 + 1][2] = {
+  {0xa87fea27a539e9a5ull, 0x3f2398d747b36224ull},  /* 5^-64 */
+  {0xd29fe4b18e88640eull, 0x8eec7f0d19a03aadull},  /* 5^-63 */
+  {0x83a3eeeef9153e89ull, 0x1953cf68300424acull},  /* 5^-62 */
+  {0xa48ceaaab75a8e2bull, 0x5fa8c3423c052dd7ull},  /* 5^-61 */
+  {0xcdb02555653131b6ull, 0x3792f412cb06794dull},  /* 5^-60 */
+  {0x808e17555f3ebf11ull, 0xe2bbd88bbee40bd0ull},  /* 5^-59 */
+  {0xa0b19d2ab70e6ed6ull, 0x5b6aceaeae9d0ec4ull},  /* 5^-58 */
+  {0xc8de047564d20a8bull, 0xf245825a5a445275ull},  /* 5^-57 */
+  {0xfb158592be068d2eull, 0xeed6e2f0f0d56712ull},  /* 5^-56 */
+  {0x9ced737bb6c4183dull, 0x55464dd69685606bull},  /* 5^-55 */
+  {0xc428d05aa4751e4cull, 0xaa97e14c3c26b886ull},  /* 5^-54 */
+  {0xf53304714d9265dfull, 0xd53dd99f4b3066a8ull},  /* 5^-53 */
+  {0x993fe2c6d07b7fabull, 0xe546a8038efe4029ull},  /* 5^-52 */
+  {0xbf8fdb78849a5f96ull, 0xde98520472bdd033ull},  /* 5^-51 */
+  {0xef73d256a5c0f77cull, 0x963e66858f6d4440ull},  /* 5^-50 */
+  {0x95a8637627989aadull, 0xdde7001379a44aa8ull},  /* 5^-49 */
+  {0xbb127c53b17ec159ull, 0x5560c018580d5d52ull},  /* 5^-48 */
+  {0xe9d71b689dde71afull, 0xaab8f01e6e10b4a6ull},  /* 5^-47 */
+  {0x9226712162ab070dull, 0xcab3961304ca70e8ull},  /* 5^-46 */
+  {0xb6b00d69bb55c8d1ull, 0x3d607b97c5fd0d22ull},  /* 5^-45 */
+  {0xe45c10c42a2b3b05ull, 0x8cb89a7db77c506aull},  /* 5^-44 */
+  {0x8eb98a7a9a5b04e3ull, 0x77f3608e92adb242ull},  /* 5^-43 */
+  {0xb267ed1940f1c61cull, 0x55f038b237591ed3ull},  /* 5^-42 */
+  {0xdf01e85f912e37a3ull, 0x6b6c46dec52f6688ull},  /* 5^-41 */
+  {0x8b61313bbabce2c6ull, 0x2323ac4b3b3da015ull},  /* 5^-40 */
+  {0xae397d8aa96c1b77ull, 0xabec975e0a0d081aull},  /* 5^-39 */
+  {0xd9c7dced53c72255ull, 0x96e7bd358c904a21ull},  /* 5^-38 */
+  {0x881cea14545c7575ull, 0x7e50d64177da2e54ull},  /* 5^-37 */
+  {0xaa242499697392d2ull, 0xdde50bd1d5d0b9e9ull},  /* 5^-36 */
+  {0xd4ad2dbfc3d07787ull, 0x955e4ec64b44e864ull},  /* 5^-35 */
+  {0x84ec3c97da624ab4ull, 0xbd5af13bef0b113eull},  /* 5^-34 */
+  {0xa6274bbdd0fadd61ull, 0xecb1ad8aeacdd58eull},  /* 5^-33 */
+  {0xcfb11ead453994baull, 0x67de18eda5814af2ull},  /* 5^-32 */
+  {0x81ceb32c4b43fcf4ull, 0x80eacf948770ced7ull},  /* 5^-31 */
+  {0xa2425ff75e14fc31ull, 0xa1258379a94d028dull},  /* 5^-30 */
+  {0xcad2f7f5359a3b3eull, 0x096ee45813a04330ull},  /* 5^-29 */
+  {0xfd87b5f28300ca0dull, 0x8bca9d6e188853fcull},  /* 5^-28 */
+  {0x9e74d1b791e07e48ull, 0x775ea264cf55347eull},  /* 5^-27 */
+  {0xc612062576589ddaull, 0x95364afe032a819eull},  /* 5^-26 */
+  {0xf79687aed3eec551ull, 0x3a83ddbd83f52205ull},  /* 5^-25 */
+  {0x9abe14cd44753b52ull, 0xc4926a9672793543ull},  /* 5^-24 */
+  {0xc16d9a0095928a27ull, 0x75b7053c0f178294ull},  /* 5^-23 */
+  {0xf1c90080baf72cb1ull, 0x5324c68b12dd6339ull},  /* 5^-22 */
+  {0x971da05074da7beeull, 0xd3f6fc16ebca5e04ull},  /* 5^-21 */
+  {0xbce5086492111aeaull, 0x88f4bb1ca6bcf585ull},  /* 5^-20 */
+  {0xec1e4a7db69561a5ull, 0x2b31e9e3d06c32e6ull},  /* 5^-19 */
+  {0x9392ee8e921d5d07ull, 0x3aff322e62439fd0ull},  /* 5^-18 */
+  {0xb877aa3236a4b449ull, 0x09befeb9fad487c3ull},  /* 5^-17 */
+  {0xe69594bec44de15bull, 0x4c2ebe687989a9b4ull},  /* 5^-16 */
+  {0x901d7cf73ab0acd9ull, 0x0f9d37014bf60a11ull},  /* 5^-15 */
+  {0xb424dc35095cd80full, 0x538484c19ef38c95ull},  /* 5^-14 */
+  {0xe12e13424bb40e13ull, 0x2865a5f206b06fbaull},  /* 5^-13 */
+  {0x8cbccc096f5088cbull, 0xf93f87b7442e45d4ull},  /* 5^-12 */
+  {0xafebff0bcb24aafeull, 0xf78f69a51539d749ull},  /* 5^-11 */
+  {0xdbe6fecebdedd5beull, 0xb573440e5a884d1cull},  /* 5^-10 */
+  {0x89705f4136b4a597ull, 0x31680a88f8953031ull},  /* 5^-9 */
+  {0xabcc77118461cefcull, 0xfdc20d2b36ba7c3eull},  /* 5^-8 */
+  {0xd6bf94d5e57a42bcull, 0x3d32907604691b4dull},  /* 5^-7 */
+  {0x8637bd05af6c69b5ull, 0xa63f9a49c2c1b110ull},  /* 5^-6 */
+  {0xa7c5ac471b478423ull, 0x0fcf80dc33721d54ull},  /* 5^-5 */
+  {0xd1b71758e219652bull, 0xd3c36113404ea4a9ull},  /* 5^-4 */
+  {0x83126e978d4fdf3bull, 0x645a1cac083126eaull},  /* 5^-3 */
+  {0xa3d70a3d70a3d70aull, 0x3d70a3d70a3d70a4ull},  /* 5^-2 */
+  {0xccccccccccccccccull, 0xcccccccccccccccdull},  /* 5^-1 */
+  {0x8000000000000000ull, 0x0000000000000000ull},  /* 5^0 */
+  {0xa000000000000000ull, 0x0000000000000000ull},  /* 5^1 */
+  {0xc800000000000000ull, 0x0000000000000000ull},  /* 5^2 */
+  {0xfa00000000000000ull, 0x0000000000000000ull},  /* 5^3 */
+  {0x9c40000000000000ull, 0x0000000000000000ull},  /* 5^4 */
+  {0xc350000000000000ull, 0x0000000000000000ull},  /* 5^5 */
+  {0xf424000000000000ull, 0x0000000000000000ull},  /* 5^6 */
+  {0x9896800000000000ull, 0x0000000000000000ull},  /* 5^7 */
+  {0xbebc200000000000ull, 0x0000000000000000ull},  /* 5^8 */
+  {0xee6b280000000000ull, 0x0000000000000000ull},  /* 5^9 */
+  {0x9502f90000000000ull, 0x0000000000000000ull},  /* 5^10 */
+  {0xba43b74000000000ull, 0x0000000000000000ull},  /* 5^11 */
+  {0xe8d4a51000000000ull, 0x0000000000000000ull},  /* 5^12 */
+  {0x9184e72a00000000ull, 0x0000000000000000ull},  /* 5^13 */
+  {0xb5e620f480000000ull, 0x0000000000000000ull},  /* 5^14 */
+  {0xe35fa931a0000000ull, 0x0000000000000000ull},  /* 5^15 */
+  {0x8e1bc9bf04000000ull, 0x0000000000000000ull},  /* 5^16 */
+  {0xb1a2bc2ec5000000ull, 0x0000000000000000ull},  /* 5^17 */
+  {0xde0b6b3a76400000ull, 0x0000000000000000ull},  /* 5^18 */
+  {0x8ac7230489e80000ull, 0x0000000000000000ull},  /* 5^19 */
+  {0xad78ebc5ac620000ull, 0x0000000000000000ull},  /* 5^20 */
+  {0xd8d726b7177a8000ull, 0x0000000000000000ull},  /* 5^21 */
+  {0x878678326eac9000ull, 0x0000000000000000ull},  /* 5^22 */
+  {0xa968163f0a57b400ull, 0x0000000000000000ull},  /* 5^23 */
+  {0xd3c21bcecceda100ull, 0x0000000000000000ull},  /* 5^24 */
+  {0x84595161401484a0ull, 0x0000000000000000ull},  /* 5^25 */
+  {0xa56fa5b99019a5c8ull, 0x0000000000000000ull},  /* 5^26 */
+  {0xcecb8f27f4200f3aull, 0x0000000000000000ull},  /* 5^27 */
+  {0x813f3978f8940984ull, 0x4000000000000000ull},  /* 5^28 */
+  {0xa18f07d736b90be5ull, 0x5000000000000000ull},  /* 5^29 */
+  {0xc9f2c9cd04674edeull, 0xa400000000000000ull},  /* 5^30 */
+  {0xfc6f7c4045812296ull, 0x4d00000000000000ull},  /* 5^31 */
+  {0x9dc5ada82b70b59dull, 0xf020000000000000ull},  /* 5^32 */
+  {0xc5371912364ce305ull, 0x6c28000000000000ull},  /* 5^33 */
+  {0xf684df56c3e01bc6ull, 0xc732000000000000ull},  /* 5^34 */
+  {0x9a130b963a6c115cull, 0x3c7f400000000000ull},  /* 5^35 */
+  {0xc097ce7bc90715b3ull, 0x4b9f100000000000ull},  /* 5^36 */
+  {0xf0bdc21abb48db20ull, 0x1e86d40000000000ull},  /* 5^37 */
+  {0x96769950b50d88f4ull, 0x1314448000000000ull},  /* 5^38 */
+  {0xbc143fa4e250eb31ull, 0x17d955a000000000ull},  /* 5^39 */
+  {0xeb194f8e1ae525fdull, 0x5dcfab0800000000ull},  /* 5^40 */
+  {0x92efd1b8d0cf37beull, 0x5aa1cae500000000ull},  /* 5^41 */
+  {0xb7abc627050305adull, 0xf14a3d9e40000000ull},  /* 5^42 */
+  {0xe596b7b0c643c719ull, 0x6d9ccd05d0000000ull},  /* 5^43 */
+  {0x8f7e32ce7bea5c6full, 0xe4820023a2000000ull},  /* 5^44 */
+  {0xb35dbf821ae4f38bull, 0xdda2802c8a800000ull},  /* 5^45 */
+  {0xe0352f62a19e306eull, 0xd50b2037ad200000ull},  /* 5^46 */
+  {0x8c213d9da502de45ull, 0x4526f422cc340000ull},  /* 5^47 */
+  {0xaf298d050e4395d6ull, 0x9670b12b7f410000ull},  /* 5^48 */
+  {0xdaf3f04651d47b4cull, 0x3c0cdd765f114000ull},  /* 5^49 */
+  {0x88d8762bf324cd0full, 0xa5880a69fb6ac800ull},  /* 5^50 */
+  {0xab0e93b6efee0053ull, 0x8eea0d047a457a00ull},  /* 5^51 */
+  {0xd5d238a4abe98068ull, 0x72a4904598d6d880ull},  /* 5^52 */
+  {0x85a36366eb71f041ull, 0x47a6da2b7f864750ull},  /* 5^53 */
+  {0xa70c3c40a64e6c51ull, 0x999090b65f67d924ull},  /* 5^54 */
+  {0xd0cf4b50cfe20765ull, 0xfff4b4e3f741cf6dull},  /* 5^55 */
+  {0x82818f1281ed449full, 0xbff8f10e7a8921a4ull},  /* 5^56 */
+  {0xa321f2d7226895c7ull, 0xaff72d52192b6a0dull},  /* 5^57 */
+  {0xcbea6f8ceb02bb39ull, 0x9bf4f8a69f764490ull},  /* 5^58 */
+  {0xfee50b7025c36a08ull, 0x02f236d04753d5b4ull},  /* 5^59 */
+  {0x9f4f2726179a2245ull, 0x01d762422c946590ull},  /* 5^60 */
+  {0xc722f0ef9d80aad6ull, 0x424d3ad2b7b97ef5ull},  /* 5^61 */
+  {0xf8ebad2b84e0d58bull, 0xd2e0898765a7deb2ull},  /* 5^62 */
+  {0x9b934c3b330c8577ull, 0x63cc55f49f88eb2full},  /* 5^63 */
+  {0xc2781f49ffcfa6d5ull, 0x3cbf6b71c76b25fbull}  /* 5^64 */
+};
+
+
+/* floor(e * log2(10)) and floor(e * log10(2)), for small 'e' */
+#define floorlog2pow10(e)	floormul(e, 217706, 16)
+#define floorlog10pow2(e)	floormul(e, 78913, 18)
+
+#define floorlog2pow5(q)	(floorlog2pow10(q) - (q))
+
+static int floormul (int e, int m, int shift) {
+  if (e >= 0)
+    return (e * m) >> shift;
+  else  /* avoid right shifts of negative values */
+    return -((-e * m + (1 << shift) - 1) >> shift);
+}
+
+
+/*
+** Full product of 'a' and 'b'; returns the high half and puts the
+** low half in '*lo'.
+*/
+static l_uint64 mul128 (l_uint64 a, l_uint64 b, l_uint64 *lo) {
+#if defined(__SIZEOF_INT128__)
+  unsigned __int128 p = (unsigned __int128)a * b;
+  *lo = (l_uint64)p;
+  return (l_uint64)(p >> 64);
+#else
+  l_uint64 a0 = a & 0xffffffffu, a1 = a >> 32;
+  l_uint64 b0 = b & 0xffffffffu, b1 = b >> 32;
+  l_uint64 p01 = a0 * b1, p10 = a1 * b0;
+  l_uint64 mid = ((a0 * b0) >> 32) + (p01 & 0xffffffffu) + (p10 & 0xffffffffu);
+  *lo = a * b;
+  return a1 * b1 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+#endif
+}
+
+
+/*
+** Convert 'w * 10^q' to a double using the Eisel-Lemire algorithm
+** ("Number Parsing at a Gigabyte per Second", D. Lemire, 2021). Returns
+** 0 when 'q' is out of range or when the algorithm cannot decide the
+** correct rounding (which is very rare).
+*/
+static int eisellemire (l_uint64 w, int q, int neg, double *res) {
+  l_uint64 hi, lo, mant, bits;
+  int lz = 0, upperbit, e;
+  if (q < MINPOW5 || q > MAXPOW5)
+    return 0;
+  while (!(w >> 63)) { w <<= 1; lz++; }  /* normalize 'w' */
+  hi = mul128(w, pow5[q - MINPOW5][0], &lo);
+  if ((hi & 0x1FF) == 0x1FF && lo + w < lo) {  /* not enough precision? */
+    l_uint64 lo2, hi2 = mul128(w, pow5[q - MINPOW5][1], &lo2);
+    lo += hi2;
+    if (lo < hi2) hi++;
+    if (lo + 1 == 0 && (hi & 0x1FF) == 0x1FF && lo2 + w < lo2)
+      return 0;  /* still ambiguous */
+  }
+  upperbit = (int)(hi >> 63);
+  mant = hi >> (upperbit + 9);
+  lz += 1 ^ upperbit;
+  if (lo == 0 && (hi & 0x1FF) == 0 && (mant & 3) == 1)
+    return 0;  /* maybe halfway between two doubles */
+  mant += mant & 1;  /* round */
+  mant >>= 1;
+  if (mant >= (1ull << 53)) {  /* rounding overflowed? */
+    mant = 1ull << 52;
+    lz--;
+  }
+  e = floorlog2pow10(q) + 1024 + 63 - lz;  /* biased exponent */
+  if (e < 1 || e > 2046)
+    return 0;  /* subnormal or overflow */
+  bits = (mant & ~(1ull << 52)) | ((l_uint64)e << 52);
+  if (neg) bits |= 1ull << 63;
+  memcpy(res, &bits, sizeof(bits));
+  return 1;
+}
+
+
+/*
+** Fast path to convert a decimal numeral to a double. It only accepts
+** numerals with at most 19 significant digits and with the dot as the
+** decimal point. Returns NULL when it cannot convert the string, so
+** that the caller can use the general 'l_str2d'.
+*/
+static const char *l_str2dfast (const char *s, lua_Number *result) {
+  l_uint64 w = 0;
+  int q = 0, sigdig = 0, ndig = 0, neg;
+  while (lisspace(cast_uchar(*s))) s++;  /* skip initial spaces */
+  neg = isneg(&s);
+  while (*s == '0') { s++; ndig++; }  /* skip leading zeros */
+  for (; lisdigit(cast_uchar(*s)); s++, ndig++, sigdig++)
+    w = w * 10 + cast_uint(*s - '0');
+  if (*s == '.') {
+    s++;
+    if (sigdig == 0)  /* no significant digits yet? */
+      for (; *s == '0'; s++, ndig++) q--;  /* skip zeros after the dot */
+    for (; lisdigit(cast_uchar(*s)); s++, ndig++, sigdig++, q--)
+      w = w * 10 + cast_uint(*s - '0');
+  }
+  if (ndig == 0 || sigdig > 19)
+    return NULL;  /* no digits or too many digits */
+  if (*s == 'e' || *s == 'E') {  /* exponent part? */
+    int exp1 = 0;
+    int neg1;
+    s++;  /* skip 'e' */
+    neg1 = isneg(&s);
+    if (!lisdigit(cast_uchar(*s)))
+      return NULL;  /* invalid; must have at least one digit */
+    for (; lisdigit(cast_uchar(*s)); s++)
+      if (exp1 < 10000)  /* avoid overflows */
+        exp1 = exp1 * 10 + (*s - '0');
+    q += (neg1) ? -exp1 : exp1;
+  }
+  while (lisspace(cast_uchar(*s))) s++;  /* skip trailing spaces */
+  if (*s != '\0')
+    return NULL;
+  if (w == 0)
+    *result = (neg) ? -0.0 : 0.0;
+  else if (!eisellemire(w, q, neg, result))
+    return NULL;
+  return s;
+}
+
+
+/*
+** Precomputed powers of 10 for the digit generation in 'l_fmtg'.
+*/
+static const l_uint64 pow10[] = {
+  1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull,
+  10000000ull, 100000000ull, 1000000000ull, 10000000000ull,
+  100000000000ull, 1000000000000ull, 10000000000000ull,
+  100000000000000ull, 1000000000000000ull
+};
+
+#define MAXFMTPREC	15
+
+
+/*
+** Fast path to format a double 'x' as 'snprintf' does with a "%.<p>g"
+** format, for 1 <= p <= MAXFMTPREC. It scales 'x' by a power of 10 so
+** that its integer part has 'p' digits, using the 64-bit high half of
+** the power in 'pow5'. The relative error of that scaling is below
+** 2^-63, so it changes the scaled value by less than 2^-13; when the
+** fraction to be rounded is that close to one half, the function gives
+** up and returns 0, so that the caller can use 'snprintf'. It also
+** returns 0 for zeros, subnormals, infinities, and NaNs. Otherwise, it
+** returns the length of the result.
+*/
+static int l_fmtg (char *buff, double x, int p) {
+  l_uint64 bits, m, hi, lo, d, frac;
+  char digits[MAXFMTPREC];
+  int e2, X, nd, i, n = 0, tries = 0;
+  memcpy(&bits, &x, sizeof(x));
+  e2 = (int)((bits >> 52) & 0x7FF);
+  if (e2 == 0 || e2 == 0x7FF)
+    return 0;
+  if (bits >> 63)
+    buff[n++] = '-';
+  m = ((bits & ((1ull << 52) - 1)) | (1ull << 52)) << 11;
+  e2 -= 1075 + 11;  /* |x| = m * 2^e2 */
+  X = floorlog10pow2(e2 + 63);  /* X or X - 1, for X = floor(log10(|x|)) */
+  for (;;) {  /* compute d = round(|x| * 10^(p - 1 - X)) */
+    int q = p - 1 - X;
+    int r = 63 - e2 - q - floorlog2pow5(q);  /* scaled |x| = m*pow5 / 2^r */
+    if (q < MINPOW5 || q > MAXPOW5 || r <= 64 || r >= 128 || tries++ > 2)
+      return 0;
+    hi = mul128(m, pow5[q - MINPOW5][0], &lo);
+    d = hi >> (r - 64);
+    frac = (hi << (128 - r)) | (lo >> (r - 64));
+    if (d >= pow10[p]) X++;  /* too many digits; try again */
+    else if (d < pow10[p - 1]) X--;  /* too few digits; try again */
+    else break;
+  }
+  if (frac - ((1ull << 63) - (1ull << 54)) < (1ull << 55))
+    return 0;  /* too close to a tie */
+  if (frac >> 63 && ++d == pow10[p]) {  /* round up; carry to a new digit? */
+    d = pow10[p - 1];
+    X++;
+  }
+  for (i = p - 1; i >= 0; i--, d /= 10)
+    digits[i] = cast_char('0' + d % 10);
+  for (nd = p; nd > 1 && digits[nd - 1] == '0'; nd--) ;  /* trailing zeros */
+  if (X < -4 || X >= p) {  /* exponential notation */
+    buff[n++] = digits[0];
+    if (nd > 1) {
+      buff[n++] = lua_getlocaledecpoint();
+      for (i = 1; i < nd; i++) buff[n++] = digits[i];
+    }
+    buff[n++] = 'e';
+    buff[n++] = (X < 0) ? '-' : '+';
+    if (X < 0) X = -X;
+    if (X >= 100) buff[n++] = cast_char('0' + X / 100);
+    buff[n++] = cast_char('0' + X / 10 % 10);
+    buff[n++] = cast_char('0' + X % 10);
+  }
+  else if (X >= 0) {  /* integer part has X + 1 digits */
+    for (i = 0; i <= X; i++) buff[n++] = (i < nd) ? digits[i] : '0';
+    if (nd > X + 1) {
+      buff[n++] = lua_getlocaledecpoint();
+      for (; i < nd; i++) buff[n++] = digits[i];
+    }
+  }
+  else {  /* 0.000ddd */
+    buff[n++] = '0';
+    buff[n++] = lua_getlocaledecpoint();
+    for (i = -1; i > X; i--) buff[n++] = '0';
+    for (i = 0; i < nd; i++) buff[n++] = digits[i];
+  }
+  buff[n] = '\0';
+  return n;
+}
+
+#endif
+
+/* }================================================================== */
+
+
 /* maximum length of a numeral to be converted to a number */
 #if !defined (L_MAXLENNUM)
 #define L_MAXLENNUM	200
@@ -250,8 +620,14 @@ static const char *l_str2dloc (const char *s, lua_Number *result, int mode) {
 */
 static const char *l_str2d (const char *s, lua_Number *result) {
   const char *endptr;
-  const char *pmode = strpbrk(s, ".xXnN");  /* look for special chars */
-  int mode = pmode ? ltolower(cast_uchar(*pmode)) : 0;
+  const char *pmode;
+  int mode;
+#if defined(L_FASTFLT)
+  if ((endptr = l_str2dfast(s, result)) != NULL)
+    return endptr;
+#endif
+  pmode = strpbrk(s, ".xXnN");  /* look for special chars */
+  mode = pmode ? ltolower(cast_uchar(*pmode)) : 0;
   if (mode == 'n')  /* reject 'inf' and 'nan' */
     return NULL;
   endptr = l_str2dloc(s, result, mode);  /* try to convert */
@@ -358,6 +734,10 @@ static int tostringbuff (TValue *obj, char *buff) {
   if (ttisinteger(obj))
     len = lua_integer2str(buff, MAXNUMBER2STR, ivalue(obj));
   else {
+#if defined(L_FASTFLT) && defined(LUA_NUMBER_FMTPREC)
+    len = l_fmtg(buff, fltvalue(obj), LUA_NUMBER_FMTPREC);
+    if (len == 0)  /* fast path failed? */
+#endif
     len = lua_number2str(buff, MAXNUMBER2STR, fltvalue(obj));
     if (buff[strspn(buff, "-0123456789")] == '\0') {  /* looks like an int? */
       buff[len++] = lua_getlocaledecpoint();
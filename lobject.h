@@ -550,6 +550,10 @@ typedef struct Proto {
   LocVar *locvars;  /* information about local variables (debug information) */
   TString  *source;  /* used for debug information */
   GCObject *gclist;
+#if defined(LUA_VMSTATS)
+  lu_mem *execcount;  /* number of executions of each instruction */
+  lu_mem ncalls;  /* number of calls to the function */
+#endif
 } Proto;
 
 /* }================================================================== */
@@ -623,7 +627,11 @@ typedef struct UpVal {
 
 typedef struct CClosure {
   ClosureHeader;
+  lu_byte nfargs;  /* number of fixed arguments of 'ff' */
+  lu_byte fvararg;  /* true if 'ff' accepts extra arguments */
+  unsigned short fsig;  /* kinds of fixed arguments of 'ff' */
   lua_CFunction f;
+  lua_FastCFunction ff;  /* fast version of 'f' (or NULL) */
   TValue upvalue[1];  /* list of upvalues */
 } CClosure;
 
@@ -711,11 +719,21 @@ typedef union Node {
 #define setnorealasize(t)	((t)->flags |= BITRAS)
 
 
+/*
+** A frozen table cannot be modified: any assignment to it, raw or not,
+** and any change to its metatable raises an error.
+*/
+#define BITFROZEN	(1 << 6)
+#define isfrozen(t)		((t)->flags & BITFROZEN)
+#define setfrozen(t)		((t)->flags |= BITFROZEN)
+
+
 typedef struct Table {
   CommonHeader;
   lu_byte flags;  /* 1<<p means tagmethod(p) is not present */
   lu_byte lsizenode;  /* log2 of size of 'node' array */
   unsigned int alimit;  /* "limit" of 'array' array */
+  unsigned int border;  /* last border computed for #t (a hint) */
   TValue *array;  /* array part */
   Node *node;
   Node *lastfree;  /* any free position is before this position */
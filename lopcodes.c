@@ -100,5 +100,18 @@ LUAI_DDEF const lu_byte luaP_opmodes[NUM_OPCODES] = {
  ,opmode(0, 1, 0, 0, 1, iABC)		/* OP_VARARG */
  ,opmode(0, 0, 1, 0, 1, iABC)		/* OP_VARARGPREP */
  ,opmode(0, 0, 0, 0, 0, iAx)		/* OP_EXTRAARG */
+ ,opmode(0, 0, 0, 0, 1, iABC)		/* OP_MOVE_CALL */
+ ,opmode(0, 0, 0, 0, 1, iABC)		/* OP_GETTABUP_GETFIELD */
+ ,opmode(0, 0, 0, 0, 1, iABC)		/* OP_GETFIELD_CALL */
+ ,opmode(0, 0, 0, 0, 1, iABC)		/* OP_SELF_CALL */
+ ,opmode(0, 0, 0, 0, 1, iABx)		/* OP_FORLOOPGET */
+};
+
+
+LUAI_DDEF const lu_byte luaP_fusedops[NUM_FUSEDOPS][2] = {
+  {OP_MOVE, OP_CALL}			/* OP_MOVE_CALL */
+ ,{OP_GETTABUP, OP_GETFIELD}		/* OP_GETTABUP_GETFIELD */
+ ,{OP_GETFIELD, OP_CALL}		/* OP_GETFIELD_CALL */
+ ,{OP_SELF, OP_CALL}			/* OP_SELF_CALL */
 };
 
@@ -292,7 +292,6 @@ OP_RETURN1,/*	A	return R[A]					*/
 OP_FORLOOP,/*	A Bx	update counters; if loop continues then pc-=Bx; */
 OP_FORPREP,/*	A Bx	<check values and prepare counters>;
                         if not to run then pc+=Bx+1;			*/
-
 OP_TFORPREP,/*	A Bx	create upvalue for R[A + 3]; pc+=Bx		*/
 OP_TFORCALL,/*	A C	R[A+4], ... ,R[A+3+C] := R[A](R[A+1], R[A+2]);	*/
 OP_TFORLOOP,/*	A Bx	if R[A+2] ~= nil then { R[A]=R[A+2]; pc -= Bx }	*/
@@ -305,11 +304,27 @@ OP_VARARG,/*	A C	R[A], R[A+1], ..., R[A+C-2] = vararg		*/
 
 OP_VARARGPREP,/*A	(adjust vararg parameters)			*/
 
-OP_EXTRAARG/*	Ax	extra (larger) argument for previous opcode	*/
+OP_EXTRAARG,/*	Ax	extra (larger) argument for previous opcode	*/
+
+/* superinstructions (see notes) */
+OP_MOVE_CALL,/*	A B	R[A] := R[B]; go to the next (OP_CALL)		*/
+OP_GETTABUP_GETFIELD,/* A B C	R[A] := UpValue[B][K[C]:string];
+                                go to the next (OP_GETFIELD)		*/
+OP_GETFIELD_CALL,/* A B C	R[A] := R[B][K[C]:string];
+                                go to the next (OP_CALL)		*/
+OP_SELF_CALL,/*	A B C	R[A+1] := R[B]; R[A] := R[B][RK(C):string];
+                                go to the next (OP_CALL)		*/
+
+/* specialized instructions (see notes) */
+OP_FORLOOPGET/*	A Bx	OP_FORLOOP; may also run the OP_GETTABLE at pc-Bx */
 } OpCode;
 
 
-#define NUM_OPCODES	((int)(OP_EXTRAARG) + 1)
+#define NUM_OPCODES	((int)(OP_FORLOOPGET) + 1)
+
+#define FIRSTFUSEDOP	OP_MOVE_CALL
+#define LASTFUSEDOP	OP_SELF_CALL
+#define NUM_FUSEDOPS	(LASTFUSEDOP - FIRSTFUSEDOP + 1)
 
 
 
@@ -352,6 +367,19 @@ OP_EXTRAARG/*	Ax	extra (larger) argument for previous opcode	*/
   original operand was a float. (It must be corrected in case of
   metamethods.)
 
+  (*) OP_FORLOOPGET is an OP_FORLOOP whose loop body starts with an
+  OP_GETTABLE indexed by the loop's control variable. When an integer
+  loop continues and that indexing needs no metamethods, it does the
+  indexing itself and jumps over the OP_GETTABLE; otherwise (and with
+  hooks) it does only what OP_FORLOOP does.
+
+  (*) A superinstruction does exactly what its first component does,
+  and then the interpreter goes straight to the next instruction,
+  which always has the second component as its (base) opcode. The
+  next instruction is not changed, so jumps to it still work. Code
+  generation creates superinstructions as a last step (see 'fuseops'
+  in lcode.c); everything else should see them through 'GET_BASEOP'.
+
 ===========================================================================*/
 
 
@@ -386,6 +414,17 @@ LUAI_DDEC(const lu_byte luaP_opmodes[NUM_OPCODES];)
     (((mm) << 7) | ((ot) << 6) | ((it) << 5) | ((t) << 4) | ((a) << 3) | (m))
 
 
+/* components of each superinstruction */
+LUAI_DDEC(const lu_byte luaP_fusedops[NUM_FUSEDOPS][2];)
+
+/* opcode that a superinstruction stands for (its first component) */
+#define baseop(o)  \
+	((o) < FIRSTFUSEDOP || (o) > LASTFUSEDOP ? (o) \
+                            : cast(OpCode, luaP_fusedops[(o) - FIRSTFUSEDOP][0]))
+
+#define GET_BASEOP(i)	baseop(GET_OPCODE(i))
+
+
 /* number of list items to accumulate before a SETLIST instruction */
 #define LFIELDS_PER_FLUSH	50
 
@@ -96,6 +96,11 @@ static const char *const opnames[] = {
   "VARARG",
   "VARARGPREP",
   "EXTRAARG",
+  "MOVE_CALL",
+  "GETTABUP_GETFIELD",
+  "GETFIELD_CALL",
+  "SELF_CALL",
+  "FORLOOPGET",
   NULL
 };
 
@@ -757,6 +757,7 @@ static void close_func (LexState *ls) {
   luaM_shrinkvector(L, f->p, f->sizep, fs->np, Proto *);
   luaM_shrinkvector(L, f->locvars, f->sizelocvars, fs->ndebugvars, LocVar);
   luaM_shrinkvector(L, f->upvalues, f->sizeupvalues, fs->nups, Upvaldesc);
+  luaF_newcounters(L, f);
   ls->fs = fs->prev;
   luaC_checkGC(L);
 }
@@ -1535,6 +1536,7 @@ static void forbody (LexState *ls, int base, int line, int nvars, int isgen) {
   static const OpCode forloop[2] = {OP_FORLOOP, OP_TFORLOOP};
   BlockCnt bl;
   FuncState *fs = ls->fs;
+  OpCode loop = forloop[isgen];
   int prep, endfor;
   checknext(ls, TK_DO);
   prep = luaK_codeABx(fs, forprep[isgen], base, 0);
@@ -1548,7 +1550,12 @@ static void forbody (LexState *ls, int base, int line, int nvars, int isgen) {
     luaK_codeABC(fs, OP_TFORCALL, base, 0, nvars);
     luaK_fixline(fs, line);
   }
-  endfor = luaK_codeABx(fs, forloop[isgen], base, 0);
+  else if (fs->pc > prep + 1) {  /* numeric loop with a non-empty body? */
+    Instruction first = fs->f->code[prep + 1];
+    if (GET_OPCODE(first) == OP_GETTABLE && GETARG_C(first) == base + 3)
+      loop = OP_FORLOOPGET;  /* body starts indexing with control var. */
+  }
+  endfor = luaK_codeABx(fs, loop, base, 0);
   fixforjump(fs, endfor, prep + 1, 1);
   luaK_fixline(fs, line);
 }
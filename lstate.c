@@ -102,55 +102,125 @@ LUA_API int lua_setcstacklimit (lua_State *L, unsigned int limit) {
 }
 
 
+/*
+** Give a chunk back to the global pool or, if the pool for its size is
+** full, free it.
+*/
+static void freecichunk (lua_State *L, CIChunk *c) {
+  global_State *g = G(L);
+  int cl = c->szclass;
+  if (g->ncipool[cl] < LUAI_CIPOOL) {
+    c->prev = g->cipool[cl];
+    g->cipool[cl] = c;
+    g->ncipool[cl]++;
+  }
+  else
+    luaM_freemem(L, c, sizeCIChunk(cl));
+}
+
+
+/*
+** Add a new chunk of entries to the end of the 'ci' list (which ends
+** at 'L->ci') and return its first entry.
+*/
 CallInfo *luaE_extendCI (lua_State *L) {
+  global_State *g = G(L);
+  CIChunk *c;
   CallInfo *ci;
+  int cl = (L->cichunk == NULL) ? 0 : L->cichunk->szclass + 1;
+  int i, n;
+  if (cl >= NCICLASSES)
+    cl = NCICLASSES - 1;
   lua_assert(L->ci->next == NULL);
-  ci = luaM_new(L, CallInfo);
+  if (g->cipool[cl] != NULL) {  /* reuse a free chunk? */
+    c = g->cipool[cl];
+    g->cipool[cl] = c->prev;
+    g->ncipool[cl]--;
+  }
+  else
+    c = cast(CIChunk *, luaM_malloc_(L, sizeCIChunk(cl), 0));
   lua_assert(L->ci->next == NULL);
-  L->ci->next = ci;
-  ci->previous = L->ci;
+  c->szclass = cast_byte(cl);
+  c->prev = L->cichunk;
+  L->cichunk = c;
+  n = cichunksize(cl);
+  ci = L->ci;
+  for (i = 0; i < n; i++) {  /* link all new entries */
+    ci->next = &c->ci[i];
+    c->ci[i].previous = ci;
+    c->ci[i].u.l.trap = 0;
+    ci = &c->ci[i];
+  }
   ci->next = NULL;
-  ci->u.l.trap = 0;
-  L->nci++;
-  return ci;
+  L->nci += n;
+  return L->ci->next;
 }
 
 
 /*
-** free all CallInfo structures not in use by a thread
+** free all CallInfo structures of a thread, which must be at its
+** base level
 */
 void luaE_freeCI (lua_State *L) {
-  CallInfo *ci = L->ci;
-  CallInfo *next = ci->next;
-  ci->next = NULL;
-  while ((ci = next) != NULL) {
-    next = ci->next;
-    luaM_free(L, ci);
-    L->nci--;
+  CIChunk *c = L->cichunk;
+  lua_assert(L->ci == &L->base_ci);
+  L->base_ci.next = NULL;
+  L->cichunk = NULL;
+  while (c != NULL) {
+    CIChunk *prev = c->prev;
+    L->nci -= cichunksize(c->szclass);
+    freecichunk(L, c);
+    c = prev;
   }
 }
 
 
 /*
-** free half of the CallInfo structures not in use by a thread,
-** keeping the first one.
+** free half of the chunks with CallInfo structures not in use by a
+** thread (chunks whose entries all come after 'L->ci'), keeping the
+** first one.
 */
 void luaE_shrinkCI (lua_State *L) {
-  CallInfo *ci = L->ci->next;  /* first free CallInfo */
-  CallInfo *next;
-  if (ci == NULL)
-    return;  /* no extra elements */
-  while ((next = ci->next) != NULL) {  /* two extra elements? */
-    CallInfo *next2 = next->next;  /* next's next */
-    ci->next = next2;  /* remove next from the list */
-    L->nci--;
-    luaM_free(L, next);  /* free next */
-    if (next2 == NULL)
-      break;  /* no more elements */
-    else {
-      next2->previous = ci;
-      ci = next2;  /* continue */
+  CallInfo *ci;
+  CIChunk *c;
+  int nfree = 0;
+  int nchunks = 0;
+  for (ci = L->ci->next; ci != NULL; ci = ci->next)
+    nfree++;  /* count free entries */
+  for (c = L->cichunk; c != NULL && nfree >= cichunksize(c->szclass);
+       c = c->prev) {  /* count free chunks */
+    nfree -= cichunksize(c->szclass);
+    nchunks++;
+  }
+  if ((nchunks /= 2) == 0)
+    return;  /* nothing to free */
+  while (nchunks-- > 0) {
+    c = L->cichunk;
+    L->cichunk = c->prev;
+    L->nci -= cichunksize(c->szclass);
+    freecichunk(L, c);
+  }
+  c = L->cichunk;  /* new last chunk */
+  if (c == NULL)
+    L->base_ci.next = NULL;
+  else
+    c->ci[cichunksize(c->szclass) - 1].next = NULL;
+}
+
+
+/*
+** free all chunks kept for reuse
+*/
+void luaE_freecipool (lua_State *L) {
+  global_State *g = G(L);
+  int cl;
+  for (cl = 0; cl < NCICLASSES; cl++) {
+    while (g->cipool[cl] != NULL) {
+      CIChunk *c = g->cipool[cl];
+      g->cipool[cl] = c->prev;
+      luaM_freemem(L, c, sizeCIChunk(cl));
     }
+    g->ncipool[cl] = 0;
   }
 }
 
@@ -177,17 +247,13 @@ LUAI_FUNC void luaE_incCstack (lua_State *L) {
 }
 
 
-static void stack_init (lua_State *L1, lua_State *L) {
-  int i; CallInfo *ci;
-  /* initialize stack array */
-  L1->stack = luaM_newvector(L, BASIC_STACK_SIZE + EXTRA_STACK, StackValue);
-  for (i = 0; i < BASIC_STACK_SIZE + EXTRA_STACK; i++)
-    setnilvalue(s2v(L1->stack + i));  /* erase new stack */
+/*
+** initialize first ci of a thread, over a clean stack
+*/
+static void baseci_init (lua_State *L1) {
+  CallInfo *ci = &L1->base_ci;
   L1->top = L1->stack;
-  L1->stack_last = L1->stack + BASIC_STACK_SIZE;
-  /* initialize first ci */
-  ci = &L1->base_ci;
-  ci->next = ci->previous = NULL;
+  ci->previous = NULL;
   ci->callstatus = CIST_C;
   ci->func = L1->top;
   ci->u.c.k = NULL;
@@ -199,6 +265,19 @@ static void stack_init (lua_State *L1, lua_State *L) {
 }
 
 
+static void stack_init (lua_State *L1, lua_State *L, int size) {
+  int i;
+  /* initialize stack array */
+  L1->stack = luaM_newvector(L, size + EXTRA_STACK, StackValue);
+  for (i = 0; i < size + EXTRA_STACK; i++)
+    setnilvalue(s2v(L1->stack + i));  /* erase new stack */
+  L1->stack_last = L1->stack + size;
+  L1->stackpeak = size;
+  L1->base_ci.next = NULL;
+  baseci_init(L1);
+}
+
+
 static void freestack (lua_State *L) {
   if (L->stack == NULL)
     return;  /* stack not completely built yet */
@@ -235,7 +314,7 @@ static void init_registry (lua_State *L, global_State *g) {
 static void f_luaopen (lua_State *L, void *ud) {
   global_State *g = G(L);
   UNUSED(ud);
-  stack_init(L, L);  /* init stack */
+  stack_init(L, L, BASIC_STACK_SIZE);  /* init stack */
   init_registry(L, g);
   luaS_init(L);
   luaT_init(L);
@@ -254,6 +333,7 @@ static void preinit_thread (lua_State *L, global_State *g) {
   G(L) = g;
   L->stack = NULL;
   L->ci = NULL;
+  L->cichunk = NULL;
   L->nci = 0;
   L->twups = L;  /* thread has no upvalues */
   L->errorJmp = NULL;
@@ -266,30 +346,61 @@ static void preinit_thread (lua_State *L, global_State *g) {
   L->status = LUA_OK;
   L->errfunc = 0;
   L->oldpc = 0;
+  L->nexttable = NULL;
+  L->nextnode = 0;
+  L->stackcycles = 0;
+  L->stackpeak = 0;
+  L->stackgrows = L->stackshrinks = 0;
+  L->budgetmode = LUA_BUDGETOFF;
+  L->budgetgrace = 0;
+  L->budget = L->budgetslice = MAX_LMEM;
 }
 
 
 static void close_state (lua_State *L) {
   global_State *g = G(L);
   luaF_close(L, L->stack, CLOSEPROTECT);  /* close all upvalues */
+  g->poolsize = 0;  /* do not keep dead threads anymore */
   luaC_freeallobjects(L);  /* collect all objects */
+  luaE_shrinkpool(L, 0);  /* free all threads in the pool */
   if (ttisnil(&g->nilvalue))  /* closing a fully built state? */
     luai_userstateclose(L);
   luaM_freearray(L, G(L)->strt.hash, G(L)->strt.size);
+  if (G(L)->strt.old != NULL)  /* was string table growing? */
+    luaM_freearray(L, G(L)->strt.old, G(L)->strt.oldsize);
   freestack(L);
+  luaE_freecipool(L);
   lua_assert(gettotalbytes(g) == sizeof(LG));
   (*g->frealloc)(g->ud, fromstate(L), sizeof(LG), 0);  /* free main block */
 }
 
 
+/*
+** Creates a new thread, reusing one from the pool when possible. A
+** thread in the pool is not linked in the GC lists and has a clean
+** stack of size 'g->threadstack', so that only its fields need to be
+** reset.
+*/
 LUA_API lua_State *lua_newthread (lua_State *L) {
   global_State *g;
   lua_State *L1;
+  StkId stack = NULL;
+  CIChunk *cichunk = NULL;
+  unsigned short nci = 0;
   lua_lock(L);
   g = G(L);
   luaC_checkGC(L);
-  /* create new thread */
-  L1 = &cast(LX *, luaM_newobject(L, LUA_TTHREAD, sizeof(LX)))->l;
+  if (g->threadpool != NULL) {  /* reuse a thread from the pool? */
+    L1 = gco2th(g->threadpool);
+    g->threadpool = L1->next;
+    g->npooled--;
+    g->nreused++;
+    stack = L1->stack;
+    cichunk = L1->cichunk;
+    nci = L1->nci;
+  }
+  else  /* create new thread */
+    L1 = &cast(LX *, luaM_newobject(L, LUA_TTHREAD, sizeof(LX)))->l;
   L1->marked = luaC_white(g);
   L1->tt = LUA_VTHREAD;
   /* link it on list 'allgc' */
@@ -304,23 +415,79 @@ LUA_API lua_State *lua_newthread (lua_State *L) {
   L1->basehookcount = L->basehookcount;
   L1->hook = L->hook;
   resethookcount(L1);
+  if (L->budgetmode == LUA_BUDGETERROR) {  /* inherit an error budget */
+    L1->budgetmode = L->budgetmode;
+    L1->budget = L1->budgetslice = L->budgetslice;
+  }
   /* initialize L1 extra space */
   memcpy(lua_getextraspace(L1), lua_getextraspace(g->mainthread),
          LUA_EXTRASPACE);
   luai_userstatethread(L, L1);
-  stack_init(L1, L);  /* init stack */
+  if (stack != NULL) {  /* reused thread? */
+    L1->stack = stack;  /* restore its stack and CallInfo list */
+    L1->stack_last = stack + g->threadstack;
+    L1->stackpeak = g->threadstack;
+    L1->cichunk = cichunk;
+    L1->nci = nci;
+    baseci_init(L1);
+  }
+  else
+    stack_init(L1, L, g->threadstack);  /* init stack */
   lua_unlock(L);
   return L1;
 }
 
 
+/*
+** Try to keep a dead thread in the pool for reuse, with a clean stack
+** of size 'g->threadstack'. Called during collections, so it cannot
+** allocate memory; shrinking the stack never fails, but a stack
+** smaller than 'g->threadstack' cannot go to the pool. Other fields
+** will be reset when the thread is reused.
+*/
+static int poolthread (lua_State *L, lua_State *L1) {
+  global_State *g = G(L);
+  StkId o;
+  if (g->npooled >= g->poolsize || L1->stack == NULL ||
+      stacksize(L1) < g->threadstack)
+    return 0;
+  L1->ci = &L1->base_ci;  /* unwind CallInfo list (keeping its entries) */
+  if (stacksize(L1) > g->threadstack &&
+      !luaD_reallocstack(L1, g->threadstack, 0))
+    return 0;
+  for (o = L1->stack; o < L1->stack_last + EXTRA_STACK; o++)
+    setnilvalue(s2v(o));  /* erase stack */
+  L1->next = g->threadpool;
+  g->threadpool = obj2gco(L1);
+  g->npooled++;
+  return 1;
+}
+
+
 void luaE_freethread (lua_State *L, lua_State *L1) {
   LX *l = fromstate(L1);
   luaF_close(L1, L1->stack, NOCLOSINGMETH);  /* close all upvalues */
   lua_assert(L1->openupval == NULL);
   luai_userstatefree(L, L1);
-  freestack(L1);
-  luaM_free(L, l);
+  if (!poolthread(L, L1)) {
+    freestack(L1);
+    luaM_free(L, l);
+  }
+}
+
+
+/*
+** Free threads from the pool until it has at most 'n' of them
+*/
+void luaE_shrinkpool (lua_State *L, int n) {
+  global_State *g = G(L);
+  while (g->npooled > n) {
+    lua_State *L1 = gco2th(g->threadpool);
+    g->threadpool = L1->next;
+    g->npooled--;
+    freestack(L1);
+    luaM_free(L, fromstate(L1));
+  }
 }
 
 
@@ -370,7 +537,11 @@ LUA_API lua_State *lua_newstate (lua_Alloc f, void *ud) {
   g->seed = luai_makeseed(L);
   g->gcrunning = 0;  /* no GC while building state */
   g->strt.size = g->strt.nuse = 0;
-  g->strt.hash = NULL;
+  g->strt.hash = g->strt.old = NULL;
+  g->strt.oldsize = g->strt.moved = 0;
+  g->shortlen = LUAI_MAXSHORTLEN;
+  g->longestshr = 0;
+  g->shortestlng = MAX_SIZE;
   setnilvalue(&g->l_registry);
   g->panic = NULL;
   g->gcstate = GCSpause;
@@ -383,6 +554,15 @@ LUA_API lua_State *lua_newstate (lua_Alloc f, void *ud) {
   g->gray = g->grayagain = NULL;
   g->weak = g->ephemeron = g->allweak = NULL;
   g->twups = NULL;
+  g->threadpool = NULL;
+  g->npooled = 0;
+  g->poolsize = LUAI_THREADPOOL;
+  g->threadstack = BASIC_STACK_SIZE;
+  g->nreused = 0;
+  for (i = 0; i < NCICLASSES; i++) {
+    g->cipool[i] = NULL;
+    g->ncipool[i] = 0;
+  }
   g->totalbytes = sizeof(LG);
   g->GCdebt = 0;
   g->lastatomic = 0;
@@ -390,9 +570,18 @@ LUA_API lua_State *lua_newstate (lua_Alloc f, void *ud) {
   setgcparam(g->gcpause, LUAI_GCPAUSE);
   setgcparam(g->gcstepmul, LUAI_GCMUL);
   g->gcstepsize = LUAI_GCSTEPSIZE;
+  g->gcnworkers = 1;
+  g->gcdeferfin = 0;
+  g->stackshrink = LUAI_STACKSHRINK;
+  g->gcfintimed = 0;
+  g->finstats.count = 0;
+  g->finstats.time = g->finstats.maxtime = 0;
   setgcparam(g->genmajormul, LUAI_GENMAJORMUL);
   g->genminormul = LUAI_GENMINORMUL;
   for (i=0; i < LUA_NUMTAGS; i++) g->mt[i] = NULL;
+#if defined(LUA_VMSTATS)
+  memset(g->opcount, 0, sizeof(g->opcount));
+#endif
   if (luaD_rawrunprotected(L, f_luaopen, NULL) != LUA_OK) {
     /* memory allocation error: free partial state */
     close_state(L);
@@ -13,6 +13,10 @@
 #include "ltm.h"
 #include "lzio.h"
 
+#if defined(LUA_VMSTATS)
+#include "lopcodes.h"
+#endif
+
 
 /*
 ** Some notes about garbage-collected objects: All objects in Lua must
@@ -139,6 +143,24 @@ struct lua_longjmp;  /* defined in ldo.c */
 
 #define BASIC_STACK_SIZE        (2*LUA_MINSTACK)
 
+/* minimum stack size for a thread (space for its base CallInfo) */
+#define MIN_STACK_SIZE		(LUA_MINSTACK + 1)
+
+
+/* default maximum number of dead threads kept for reuse */
+#if !defined(LUAI_THREADPOOL)
+#define LUAI_THREADPOOL		64
+#endif
+
+/*
+** default number of consecutive collections that must find a stack
+** oversized before the collector shrinks it (in generational mode,
+** each minor collection counts)
+*/
+#if !defined(LUAI_STACKSHRINK)
+#define LUAI_STACKSHRINK	20
+#endif
+
 #define stacksize(th)	cast_int((th)->stack_last - (th)->stack)
 
 
@@ -147,10 +169,24 @@ struct lua_longjmp;  /* defined in ldo.c */
 #define KGC_GEN		1	/* generational gc */
 
 
+/*
+** Statistics about finalizers (times in seconds, measured only in
+** deferred mode or after the statistics were requested)
+*/
+typedef struct FinStats {
+  lu_mem count;  /* number of finalizers called */
+  lua_Number time;  /* total time spent running finalizers */
+  lua_Number maxtime;  /* longest time spent by a single finalizer */
+} FinStats;
+
+
 typedef struct stringtable {
   TString **hash;
   int nuse;  /* number of elements */
   int size;
+  TString **old;  /* previous array, while table is growing (or NULL) */
+  int oldsize;  /* size of 'old' */
+  int moved;  /* number of lists already moved from 'old' to 'hash' */
 } stringtable;
 
 
@@ -186,6 +222,32 @@ typedef struct CallInfo {
 } CallInfo;
 
 
+/*
+** CallInfo entries are allocated in chunks. The first chunk of a thread
+** has CIMINCHUNK entries and each new chunk doubles that size, up to
+** NCICLASSES sizes; so, shallow threads use little memory while deep
+** call chains get contiguous entries. Free chunks are kept in the
+** global state, by size, for reuse by other threads.
+*/
+#define CIMINCHUNK	4
+#define NCICLASSES	4
+
+/* maximum number of free chunks of each size kept for reuse */
+#if !defined(LUAI_CIPOOL)
+#define LUAI_CIPOOL	32
+#endif
+
+typedef struct CIChunk {
+  struct CIChunk *prev;  /* previous chunk of a thread (or next free one) */
+  lu_byte szclass;  /* chunk has 'CIMINCHUNK << szclass' entries */
+  CallInfo ci[1];  /* entries */
+} CIChunk;
+
+#define cichunksize(c)	(CIMINCHUNK << (c))
+#define sizeCIChunk(c)	(offsetof(CIChunk, ci) + \
+			 cast_sizet(cichunksize(c)) * sizeof(CallInfo))
+
+
 /*
 ** Bits in CallInfo status
 */
@@ -227,6 +289,9 @@ typedef struct global_State {
   TValue l_registry;
   TValue nilvalue;  /* a nil value */
   unsigned int seed;  /* randomized seed for hashes */
+  size_t shortestlng;  /* length of the shortest long string ever created */
+  lu_byte shortlen;  /* maximum length for short strings */
+  lu_byte longestshr;  /* length of the longest short string ever created */
   lu_byte currentwhite;
   lu_byte gcstate;  /* state of garbage collector */
   lu_byte gckind;  /* kind of GC running */
@@ -237,6 +302,10 @@ typedef struct global_State {
   lu_byte gcpause;  /* size of pause between successive GCs */
   lu_byte gcstepmul;  /* GC "speed" */
   lu_byte gcstepsize;  /* (log2 of) GC granularity */
+  lu_byte gcnworkers;  /* number of threads for parallel marking */
+  lu_byte gcdeferfin;  /* true if finalizers run only when requested */
+  lu_byte gcfintimed;  /* true if finalizer statistics were requested */
+  lu_byte stackshrink;  /* cycles a stack stays oversized before shrinking */
   GCObject *allgc;  /* list of all collectable objects */
   GCObject **sweepgc;  /* current position of sweep in list */
   GCObject *finobj;  /* list of collectable objects with finalizers */
@@ -246,6 +315,7 @@ typedef struct global_State {
   GCObject *ephemeron;  /* list of ephemeron tables (weak keys) */
   GCObject *allweak;  /* list of all-weak tables */
   GCObject *tobefnz;  /* list of userdata to be GC */
+  FinStats finstats;  /* statistics about finalizers */
   GCObject *fixedgc;  /* list of objects not to be collected */
   /* fields for generational collector */
   GCObject *survival;  /* start of objects that survived one GC cycle */
@@ -256,6 +326,13 @@ typedef struct global_State {
   GCObject *finobjold1;  /* list of old1 objects with finalizers */
   GCObject *finobjrold;  /* list of really old objects with finalizers */
   struct lua_State *twups;  /* list of threads with open upvalues */
+  GCObject *threadpool;  /* list of dead threads kept for reuse */
+  int npooled;  /* number of threads in 'threadpool' */
+  int poolsize;  /* maximum number of threads in 'threadpool' */
+  int threadstack;  /* initial stack size for new threads */
+  lu_mem nreused;  /* number of threads created from the pool */
+  CIChunk *cipool[NCICLASSES];  /* free CallInfo chunks, by size */
+  int ncipool[NCICLASSES];  /* number of chunks in each 'cipool' list */
   lua_CFunction panic;  /* to be called in unprotected errors */
   struct lua_State *mainthread;
   TString *memerrmsg;  /* message for memory-allocation errors */
@@ -264,6 +341,9 @@ typedef struct global_State {
   TString *strcache[STRCACHE_N][STRCACHE_M];  /* cache for strings in API */
   lua_WarnFunction warnf;  /* warning function */
   void *ud_warn;         /* auxiliary data to 'warnf' */
+#if defined(LUA_VMSTATS)
+  lu_mem opcount[NUM_OPCODES];  /* number of executions of each opcode */
+#endif
 } global_State;
 
 
@@ -274,10 +354,14 @@ struct lua_State {
   CommonHeader;
   lu_byte status;
   lu_byte allowhook;
+  lu_byte stackcycles;  /* consecutive collections with oversized stack */
+  lu_byte budgetmode;  /* what to do when 'budget' runs out */
+  lu_byte budgetgrace;  /* true if the grace allowance was given */
   unsigned short nci;  /* number of items in 'ci' list */
   StkId top;  /* first free slot in the stack */
   global_State *l_G;
   CallInfo *ci;  /* call info for current function */
+  CIChunk *cichunk;  /* last chunk of entries in the 'ci' list */
   StkId stack_last;  /* end of stack (last element + 1) */
   StkId stack;  /* stack base */
   UpVal *openupval;  /* list of open upvalues in this stack */
@@ -289,9 +373,16 @@ struct lua_State {
   ptrdiff_t errfunc;  /* current error handling function (stack index) */
   l_uint32 nCcalls;  /* number of nested (non-yieldable | C)  calls */
   int oldpc;  /* last pc traced */
+  struct Table *nexttable;  /* table of the last hash key given by 'next' */
+  unsigned int nextnode;  /* index of that key's node (a hint) */
   int basehookcount;
   int hookcount;
   volatile l_signalT hookmask;
+  l_mem budget;  /* units left before stopping the thread */
+  l_mem budgetslice;  /* units given to the thread at each refill */
+  int stackpeak;  /* largest stack size this thread has had */
+  unsigned int stackgrows;  /* number of stack reallocations to grow it */
+  unsigned int stackshrinks;  /* number of stack reallocations to shrink it */
 };
 
 
@@ -352,9 +443,11 @@ union GCUnion {
 
 LUAI_FUNC void luaE_setdebt (global_State *g, l_mem debt);
 LUAI_FUNC void luaE_freethread (lua_State *L, lua_State *L1);
+LUAI_FUNC void luaE_shrinkpool (lua_State *L, int n);
 LUAI_FUNC CallInfo *luaE_extendCI (lua_State *L);
 LUAI_FUNC void luaE_freeCI (lua_State *L);
 LUAI_FUNC void luaE_shrinkCI (lua_State *L);
+LUAI_FUNC void luaE_freecipool (lua_State *L);
 LUAI_FUNC void luaE_checkcstack (lua_State *L);
 LUAI_FUNC void luaE_incCstack (lua_State *L);
 LUAI_FUNC void luaE_warning (lua_State *L, const char *msg, int tocont);
@@ -40,11 +40,41 @@ int luaS_eqlngstr (TString *a, TString *b) {
 }
 
 
+/*
+** The string hash works on words of the size of a 'size_t'. Each word
+** is mixed into the hash with a multiplication by an odd constant
+** (from the golden ratio), whose high bits are then folded back into
+** the low ones, which are the bits used to index tables. Words are read
+** with 'memcpy', which compilers turn into plain (unaligned) loads.
+*/
+#define HWSIZE		sizeof(size_t)
+#define HWBITS		(HWSIZE * CHAR_BIT)
+
+/* multiplier for the hash (truncated if 'size_t' has 32 bits) */
+#define HMULT	((cast_sizet(0x9E3779B9u) << 16 << 16) | 0x7F4A7C15u)
+
+#define hmix(h,w)	((h) = ((h) ^ (w)) * HMULT, (h) ^= (h) >> (HWBITS / 2))
+
+
 unsigned int luaS_hash (const char *str, size_t l, unsigned int seed) {
-  unsigned int h = seed ^ cast_uint(l);
-  for (; l > 0; l--)
-    h ^= ((h<<5) + (h>>2) + cast_byte(str[l - 1]));
-  return h;
+  size_t h = cast_sizet(seed) ^ l;
+  size_t w;
+  if (l >= HWSIZE) {
+    const char *last = str + (l - HWSIZE);  /* start of the last word */
+    for (; str < last; str += HWSIZE) {
+      memcpy(&w, str, HWSIZE);
+      hmix(h, w);
+    }
+    memcpy(&w, last, HWSIZE);  /* (it may overlap the previous word) */
+  }
+  else {  /* string smaller than a word; pack its bytes */
+    w = 0;
+    for (; l > 0; l--)
+      w = (w << 8) | cast_byte(str[l - 1]);
+  }
+  hmix(h, w);
+  hmix(h, 0);  /* spread the changes in the last word to all bits */
+  return cast_uint(h);
 }
 
 
@@ -77,6 +107,44 @@ static void tablerehash (TString **vect, int osize, int nsize) {
 }
 
 
+/*
+** The string table grows incrementally: 'growstrtab' allocates the new
+** array, and then each new string moves STRTABSTEP lists from the old
+** array to the new one, so that no single string creation has to
+** rehash the whole table. As the new array has twice the size of the
+** old one, all lists are moved long before it can get full. Meanwhile,
+** strings not yet moved are still in the lists of 'old'.
+*/
+#define STRTABSTEP	4
+
+
+/*
+** Move 'n' lists from the old array to the new one, freeing the old
+** array when it gets empty.
+*/
+static void movestrlists (lua_State *L, stringtable *tb, int n) {
+  int i = tb->moved;
+  int lim = (tb->oldsize - i > n) ? i + n : tb->oldsize;
+  for (; i < lim; i++) {
+    TString *p = tb->old[i];
+    while (p) {  /* for each string in the list */
+      TString *hnext = p->u.hnext;  /* save next */
+      unsigned int h = lmod(p->hash, tb->size);  /* new position */
+      p->u.hnext = tb->hash[h];  /* chain it into new array */
+      tb->hash[h] = p;
+      p = hnext;
+    }
+    tb->old[i] = NULL;
+  }
+  tb->moved = i;
+  if (i == tb->oldsize) {  /* moved everything? */
+    luaM_freearray(L, tb->old, tb->oldsize);
+    tb->old = NULL;
+    tb->oldsize = tb->moved = 0;
+  }
+}
+
+
 /*
 ** Resize the string table. If allocation fails, keep the current size.
 ** (This can degrade performance, but any non-zero size should work
@@ -84,8 +152,11 @@ static void tablerehash (TString **vect, int osize, int nsize) {
 */
 void luaS_resize (lua_State *L, int nsize) {
   stringtable *tb = &G(L)->strt;
-  int osize = tb->size;
+  int osize;
   TString **newvect;
+  if (tb->old != NULL)  /* table still growing? */
+    movestrlists(L, tb, tb->oldsize);  /* finish it */
+  osize = tb->size;
   if (nsize < osize)  /* shrinking table? */
     tablerehash(tb->hash, osize, nsize);  /* depopulate shrinking part */
   newvect = luaM_reallocvector(L, tb->hash, osize, nsize, TString*);
@@ -155,8 +226,11 @@ static TString *createstrobj (lua_State *L, size_t l, int tag, unsigned int h) {
 
 
 TString *luaS_createlngstrobj (lua_State *L, size_t l) {
-  TString *ts = createstrobj(L, l, LUA_VLNGSTR, G(L)->seed);
+  global_State *g = G(L);
+  TString *ts = createstrobj(L, l, LUA_VLNGSTR, g->seed);
   ts->u.lnglen = l;
+  if (l < g->shortestlng)
+    g->shortestlng = l;
   return ts;
 }
 
@@ -164,21 +238,58 @@ TString *luaS_createlngstrobj (lua_State *L, size_t l) {
 void luaS_remove (lua_State *L, TString *ts) {
   stringtable *tb = &G(L)->strt;
   TString **p = &tb->hash[lmod(ts->hash, tb->size)];
-  while (*p != ts)  /* find previous element */
+  while (*p != ts && *p != NULL)  /* find previous element */
     p = &(*p)->u.hnext;
+  if (*p == NULL) {  /* not there? */
+    lua_assert(tb->old != NULL);  /* then it was not moved yet */
+    p = &tb->old[lmod(ts->hash, tb->oldsize)];
+    while (*p != ts)  /* find previous element */
+      p = &(*p)->u.hnext;
+  }
   *p = (*p)->u.hnext;  /* remove element from its list */
   tb->nuse--;
 }
 
 
+/*
+** Start growing the string table; if allocation fails, keep the
+** current size (as in 'luaS_resize').
+*/
 static void growstrtab (lua_State *L, stringtable *tb) {
   if (unlikely(tb->nuse == MAX_INT)) {  /* too many strings? */
     luaC_fullgc(L, 1);  /* try to free some... */
     if (tb->nuse == MAX_INT)  /* still too many? */
       luaM_error(L);  /* cannot even create a message... */
   }
-  if (tb->size <= MAXSTRTB / 2)  /* can grow string table? */
-    luaS_resize(L, tb->size * 2);
+  if (tb->size <= MAXSTRTB / 2 && tb->old == NULL) {  /* can grow? */
+    int nsize = tb->size * 2;
+    TString **newvect = luaM_reallocvector(L, NULL, 0, nsize, TString*);
+    if (newvect != NULL) {  /* allocation succeeded? */
+      tablerehash(newvect, 0, nsize);  /* clear array */
+      tb->old = tb->hash;
+      tb->oldsize = tb->size;
+      tb->moved = 0;
+      tb->hash = newvect;
+      tb->size = nsize;
+    }
+  }
+}
+
+
+/*
+** Search for a short string in a list of the string table.
+*/
+static TString *findshrstr (global_State *g, TString *ts,
+                            const char *str, size_t l) {
+  for (; ts != NULL; ts = ts->u.hnext) {
+    if (l == ts->shrlen && (memcmp(str, getstr(ts), l * sizeof(char)) == 0)) {
+      /* found! */
+      if (isdead(g, ts))  /* dead (but not collected yet)? */
+        changewhite(ts);  /* resurrect it */
+      return ts;
+    }
+  }
+  return NULL;
 }
 
 
@@ -190,36 +301,59 @@ static TString *internshrstr (lua_State *L, const char *str, size_t l) {
   global_State *g = G(L);
   stringtable *tb = &g->strt;
   unsigned int h = luaS_hash(str, l, g->seed);
-  TString **list = &tb->hash[lmod(h, tb->size)];
+  TString **list;
   lua_assert(str != NULL);  /* otherwise 'memcmp'/'memcpy' are undefined */
-  for (ts = *list; ts != NULL; ts = ts->u.hnext) {
-    if (l == ts->shrlen && (memcmp(str, getstr(ts), l * sizeof(char)) == 0)) {
-      /* found! */
-      if (isdead(g, ts))  /* dead (but not collected yet)? */
-        changewhite(ts);  /* resurrect it */
-      return ts;
+  ts = findshrstr(g, tb->hash[lmod(h, tb->size)], str, l);
+  if (ts != NULL)
+    return ts;
+  if (tb->old != NULL) {  /* table is growing? */
+    int i = lmod(h, tb->oldsize);
+    if (i >= tb->moved) {  /* list not moved yet? */
+      ts = findshrstr(g, tb->old[i], str, l);
+      if (ts != NULL)
+        return ts;
     }
+    movestrlists(L, tb, STRTABSTEP);  /* do some work */
   }
-  /* else must create a new string */
-  if (tb->nuse >= tb->size) {  /* need to grow string table? */
+  else if (tb->nuse >= tb->size)  /* need to grow string table? */
     growstrtab(L, tb);
-    list = &tb->hash[lmod(h, tb->size)];  /* rehash with new size */
-  }
+  /* else must create a new string */
+  list = &tb->hash[lmod(h, tb->size)];
   ts = createstrobj(L, l, LUA_VSHRSTR, h);
   memcpy(getstr(ts), str, l * sizeof(char));
   ts->shrlen = cast_byte(l);
   ts->u.hnext = *list;
   *list = ts;
   tb->nuse++;
+  if (l > g->longestshr)
+    g->longestshr = cast_byte(l);
   return ts;
 }
 
 
+/*
+** Set the maximum length for short strings. That is only possible when
+** no existing string would be of a different kind under the new limit.
+** (Equality of short strings is by identity, so two strings with equal
+** contents must be of the same kind.) To keep that check simple, the
+** state keeps the lengths of the longest short string and of the
+** shortest long string ever created.
+*/
+int luaS_setshortlen (lua_State *L, int n) {
+  global_State *g = G(L);
+  lua_assert(MINSHORTLEN <= n && n <= LIMSHORTLEN);
+  if (n < g->longestshr || cast_sizet(n) >= g->shortestlng)
+    return 0;  /* some string would change its kind */
+  g->shortlen = cast_byte(n);
+  return 1;
+}
+
+
 /*
 ** new string (with explicit length)
 */
 TString *luaS_newlstr (lua_State *L, const char *str, size_t l) {
-  if (l <= LUAI_MAXSHORTLEN)  /* short string? */
+  if (l <= G(L)->shortlen)  /* short string? */
     return internshrstr(L, str, l);
   else {
     TString *ts;
@@ -147,26 +147,50 @@ static int str_upper (lua_State *L) {
 }
 
 
-static int str_rep (lua_State *L) {
+/*
+** Repetition described by the arguments 'arg' (string), 'arg + 1'
+** (count), and 'arg + 2' (separator).
+*/
+typedef struct Rep {
+  const char *s, *sep;
   size_t l, lsep;
-  const char *s = luaL_checklstring(L, 1, &l);
-  lua_Integer n = luaL_checkinteger(L, 2);
-  const char *sep = luaL_optlstring(L, 3, "", &lsep);
-  if (n <= 0) lua_pushliteral(L, "");
-  else if (l + lsep < l || l + lsep > MAXSIZE / n)  /* may overflow? */
+  lua_Integer n;
+} Rep;
+
+
+/* check arguments for a repetition and return its total length */
+static size_t checkrep (lua_State *L, Rep *r, int arg) {
+  r->s = luaL_checklstring(L, arg, &r->l);
+  r->n = luaL_checkinteger(L, arg + 1);
+  r->sep = luaL_optlstring(L, arg + 2, "", &r->lsep);
+  if (r->n <= 0) return 0;
+  else if (r->l + r->lsep < r->l || r->l + r->lsep > MAXSIZE / r->n)
     return luaL_error(L, "resulting string too large");
+  else
+    return (size_t)r->n * r->l + (size_t)(r->n - 1) * r->lsep;
+}
+
+
+static void fillrep (char *p, const Rep *r) {
+  lua_Integer n = r->n;
+  while (n-- > 1) {  /* first n-1 copies (followed by separator) */
+    memcpy(p, r->s, r->l * sizeof(char)); p += r->l;
+    if (r->lsep > 0) {  /* empty 'memcpy' is not that cheap */
+      memcpy(p, r->sep, r->lsep * sizeof(char));
+      p += r->lsep;
+    }
+  }
+  memcpy(p, r->s, r->l * sizeof(char));  /* last copy (not followed by separator) */
+}
+
+
+static int str_rep (lua_State *L) {
+  Rep r;
+  size_t totallen = checkrep(L, &r, 1);
+  if (totallen == 0) lua_pushliteral(L, "");
   else {
-    size_t totallen = (size_t)n * l + (size_t)(n - 1) * lsep;
     luaL_Buffer b;
-    char *p = luaL_buffinitsize(L, &b, totallen);
-    while (n-- > 1) {  /* first n-1 copies (followed by separator) */
-      memcpy(p, s, l * sizeof(char)); p += l;
-      if (lsep > 0) {  /* empty 'memcpy' is not that cheap */
-        memcpy(p, sep, lsep * sizeof(char));
-        p += lsep;
-      }
-    }
-    memcpy(p, s, l * sizeof(char));  /* last copy (not followed by separator) */
+    fillrep(luaL_buffinitsize(L, &b, totallen), &r);
     luaL_pushresultsize(&b, totallen);
   }
   return 1;
@@ -1186,11 +1210,20 @@ static void addliteral (lua_State *L, luaL_Buffer *b, int arg) {
 }
 
 
-static const char *scanformat (lua_State *L, const char *strfrmt, char *form) {
+/*
+** Read a conversion specification (flags, width, precision, and
+** conversion character) into 'form'. Returns the address of the
+** conversion character or, if the specification is invalid, NULL
+** with an error message in '*msg'.
+*/
+static const char *scanformat (const char *strfrmt, char *form,
+                               const char **msg) {
   const char *p = strfrmt;
   while (*p != '\0' && strchr(L_FMTFLAGS, *p) != NULL) p++;  /* skip flags */
-  if ((size_t)(p - strfrmt) >= sizeof(L_FMTFLAGS)/sizeof(char))
-    luaL_error(L, "invalid format (repeated flags)");
+  if ((size_t)(p - strfrmt) >= sizeof(L_FMTFLAGS)/sizeof(char)) {
+    *msg = "invalid format (repeated flags)";
+    return NULL;
+  }
   if (isdigit(uchar(*p))) p++;  /* skip width */
   if (isdigit(uchar(*p))) p++;  /* (2 digits at most) */
   if (*p == '.') {
@@ -1198,8 +1231,10 @@ static const char *scanformat (lua_State *L, const char *strfrmt, char *form) {
     if (isdigit(uchar(*p))) p++;  /* skip precision */
     if (isdigit(uchar(*p))) p++;  /* (2 digits at most) */
   }
-  if (isdigit(uchar(*p)))
-    luaL_error(L, "invalid format (width or precision too long)");
+  if (isdigit(uchar(*p))) {
+    *msg = "invalid format (width or precision too long)";
+    return NULL;
+  }
   *(form++) = '%';
   memcpy(form, strfrmt, ((p - strfrmt) + 1) * sizeof(char));
   form += (p - strfrmt) + 1;
@@ -1221,95 +1256,257 @@ static void addlenmod (char *form, const char *lenmod) {
 }
 
 
-static int str_format (lua_State *L) {
-  int top = lua_gettop(L);
-  int arg = 1;
-  size_t sfl;
-  const char *strfrmt = luaL_checklstring(L, arg, &sfl);
-  const char *strfrmt_end = strfrmt+sfl;
-  luaL_Buffer b;
-  luaL_buffinit(L, &b);
-  while (strfrmt < strfrmt_end) {
-    if (*strfrmt != L_ESC)
-      luaL_addchar(&b, *strfrmt++);
-    else if (*++strfrmt == L_ESC)
-      luaL_addchar(&b, *strfrmt++);  /* %% */
-    else { /* format item */
-      char form[MAX_FORMAT];  /* to store the format ('%...') */
-      int maxitem = MAX_ITEM;
-      char *buff = luaL_prepbuffsize(&b, maxitem);  /* to put formatted item */
-      int nb = 0;  /* number of bytes in added item */
-      if (++arg > top)
-        return luaL_argerror(L, arg, "no value");
-      strfrmt = scanformat(L, strfrmt, form);
-      switch (*strfrmt++) {
-        case 'c': {
-          nb = l_sprintf(buff, maxitem, form, (int)luaL_checkinteger(L, arg));
-          break;
-        }
+/*
+** Compiled formats: each format string is translated once into a
+** sequence of items, one for each conversion, which are kept in a cache
+** indexed by the format string (the first upvalue of the functions
+** that format).
+*/
+
+/* maximum number of compiled formats kept in the cache */
+#if !defined(L_FMTCACHE)
+#define L_FMTCACHE	64
+#endif
+
+
+typedef struct FmtItem {
+  size_t litpos, litlen;  /* literal text before the conversion */
+  const char *msg;  /* error message for an invalid specification */
+  char conv;  /* conversion character */
+  char simple;  /* true if conversion has no flags, width, or precision */
+  char form[MAX_FORMAT];  /* format for 'l_sprintf' (with length modifier) */
+} FmtItem;
+
+
+typedef struct FmtProg {
+  size_t litpos, litlen;  /* literal text after the last conversion */
+  int nitems;
+  FmtItem items[1];  /* (actual size is 'nitems') */
+} FmtProg;
+
+
+/*
+** Compile a format. Compilation does not raise errors: an invalid
+** specification ends the program with an item that raises the error
+** when executed, so that errors appear in the same order as in a
+** direct interpretation of the format.
+*/
+static FmtProg *compileformat (lua_State *L, const char *strfrmt,
+                               size_t sfl) {
+  const char *strfrmt_end = strfrmt + sfl;
+  const char *lit = strfrmt;
+  const char *p = strfrmt;
+  FmtProg *prog;
+  int n = 0;
+  while ((p = (const char *)memchr(p, L_ESC, strfrmt_end - p)) != NULL) {
+    n++;  /* each item starts with a '%' */
+    p++;
+  }
+  prog = (FmtProg *)lua_newuserdatauv(L, offsetof(FmtProg, items) +
+                                         n * sizeof(FmtItem), 0);
+  n = 0;
+  p = strfrmt;
+  while ((p = (const char *)memchr(p, L_ESC, strfrmt_end - p)) != NULL) {
+    FmtItem *item = &prog->items[n++];
+    item->litpos = lit - strfrmt;
+    item->litlen = p - lit;
+    item->msg = NULL;
+    if (*++p == L_ESC) {  /* %% */
+      item->conv = L_ESC;
+      p++;
+    }
+    else {
+      const char *spec = scanformat(p, item->form, &item->msg);
+      if (spec == NULL)  /* invalid specification? */
+        break;  /* program ends with this item */
+      item->conv = *spec;
+      item->simple = (spec == p);
+      p = spec + 1;
+      switch (item->conv) {
         case 'd': case 'i':
-        case 'o': case 'u': case 'x': case 'X': {
-          lua_Integer n = luaL_checkinteger(L, arg);
-          addlenmod(form, LUA_INTEGER_FRMLEN);
-          nb = l_sprintf(buff, maxitem, form, (LUAI_UACINT)n);
+        case 'o': case 'u': case 'x': case 'X':
+          addlenmod(item->form, LUA_INTEGER_FRMLEN);
           break;
-        }
-        case 'a': case 'A':
-          addlenmod(form, LUA_NUMBER_FRMLEN);
-          nb = lua_number2strx(L, buff, maxitem, form,
-                                  luaL_checknumber(L, arg));
+        case 'a': case 'A': case 'f':
+        case 'e': case 'E': case 'g': case 'G':
+          addlenmod(item->form, LUA_NUMBER_FRMLEN);
           break;
-        case 'f':
-          maxitem = MAX_ITEMF;  /* extra space for '%f' */
-          buff = luaL_prepbuffsize(&b, maxitem);
-          /* FALLTHROUGH */
-        case 'e': case 'E': case 'g': case 'G': {
-          lua_Number n = luaL_checknumber(L, arg);
-          addlenmod(form, LUA_NUMBER_FRMLEN);
-          nb = l_sprintf(buff, maxitem, form, (LUAI_UACNUMBER)n);
+        case 'c': case 'p': case 'q': case 's':
           break;
-        }
-        case 'p': {
-          const void *p = lua_topointer(L, arg);
-          if (p == NULL) {  /* avoid calling 'printf' with argument NULL */
-            p = "(null)";  /* result */
-            form[strlen(form) - 1] = 's';  /* format it as a string */
-          }
-          nb = l_sprintf(buff, maxitem, form, p);
+        default:  /* invalid conversion */
+          p = strfrmt_end;  /* program ends with this item */
           break;
-        }
-        case 'q': {
-          if (form[2] != '\0')  /* modifiers? */
-            return luaL_error(L, "specifier '%%q' cannot have modifiers");
-          addliteral(L, &b, arg);
+      }
+      if (p >= strfrmt_end)  /* ended the format? */
+        break;
+    }
+    lit = p;
+  }
+  prog->nitems = n;
+  if (p == NULL) {  /* format ended normally? */
+    prog->litpos = lit - strfrmt;
+    prog->litlen = strfrmt_end - lit;
+  }
+  else
+    prog->litpos = prog->litlen = 0;
+  return prog;
+}
+
+
+/*
+** Push the compiled program for the format at index 'arg', either
+** from the cache or compiling the format, and return it.
+*/
+static const FmtProg *getformat (lua_State *L, int arg) {
+  size_t sfl;
+  const char *strfrmt = luaL_checklstring(L, arg, &sfl);
+  int cache = lua_upvalueindex(1);
+  lua_Integer n;
+  lua_pushvalue(L, arg);
+  if (lua_rawget(L, cache) == LUA_TUSERDATA)  /* format in the cache? */
+    return (const FmtProg *)lua_touserdata(L, -1);
+  lua_pop(L, 1);
+  lua_rawgeti(L, cache, 1);  /* get number of entries in the cache */
+  n = lua_tointeger(L, -1);
+  lua_pop(L, 1);
+  if (n >= L_FMTCACHE) {  /* cache is full? */
+    lua_cleartable(L, cache);  /* start it again */
+    n = 0;
+  }
+  lua_pushinteger(L, n + 1);
+  lua_rawseti(L, cache, 1);
+  compileformat(L, strfrmt, sfl);
+  lua_pushvalue(L, arg);
+  lua_pushvalue(L, -2);
+  lua_rawset(L, cache);  /* cache[format] = program */
+  return (const FmtProg *)lua_touserdata(L, -1);
+}
+
+
+/*
+** Convert integer 'n' to decimal, as "%d" does.
+*/
+static int int2str (char *buff, lua_Integer n) {
+  char digits[MAX_ITEM];
+  lua_Unsigned u = (n < 0) ? 0u - (lua_Unsigned)n : (lua_Unsigned)n;
+  int nd = 0, nb = 0;
+  do {
+    digits[nd++] = (char)('0' + u % 10);
+    u /= 10;
+  } while (u > 0);
+  if (n < 0)
+    buff[nb++] = '-';
+  while (nd > 0)
+    buff[nb++] = digits[--nd];
+  return nb;
+}
+
+
+/*
+** Add to buffer 'b' the result of running program 'prog' for the
+** format at index 'arg' over the arguments up to 'top'.
+*/
+static void addformat (lua_State *L, luaL_Buffer *b, const FmtProg *prog,
+                       int arg, int top) {
+  const char *strfrmt = lua_tostring(L, arg);
+  int i;
+  for (i = 0; i < prog->nitems; i++) {
+    const FmtItem *item = &prog->items[i];
+    int maxitem = MAX_ITEM;
+    char *buff;  /* to put formatted item */
+    int nb = 0;  /* number of bytes in added item */
+    luaL_addlstring(b, strfrmt + item->litpos, item->litlen);
+    if (item->conv == L_ESC) {  /* %% */
+      luaL_addchar(b, L_ESC);
+      continue;
+    }
+    buff = luaL_prepbuffsize(b, maxitem);
+    if (++arg > top)
+      luaL_argerror(L, arg, "no value");
+    if (item->msg != NULL)
+      luaL_error(L, "%s", item->msg);
+    switch (item->conv) {
+      case 'c': {
+        nb = l_sprintf(buff, maxitem, item->form,
+                             (int)luaL_checkinteger(L, arg));
+        break;
+      }
+      case 'd': case 'i':
+        if (item->simple) {  /* plain "%d"? */
+          nb = int2str(buff, luaL_checkinteger(L, arg));
           break;
         }
-        case 's': {
-          size_t l;
-          const char *s = luaL_tolstring(L, arg, &l);
-          if (form[2] == '\0')  /* no modifiers? */
-            luaL_addvalue(&b);  /* keep entire string */
-          else {
-            luaL_argcheck(L, l == strlen(s), arg, "string contains zeros");
-            if (!strchr(form, '.') && l >= 100) {
-              /* no precision and string is too long to be formatted */
-              luaL_addvalue(&b);  /* keep entire string */
-            }
-            else {  /* format the string into 'buff' */
-              nb = l_sprintf(buff, maxitem, form, s);
-              lua_pop(L, 1);  /* remove result from 'luaL_tolstring' */
-            }
-          }
-          break;
+        /* FALLTHROUGH */
+      case 'o': case 'u': case 'x': case 'X': {
+        lua_Integer n = luaL_checkinteger(L, arg);
+        nb = l_sprintf(buff, maxitem, item->form, (LUAI_UACINT)n);
+        break;
+      }
+      case 'a': case 'A':
+        nb = lua_number2strx(L, buff, maxitem, item->form,
+                                luaL_checknumber(L, arg));
+        break;
+      case 'f':
+        maxitem = MAX_ITEMF;  /* extra space for '%f' */
+        buff = luaL_prepbuffsize(b, maxitem);
+        /* FALLTHROUGH */
+      case 'e': case 'E': case 'g': case 'G': {
+        lua_Number n = luaL_checknumber(L, arg);
+        nb = l_sprintf(buff, maxitem, item->form, (LUAI_UACNUMBER)n);
+        break;
+      }
+      case 'p': {
+        char form[MAX_FORMAT];
+        const void *p = lua_topointer(L, arg);
+        strcpy(form, item->form);
+        if (p == NULL) {  /* avoid calling 'printf' with argument NULL */
+          p = "(null)";  /* result */
+          form[strlen(form) - 1] = 's';  /* format it as a string */
         }
-        default: {  /* also treat cases 'pnLlh' */
-          return luaL_error(L, "invalid conversion '%s' to 'format'", form);
+        nb = l_sprintf(buff, maxitem, form, p);
+        break;
+      }
+      case 'q': {
+        if (!item->simple)  /* modifiers? */
+          luaL_error(L, "specifier '%%q' cannot have modifiers");
+        addliteral(L, b, arg);
+        break;
+      }
+      case 's': {
+        size_t l;
+        const char *s = luaL_tolstring(L, arg, &l);
+        if (item->simple)  /* no modifiers? */
+          luaL_addvalue(b);  /* keep entire string */
+        else {
+          luaL_argcheck(L, l == strlen(s), arg, "string contains zeros");
+          if (!strchr(item->form, '.') && l >= 100) {
+            /* no precision and string is too long to be formatted */
+            luaL_addvalue(b);  /* keep entire string */
+          }
+          else {  /* format the string into 'buff' */
+            nb = l_sprintf(buff, maxitem, item->form, s);
+            lua_pop(L, 1);  /* remove result from 'luaL_tolstring' */
+          }
         }
+        break;
+      }
+      default: {  /* also treat cases 'pnLlh' */
+        luaL_error(L, "invalid conversion '%s' to 'format'", item->form);
       }
-      lua_assert(nb < maxitem);
-      luaL_addsize(&b, nb);
     }
+    lua_assert(nb < maxitem);
+    luaL_addsize(b, nb);
   }
+  luaL_addlstring(b, strfrmt + prog->litpos, prog->litlen);
+}
+
+
+static int str_format (lua_State *L) {
+  int top = lua_gettop(L);
+  const FmtProg *prog = getformat(L, 1);
+  luaL_Buffer b;
+  luaL_buffinit(L, &b);
+  addformat(L, &b, prog, 1, top);
   luaL_pushresult(&b);
   return 1;
 }
@@ -1317,6 +1514,243 @@ static int str_format (lua_State *L) {
 /* }====================================================== */
 
 
+/*
+** {======================================================
+** STRING BUFFERS
+** =======================================================
+*/
+
+#define tostrbuf(L)	((luaL_StrBuf *)luaL_checkudata(L, 1, LUA_STRBUFHANDLE))
+
+
+static void resizestrbuf (lua_State *L, luaL_StrBuf *sb, size_t newsize) {
+  void *ud;
+  lua_Alloc allocf = lua_getallocf(L, &ud);
+  char *temp = (char *)allocf(ud, sb->b, sb->size, newsize);
+  if (temp == NULL && newsize > 0)  /* allocation error? */
+    luaL_error(L, "not enough memory");
+  sb->b = temp;
+  sb->size = newsize;
+}
+
+
+static int buf_new (lua_State *L) {
+  lua_Integer size = luaL_optinteger(L, 1, 0);
+  luaL_StrBuf *sb;
+  luaL_argcheck(L, 0 <= size && (lua_Unsigned)size <= MAXSIZE, 1,
+                   "out of range");
+  sb = (luaL_StrBuf *)lua_newuserdatauv(L, sizeof(luaL_StrBuf), 0);
+  sb->b = NULL;
+  sb->size = sb->n = 0;
+  luaL_setmetatable(L, LUA_STRBUFHANDLE);
+  if (size > 0)
+    resizestrbuf(L, sb, (size_t)size);
+  return 1;
+}
+
+
+/*
+** Returns a pointer to a free area with at least 'sz' bytes in string
+** buffer 'sb'. Functions that cannot call Lua code (which could
+** change the string buffer) write directly into that area; others
+** build their piece in a 'luaL_Buffer' and then add it with
+** 'addbuffer'.
+*/
+static char *prepstrbuf (lua_State *L, luaL_StrBuf *sb, size_t sz) {
+  if (sb->size - sb->n < sz) {  /* not enough space? */
+    size_t newsize = sb->size * 2;  /* double buffer size */
+    if (MAXSIZE - sz < sb->n)  /* overflow in (sb->n + sz)? */
+      luaL_error(L, "buffer too large");
+    if (newsize < sb->n + sz)  /* double is not big enough? */
+      newsize = sb->n + sz;
+    resizestrbuf(L, sb, newsize);
+  }
+  return sb->b + sb->n;
+}
+
+
+/*
+** Add the content of 'b' to the string buffer at index 1 and remove
+** everything above it from the stack (including the box of 'b', if
+** there is one).
+*/
+static void addbuffer (lua_State *L, luaL_Buffer *b) {
+  luaL_StrBuf *sb = (luaL_StrBuf *)lua_touserdata(L, 1);
+  size_t l = luaL_bufflen(b);
+  if (l > 0) {
+    memcpy(prepstrbuf(L, sb, l), luaL_buffaddr(b), l * sizeof(char));
+    sb->n += l;
+  }
+  lua_settop(L, 1);
+}
+
+
+static int buf_append (lua_State *L) {
+  luaL_StrBuf *sb = tostrbuf(L);
+  int n = lua_gettop(L);
+  int arg;
+  for (arg = 2; arg <= n; arg++) {  /* check all arguments first */
+    if (!lua_isstring(L, arg) && !luaL_testudata(L, arg, LUA_STRBUFHANDLE))
+      luaL_typeerror(L, arg, "string");
+  }
+  for (arg = 2; arg <= n; arg++) {
+    luaL_StrBuf *other = (luaL_StrBuf *)lua_touserdata(L, arg);
+    size_t l;
+    const char *s;
+    if (other != NULL) {  /* a string buffer? */
+      l = other->n;
+      prepstrbuf(L, sb, l);  /* may move 'other' content if 'other == sb' */
+      s = other->b;
+    }
+    else if (lua_isinteger(L, arg)) {  /* format it in place */
+      char *buff = prepstrbuf(L, sb, MAX_ITEM);
+      sb->n += l_sprintf(buff, MAX_ITEM, LUA_INTEGER_FMT,
+                               (LUAI_UACINT)lua_tointeger(L, arg));
+      continue;
+    }
+    else
+      s = lua_tolstring(L, arg, &l);
+    if (l > 0) {
+      memcpy(prepstrbuf(L, sb, l), s, l * sizeof(char));
+      sb->n += l;
+    }
+  }
+  lua_settop(L, 1);
+  return 1;  /* return the buffer */
+}
+
+
+static int buf_format (lua_State *L) {
+  int top = lua_gettop(L);
+  const FmtProg *prog;
+  luaL_Buffer b;
+  tostrbuf(L);
+  prog = getformat(L, 2);
+  luaL_buffinit(L, &b);
+  addformat(L, &b, prog, 2, top);
+  addbuffer(L, &b);
+  return 1;  /* return the buffer */
+}
+
+
+static int buf_rep (lua_State *L) {
+  luaL_StrBuf *sb = tostrbuf(L);
+  Rep r;
+  size_t totallen = checkrep(L, &r, 2);
+  if (totallen > 0) {
+    fillrep(prepstrbuf(L, sb, totallen), &r);
+    sb->n += totallen;
+  }
+  lua_settop(L, 1);
+  return 1;  /* return the buffer */
+}
+
+
+static void addconcatfield (lua_State *L, luaL_Buffer *b, lua_Integer i) {
+  lua_geti(L, 2, i);
+  if (!lua_isstring(L, -1))
+    luaL_error(L, "invalid value (%s) at index %I in table for 'concat'",
+                  luaL_typename(L, -1), (LUAI_UACINT)i);
+  luaL_addvalue(b);
+}
+
+
+/*
+** Same as 'table.concat', but appending the result to the buffer.
+*/
+static int buf_concat (lua_State *L) {
+  luaL_Buffer b;
+  size_t lsep;
+  const char *sep = luaL_optlstring(L, 3, "", &lsep);
+  lua_Integer i = luaL_optinteger(L, 4, 1);
+  lua_Integer last = luaL_opt(L, luaL_checkinteger, 5, luaL_len(L, 2));
+  tostrbuf(L);
+  luaL_buffinit(L, &b);
+  for (; i < last; i++) {
+    addconcatfield(L, &b, i);
+    luaL_addlstring(&b, sep, lsep);
+  }
+  if (i == last)  /* add last value (if interval was not empty) */
+    addconcatfield(L, &b, i);
+  addbuffer(L, &b);
+  return 1;  /* return the buffer */
+}
+
+
+static int buf_reset (lua_State *L) {
+  tostrbuf(L)->n = 0;  /* keep its memory */
+  lua_settop(L, 1);
+  return 1;
+}
+
+
+static int buf_tostring (lua_State *L) {
+  luaL_StrBuf *sb = tostrbuf(L);
+  lua_pushlstring(L, sb->b, sb->n);
+  return 1;
+}
+
+
+static int buf_len (lua_State *L) {
+  lua_pushinteger(L, (lua_Integer)tostrbuf(L)->n);
+  return 1;
+}
+
+
+static int buf_gc (lua_State *L) {
+  luaL_StrBuf *sb = tostrbuf(L);
+  resizestrbuf(L, sb, 0);
+  sb->n = 0;
+  return 0;
+}
+
+
+/*
+** methods for string buffers
+*/
+static const luaL_Reg bufmeth[] = {
+  {"append", buf_append},
+  {"format", NULL},  /* place holder */
+  {"rep", buf_rep},
+  {"concat", buf_concat},
+  {"reset", buf_reset},
+  {"tostring", buf_tostring},
+  {NULL, NULL}
+};
+
+
+/*
+** metamethods for string buffers
+*/
+static const luaL_Reg bufmetameth[] = {
+  {"__index", NULL},  /* place holder */
+  {"__len", buf_len},
+  {"__tostring", buf_tostring},
+  {"__gc", buf_gc},
+  {"__close", buf_gc},
+  {NULL, NULL}
+};
+
+
+/*
+** Create the metatable for string buffers; the cache of compiled
+** formats is on the top of the stack.
+*/
+static void createbufmeta (lua_State *L) {
+  luaL_newmetatable(L, LUA_STRBUFHANDLE);  /* metatable for buffers */
+  luaL_setfuncs(L, bufmetameth, 0);  /* add metamethods */
+  luaL_newlibtable(L, bufmeth);  /* create method table */
+  luaL_setfuncs(L, bufmeth, 0);  /* add buffer methods to method table */
+  lua_pushvalue(L, -3);  /* cache of compiled formats */
+  lua_pushcclosure(L, buf_format, 1);
+  lua_setfield(L, -2, "format");
+  lua_setfield(L, -2, "__index");  /* metatable.__index = method table */
+  lua_pop(L, 1);  /* pop metatable */
+}
+
+/* }====================================================== */
+
+
 /*
 ** {======================================================
 ** PACK/UNPACK
@@ -1479,15 +1913,15 @@ static KOption getoption (Header *h, const char **fmt, int *size) {
 
 /*
 ** Read, classify, and fill other details about the next option.
-** 'psize' is filled with option's size, 'notoalign' with its
-** alignment requirements.
+** 'psize' is filled with option's size, 'palign' with its alignment
+** (1 if it needs no alignment).
 ** Local variable 'size' gets the size to be aligned. (Kpadal option
 ** always gets its full alignment, other options are limited by
 ** the maximum alignment ('maxalign'). Kchar option needs no alignment
 ** despite its size.
 */
-static KOption getdetails (Header *h, size_t totalsize,
-                           const char **fmt, int *psize, int *ntoalign) {
+static KOption getalign (Header *h, const char **fmt, int *psize,
+                         int *palign) {
   KOption opt = getoption(h, fmt, psize);
   int align = *psize;  /* usually, alignment follows size */
   if (opt == Kpaddalign) {  /* 'X' gets alignment from following option */
@@ -1495,14 +1929,32 @@ static KOption getdetails (Header *h, size_t totalsize,
       luaL_argerror(h->L, 1, "invalid next option for option 'X'");
   }
   if (align <= 1 || opt == Kchar)  /* need no alignment? */
-    *ntoalign = 0;
+    align = 1;
   else {
     if (align > h->maxalign)  /* enforce maximum alignment */
       align = h->maxalign;
     if ((align & (align - 1)) != 0)  /* is 'align' not a power of 2? */
       luaL_argerror(h->L, 1, "format asks for alignment not power of 2");
-    *ntoalign = (align - (int)(totalsize & (align - 1))) & (align - 1);
   }
+  *palign = align;
+  return opt;
+}
+
+
+/* number of bytes to align position 'pos' to 'align' (a power of 2) */
+#define toalign(pos,align)  \
+	((align - (int)((pos) & (align - 1))) & (align - 1))
+
+
+/*
+** Same as 'getalign', but 'ntoalign' gets the number of bytes needed
+** to align an option at position 'totalsize'.
+*/
+static KOption getdetails (Header *h, size_t totalsize,
+                           const char **fmt, int *psize, int *ntoalign) {
+  int align;
+  KOption opt = getalign(h, fmt, psize, &align);
+  *ntoalign = toalign(totalsize, align);
   return opt;
 }
 
@@ -1546,11 +1998,85 @@ static void copywithendian (char *dest, const char *src,
 }
 
 
+/*
+** Pack argument 'arg' as an option 'opt' with the given size and
+** endianness. Returns the number of arguments used (0 or 1) and
+** updates 'totalsize' with the size of variable-length options.
+*/
+static int packitem (lua_State *L, luaL_Buffer *b, KOption opt, int size,
+                     int islittle, int arg, size_t *totalsize) {
+  switch (opt) {
+    case Kint: {  /* signed integers */
+      lua_Integer n = luaL_checkinteger(L, arg);
+      if (size < SZINT) {  /* need overflow check? */
+        lua_Integer lim = (lua_Integer)1 << ((size * NB) - 1);
+        luaL_argcheck(L, -lim <= n && n < lim, arg, "integer overflow");
+      }
+      packint(b, (lua_Unsigned)n, islittle, size, (n < 0));
+      return 1;
+    }
+    case Kuint: {  /* unsigned integers */
+      lua_Integer n = luaL_checkinteger(L, arg);
+      if (size < SZINT)  /* need overflow check? */
+        luaL_argcheck(L, (lua_Unsigned)n < ((lua_Unsigned)1 << (size * NB)),
+                         arg, "unsigned overflow");
+      packint(b, (lua_Unsigned)n, islittle, size, 0);
+      return 1;
+    }
+    case Kfloat: {  /* floating-point options */
+      Ftypes u;
+      char *buff = luaL_prepbuffsize(b, size);
+      lua_Number n = luaL_checknumber(L, arg);  /* get argument */
+      if (size == sizeof(u.f)) u.f = (float)n;  /* copy it into 'u' */
+      else if (size == sizeof(u.d)) u.d = (double)n;
+      else u.n = n;
+      /* move 'u' to final result, correcting endianness if needed */
+      copywithendian(buff, (char *)&u, size, islittle);
+      luaL_addsize(b, size);
+      return 1;
+    }
+    case Kchar: {  /* fixed-size string */
+      size_t len;
+      const char *s = luaL_checklstring(L, arg, &len);
+      luaL_argcheck(L, len <= (size_t)size, arg,
+                       "string longer than given size");
+      luaL_addlstring(b, s, len);  /* add string */
+      while (len++ < (size_t)size)  /* pad extra space */
+        luaL_addchar(b, LUAL_PACKPADBYTE);
+      return 1;
+    }
+    case Kstring: {  /* strings with length count */
+      size_t len;
+      const char *s = luaL_checklstring(L, arg, &len);
+      luaL_argcheck(L, size >= (int)sizeof(size_t) ||
+                       len < ((size_t)1 << (size * NB)),
+                       arg, "string length does not fit in given size");
+      packint(b, (lua_Unsigned)len, islittle, size, 0);  /* pack length */
+      luaL_addlstring(b, s, len);
+      *totalsize += len;
+      return 1;
+    }
+    case Kzstr: {  /* zero-terminated string */
+      size_t len;
+      const char *s = luaL_checklstring(L, arg, &len);
+      luaL_argcheck(L, strlen(s) == len, arg, "string contains zeros");
+      luaL_addlstring(b, s, len);
+      luaL_addchar(b, '\0');  /* add zero at the end */
+      *totalsize += len + 1;
+      return 1;
+    }
+    case Kpadding: luaL_addchar(b, LUAL_PACKPADBYTE);  /* FALLTHROUGH */
+    default:  /* Kpaddalign, Knop */
+      return 0;
+  }
+}
+
+
 static int str_pack (lua_State *L) {
   luaL_Buffer b;
   Header h;
   const char *fmt = luaL_checkstring(L, 1);  /* format string */
-  int arg = 1;  /* current argument to pack */
+  int arg = 2;  /* current argument to pack */
   size_t totalsize = 0;  /* accumulate total size of result */
   initheader(L, &h);
   lua_pushnil(L);  /* mark to separate arguments from string buffer */
@@ -1561,72 +2087,7 @@ static int str_pack (lua_State *L) {
     totalsize += ntoalign + size;
     while (ntoalign-- > 0)
      luaL_addchar(&b, LUAL_PACKPADBYTE);  /* fill alignment */
-    arg++;
-    switch (opt) {
-      case Kint: {  /* signed integers */
-        lua_Integer n = luaL_checkinteger(L, arg);
-        if (size < SZINT) {  /* need overflow check? */
-          lua_Integer lim = (lua_Integer)1 << ((size * NB) - 1);
-          luaL_argcheck(L, -lim <= n && n < lim, arg, "integer overflow");
-        }
-        packint(&b, (lua_Unsigned)n, h.islittle, size, (n < 0));
-        break;
-      }
-      case Kuint: {  /* unsigned integers */
-        lua_Integer n = luaL_checkinteger(L, arg);
-        if (size < SZINT)  /* need overflow check? */
-          luaL_argcheck(L, (lua_Unsigned)n < ((lua_Unsigned)1 << (size * NB)),
-                           arg, "unsigned overflow");
-        packint(&b, (lua_Unsigned)n, h.islittle, size, 0);
-        break;
-      }
-      case Kfloat: {  /* floating-point options */
-        Ftypes u;
-        char *buff = luaL_prepbuffsize(&b, size);
-        lua_Number n = luaL_checknumber(L, arg);  /* get argument */
-        if (size == sizeof(u.f)) u.f = (float)n;  /* copy it into 'u' */
-        else if (size == sizeof(u.d)) u.d = (double)n;
-        else u.n = n;
-        /* move 'u' to final result, correcting endianness if needed */
-        copywithendian(buff, (char *)&u, size, h.islittle);
-        luaL_addsize(&b, size);
-        break;
-      }
-      case Kchar: {  /* fixed-size string */
-        size_t len;
-        const char *s = luaL_checklstring(L, arg, &len);
-        luaL_argcheck(L, len <= (size_t)size, arg,
-                         "string longer than given size");
-        luaL_addlstring(&b, s, len);  /* add string */
-        while (len++ < (size_t)size)  /* pad extra space */
-          luaL_addchar(&b, LUAL_PACKPADBYTE);
-        break;
-      }
-      case Kstring: {  /* strings with length count */
-        size_t len;
-        const char *s = luaL_checklstring(L, arg, &len);
-        luaL_argcheck(L, size >= (int)sizeof(size_t) ||
-                         len < ((size_t)1 << (size * NB)),
-                         arg, "string length does not fit in given size");
-        packint(&b, (lua_Unsigned)len, h.islittle, size, 0);  /* pack length */
-        luaL_addlstring(&b, s, len);
-        totalsize += len;
-        break;
-      }
-      case Kzstr: {  /* zero-terminated string */
-        size_t len;
-        const char *s = luaL_checklstring(L, arg, &len);
-        luaL_argcheck(L, strlen(s) == len, arg, "string contains zeros");
-        luaL_addlstring(&b, s, len);
-        luaL_addchar(&b, '\0');  /* add zero at the end */
-        totalsize += len + 1;
-        break;
-      }
-      case Kpadding: luaL_addchar(&b, LUAL_PACKPADBYTE);  /* FALLTHROUGH */
-      case Kpaddalign: case Knop:
-        arg--;  /* undo increment */
-        break;
-    }
+    arg += packitem(L, &b, opt, size, h.islittle, arg, &totalsize);
   }
   luaL_pushresult(&b);
   return 1;
@@ -1687,6 +2148,79 @@ static lua_Integer unpackint (lua_State *L, const char *str,
 }
 
 
+/*
+** Unpack the common sizes of integers with a constant size, so that
+** the compiler can expand 'unpackint' into a single load (plus a byte
+** swap, if the endianness is not the native one).
+*/
+static lua_Integer unpackintfast (lua_State *L, const char *str,
+                                  int islittle, int size, int issigned) {
+  switch (size) {
+    case 1: return unpackint(L, str, islittle, 1, issigned);
+    case 2: return unpackint(L, str, islittle, 2, issigned);
+    case 4: return unpackint(L, str, islittle, 4, issigned);
+    case 8: return unpackint(L, str, islittle, 8, issigned);
+    default: return unpackint(L, str, islittle, size, issigned);
+  }
+}
+
+
+/*
+** Unpack an option 'opt' with the given size and endianness from
+** position '*ppos' of 'data' (with length 'ld' and at index 'arg'),
+** which must have at least 'size' bytes. Returns the number of values
+** pushed (0 or 1) and updates '*ppos' after the option.
+*/
+static int unpackitem (lua_State *L, const char *data, size_t ld, int arg,
+                       size_t *ppos, KOption opt, int size, int islittle) {
+  size_t pos = *ppos;
+  int n = 1;
+  switch (opt) {
+    case Kint:
+    case Kuint: {
+      lua_Integer res = unpackintfast(L, data + pos, islittle, size,
+                                         (opt == Kint));
+      lua_pushinteger(L, res);
+      break;
+    }
+    case Kfloat: {
+      Ftypes u;
+      lua_Number num;
+      copywithendian((char *)&u, data + pos, size, islittle);
+      if (size == sizeof(u.f)) num = (lua_Number)u.f;
+      else if (size == sizeof(u.d)) num = (lua_Number)u.d;
+      else num = u.n;
+      lua_pushnumber(L, num);
+      break;
+    }
+    case Kchar: {
+      lua_pushlstring(L, data + pos, size);
+      break;
+    }
+    case Kstring: {
+      size_t len = (size_t)unpackint(L, data + pos, islittle, size, 0);
+      luaL_argcheck(L, len <= ld - pos - size, arg, "data string too short");
+      lua_pushlstring(L, data + pos + size, len);
+      pos += len;  /* skip string */
+      break;
+    }
+    case Kzstr: {
+      size_t len = strlen(data + pos);
+      luaL_argcheck(L, pos + len < ld, arg,
+                       "unfinished string for format 'z'");
+      lua_pushlstring(L, data + pos, len);
+      pos += len + 1;  /* skip string plus final '\0' */
+      break;
+    }
+    default:  /* Kpaddalign, Kpadding, Knop */
+      n = 0;
+      break;
+  }
+  *ppos = pos + size;
+  return n;
+}
+
+
 static int str_unpack (lua_State *L) {
   Header h;
   const char *fmt = luaL_checkstring(L, 1);
@@ -1704,63 +2238,225 @@ static int str_unpack (lua_State *L) {
     pos += ntoalign;  /* skip alignment */
     /* stack space for item + next position */
     luaL_checkstack(L, 2, "too many results");
-    n++;
-    switch (opt) {
-      case Kint:
-      case Kuint: {
-        lua_Integer res = unpackint(L, data + pos, h.islittle, size,
-                                       (opt == Kint));
-        lua_pushinteger(L, res);
-        break;
-      }
-      case Kfloat: {
-        Ftypes u;
-        lua_Number num;
-        copywithendian((char *)&u, data + pos, size, h.islittle);
-        if (size == sizeof(u.f)) num = (lua_Number)u.f;
-        else if (size == sizeof(u.d)) num = (lua_Number)u.d;
-        else num = u.n;
-        lua_pushnumber(L, num);
-        break;
-      }
-      case Kchar: {
-        lua_pushlstring(L, data + pos, size);
-        break;
-      }
-      case Kstring: {
-        size_t len = (size_t)unpackint(L, data + pos, h.islittle, size, 0);
-        luaL_argcheck(L, len <= ld - pos - size, 2, "data string too short");
-        lua_pushlstring(L, data + pos + size, len);
-        pos += len;  /* skip string */
-        break;
-      }
-      case Kzstr: {
-        size_t len = strlen(data + pos);
-        luaL_argcheck(L, pos + len < ld, 2,
-                         "unfinished string for format 'z'");
-        lua_pushlstring(L, data + pos, len);
-        pos += len + 1;  /* skip string plus final '\0' */
-        break;
-      }
-      case Kpaddalign: case Kpadding: case Knop:
-        n--;  /* undo increment */
-        break;
-    }
-    pos += size;
+    n += unpackitem(L, data, ld, 2, &pos, opt, size, h.islittle);
   }
   lua_pushinteger(L, pos + 1);  /* next position */
   return n + 1;
 }
 
+
+/*
+** Packers: formats compiled into a sequence of options, without the
+** options that only configure the format. When a format has no
+** variable-length options, its options have fixed offsets from any
+** start position aligned to the largest alignment in the format; then,
+** unpacking checks the data length only once.
+*/
+
+#define PACKERHANDLE	"PACKER*"
+
+typedef struct PackOp {
+  KOption opt;
+  int size;
+  int align;  /* alignment (1 if none) */
+  int islittle;
+  size_t offset;  /* offset from an aligned start (if packer is fixed) */
+} PackOp;
+
+
+typedef struct Packer {
+  int nops;  /* number of options */
+  int nvalues;  /* number of values packed/unpacked */
+  int fixed;  /* true if there are no variable-length options */
+  int maxalign;  /* largest alignment used by the options */
+  size_t size;  /* total size from an aligned start (if packer is fixed) */
+  PackOp ops[1];  /* (actual size is 'nops') */
+} Packer;
+
+
+#define checkpacker(L)	((Packer *)luaL_checkudata(L, 1, PACKERHANDLE))
+
+
+static int str_packer (lua_State *L) {
+  Header h;
+  size_t lf;
+  const char *fmt = luaL_checklstring(L, 1, &lf);
+  Packer *pk = (Packer *)lua_newuserdatauv(L, offsetof(Packer, ops) +
+                                              lf * sizeof(PackOp), 0);
+  pk->nops = pk->nvalues = 0;
+  pk->fixed = pk->maxalign = 1;
+  pk->size = 0;
+  initheader(L, &h);
+  while (*fmt != '\0') {
+    PackOp *op = &pk->ops[pk->nops];
+    int size;
+    op->opt = getalign(&h, &fmt, &op->size, &op->align);
+    switch (op->opt) {
+      case Knop: continue;  /* nothing to do */
+      case Kpadding: case Kpaddalign: break;
+      case Kstring: case Kzstr: pk->fixed = 0;  /* FALLTHROUGH */
+      default: pk->nvalues++; break;
+    }
+    if (op->align > pk->maxalign)
+      pk->maxalign = op->align;
+    op->islittle = h.islittle;
+    size = toalign(pk->size, op->align) + op->size;
+    luaL_argcheck(L, pk->size <= MAXSIZE - size, 1,
+                     "format result too large");
+    op->offset = pk->size + (size - op->size);
+    pk->size += size;
+    pk->nops++;
+  }
+  luaL_setmetatable(L, PACKERHANDLE);
+  return 1;
+}
+
+
+static int packer_pack (lua_State *L) {
+  const Packer *pk = checkpacker(L);
+  luaL_Buffer b;
+  int arg = 2;  /* current argument to pack */
+  size_t totalsize = 0;  /* accumulate total size of result */
+  int i;
+  lua_pushnil(L);  /* mark to separate arguments from string buffer */
+  luaL_buffinit(L, &b);
+  for (i = 0; i < pk->nops; i++) {
+    const PackOp *op = &pk->ops[i];
+    int ntoalign = toalign(totalsize, op->align);
+    totalsize += ntoalign + op->size;
+    while (ntoalign-- > 0)
+     luaL_addchar(&b, LUAL_PACKPADBYTE);  /* fill alignment */
+    arg += packitem(L, &b, op->opt, op->size, op->islittle, arg, &totalsize);
+  }
+  luaL_pushresult(&b);
+  return 1;
+}
+
+
+/*
+** Unpack the values described by packer 'pk' from the string at index
+** 'arg', starting at the position given at index 'arg + 1'. If 't' is
+** not zero, store the values in the table at index 't' instead of
+** leaving them on the stack. Returns the number of values on the stack
+** and pushes the next position.
+*/
+static int unpackall (lua_State *L, const Packer *pk, int arg, int t) {
+  size_t ld;
+  const char *data = luaL_checklstring(L, arg, &ld);
+  size_t pos = posrelatI(luaL_optinteger(L, arg + 1, 1), ld) - 1;
+  int i, n = 0;
+  luaL_argcheck(L, pos <= ld, arg + 1, "initial position out of string");
+  if (t == 0)  /* stack space for all items + next position */
+    luaL_checkstack(L, pk->nvalues + 1, "too many results");
+  if (pk->fixed && toalign(pos, pk->maxalign) == 0) {
+    size_t start = pos;
+    luaL_argcheck(L, pk->size <= ld - pos, arg, "data string too short");
+    for (i = 0; i < pk->nops; i++) {
+      const PackOp *op = &pk->ops[i];
+      pos = start + op->offset;
+      if (unpackitem(L, data, ld, arg, &pos, op->opt, op->size,
+                                           op->islittle) && t != 0)
+        lua_seti(L, t, ++n);
+    }
+  }
+  else {
+    for (i = 0; i < pk->nops; i++) {
+      const PackOp *op = &pk->ops[i];
+      int ntoalign = toalign(pos, op->align);
+      luaL_argcheck(L, (size_t)ntoalign + op->size <= ld - pos, arg,
+                       "data string too short");
+      pos += ntoalign;  /* skip alignment */
+      if (unpackitem(L, data, ld, arg, &pos, op->opt, op->size,
+                                           op->islittle) && t != 0)
+        lua_seti(L, t, ++n);
+    }
+  }
+  lua_pushinteger(L, pos + 1);  /* next position */
+  return (t == 0) ? pk->nvalues : 0;
+}
+
+
+static int packer_unpack (lua_State *L) {
+  return unpackall(L, checkpacker(L), 2, 0) + 1;
+}
+
+
+static int packer_unpackinto (lua_State *L) {
+  const Packer *pk = checkpacker(L);
+  luaL_checktype(L, 2, LUA_TTABLE);
+  return unpackall(L, pk, 3, 2) + 1;
+}
+
+
+static int packer_size (lua_State *L) {
+  const Packer *pk = checkpacker(L);
+  luaL_argcheck(L, pk->fixed, 1, "variable-length format");
+  lua_pushinteger(L, (lua_Integer)pk->size);
+  return 1;
+}
+
+
+static const luaL_Reg packermeth[] = {
+  {"pack", packer_pack},
+  {"unpack", packer_unpack},
+  {"unpackinto", packer_unpackinto},
+  {"size", packer_size},
+  {NULL, NULL}
+};
+
+
+static void createpackermeta (lua_State *L) {
+  luaL_newmetatable(L, PACKERHANDLE);  /* metatable for packers */
+  luaL_newlibtable(L, packermeth);  /* create method table */
+  luaL_setfuncs(L, packermeth, 0);  /* add packer methods to method table */
+  lua_setfield(L, -2, "__index");  /* metatable.__index = method table */
+  lua_pop(L, 1);  /* pop metatable */
+}
+
+/* }====================================================== */
+
+
+/*
+** {======================================================
+** Fast versions
+** =======================================================
+*/
+
+static int fast_len (lua_FastValue *v) {
+  v[0].i = (lua_Integer)v[0].str.l;
+  return LUA_FASTINT;
+}
+
+
+/* string.byte(s, i) */
+static int fast_byte (lua_FastValue *v) {
+  lua_Integer l = (lua_Integer)v[0].str.l;
+  lua_Integer pos = v[1].i;
+  if (pos < 0)  /* negative means back from end */
+    pos += l + 1;
+  if (!(1 <= pos && pos <= l))  /* empty interval? */
+    return LUA_FASTFAIL;  /* let 'str_byte' return no values */
+  v[0].i = uchar(v[0].str.s[pos - 1]);
+  return LUA_FASTINT;
+}
+
+
+static const luaL_FastReg strfast[] = {
+  {"byte", str_byte, fast_byte, "si"},
+  {"len", str_len, fast_len, "s"},
+  {NULL, NULL, NULL, NULL}
+};
+
 /* }====================================================== */
 
 
 static const luaL_Reg strlib[] = {
+  {"buffer", buf_new},
   {"byte", str_byte},
   {"char", str_char},
   {"dump", str_dump},
   {"find", str_find},
-  {"format", str_format},
+  {"format", NULL},  /* place holder */
   {"gmatch", gmatch},
   {"gsub", str_gsub},
   {"len", str_len},
@@ -1771,6 +2467,7 @@ static const luaL_Reg strlib[] = {
   {"sub", str_sub},
   {"upper", str_upper},
   {"pack", str_pack},
+  {"packer", str_packer},
   {"packsize", str_packsize},
   {"unpack", str_unpack},
   {NULL, NULL}
@@ -1796,7 +2493,13 @@ static void createmetatable (lua_State *L) {
 */
 LUAMOD_API int luaopen_string (lua_State *L) {
   luaL_newlib(L, strlib);
+  luaL_setfastfuncs(L, strfast);  /* replace functions with fast versions */
   createmetatable(L);
+  lua_newtable(L);  /* cache of compiled formats */
+  createbufmeta(L);
+  createpackermeta(L);
+  lua_pushcclosure(L, str_format, 1);
+  lua_setfield(L, -2, "format");
   return 1;
 }
 
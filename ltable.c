@@ -21,11 +21,17 @@
 ** in its main position (i.e. the 'original' position that its hash gives
 ** to it), then the colliding element is in its own main position.
 ** Hence even when the load factor reaches 100%, performance remains good.
+** When LUA_USE_SWISSTABLE is defined, the hash part uses instead open
+** addressing with groups of control bytes (see 'Swiss table' below).
 */
 
 #include <math.h>
 #include <limits.h>
 
+#if defined(LUA_USE_SWISSTABLE) && defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "lua.h"
 
 #include "ldebug.h"
@@ -85,6 +91,8 @@
 #define hashpointer(t,p)	hashmod(t, point2uint(p))
 
 
+#if !defined(LUA_USE_SWISSTABLE)
+
 #define dummynode		(&dummynode_)
 
 static const Node dummynode_ = {
@@ -92,6 +100,146 @@ static const Node dummynode_ = {
    LUA_VNIL, 0, {NULL}}  /* key type, next, and key value */
 };
 
+#else
+
+/*
+** {=============================================================
+** Swiss table
+** The hash part is an open-addressing table. Besides its nodes, it
+** has one control byte per node, stored right after the node array:
+** CTRLEMPTY for a node that was never used, or the 7 high bits of the
+** hash of the key stored in the node. Nodes are probed in groups of
+** GROUPSIZE, starting at the group given by the key's hash and
+** following a triangular sequence over the groups. All control bytes
+** of a group are matched at once (with SSE2, when available), so that
+** only nodes whose control byte matches need a key comparison, and a
+** search ends at the first group with an empty control byte.
+** As with the chained layout, a removed entry keeps its key (so that
+** 'next' still finds it); its node can be reused only by a new key with
+** the same control byte, or after a rehash. Field 'lastfree' counts down the
+** nodes still available for new keys; the load factor is kept at most
+** 7/8 (except in hash parts with a single group), so that searches for
+** absent keys stay short.
+** ==============================================================
+*/
+
+#define GROUPSIZE	16
+
+#define CTRLEMPTY	0x80	/* node was never used */
+#define CTRLPAD		0xFE	/* padding for hash parts smaller than a group */
+
+/* number of control bytes in a hash part with 2^ls nodes */
+#define sizectrl(ls)	(twoto(ls) < GROUPSIZE ? GROUPSIZE : twoto(ls))
+
+/* size in bytes of a hash part with 2^ls nodes */
+#define sizehashpart(ls)  \
+	(cast_sizet(twoto(ls)) * sizeof(Node) + cast_sizet(sizectrl(ls)))
+
+#define getctrl(t)	cast(lu_byte *, gnode(t, sizenode(t)))
+
+#define numgroups(t)	cast_uint(sizectrl((t)->lsizenode) / GROUPSIZE)
+
+/* maximum number of keys in a hash part with 'n' nodes */
+#define nodecapacity(n)	((n) - (n) / 8)
+
+/* control byte for a key with (mixed) hash 'h' */
+#define ctrlbyte(h)	cast_byte((h) >> 25)
+
+
+typedef struct DummyHash {
+  Node node;
+  lu_byte ctrl[GROUPSIZE];  /* must follow 'node' without padding */
+} DummyHash;
+
+#define dummynode		(&dummyhash_.node)
+
+static const DummyHash dummyhash_ = {
+  {{{NULL}, LUA_VEMPTY,  /* value's value and type */
+    LUA_VNIL, 0, {NULL}}},  /* key type, next, and key value */
+  {CTRLEMPTY, CTRLEMPTY, CTRLEMPTY, CTRLEMPTY,
+   CTRLEMPTY, CTRLEMPTY, CTRLEMPTY, CTRLEMPTY,
+   CTRLEMPTY, CTRLEMPTY, CTRLEMPTY, CTRLEMPTY,
+   CTRLEMPTY, CTRLEMPTY, CTRLEMPTY, CTRLEMPTY}
+};
+
+
+/*
+** Spread a raw hash, so that both its low bits (which select the first
+** group to probe) and its 7 high bits (the control byte) depend on all
+** its bits.
+*/
+static unsigned int mixhash (unsigned int h) {
+  h = (h * 0x9e3779b9u) & 0xffffffffu;
+  return h ^ (h >> 16);
+}
+
+
+/* mask with the bytes of group 'g' that are equal to 'b' */
+#if defined(__SSE2__)
+
+static unsigned int matchbyte (const lu_byte *g, lu_byte b) {
+  __m128i ctrl = _mm_loadu_si128(cast(const __m128i *, g));
+  __m128i eq = _mm_cmpeq_epi8(ctrl, _mm_set1_epi8(cast(char, b)));
+  return cast_uint(_mm_movemask_epi8(eq));
+}
+
+#else
+
+static unsigned int matchbyte (const lu_byte *g, lu_byte b) {
+  unsigned int m = 0;
+  int i;
+  for (i = 0; i < GROUPSIZE; i++)
+    m |= cast_uint(g[i] == b) << i;
+  return m;
+}
+
+#endif
+
+
+/* index of the lowest set bit in 'm' (which cannot be zero) */
+#if defined(__GNUC__)
+
+#define firstbit(m)	cast_uint(__builtin_ctz(m))
+
+#else
+
+static unsigned int firstbit (unsigned int m) {
+  unsigned int i = 0;
+  while (!(m & 1u)) { m >>= 1; i++; }
+  return i;
+}
+
+#endif
+
+
+/*
+** Search the hash part of table 't' for a key with mixed hash 'h':
+** 'n' runs over the nodes whose control byte matches the key's, and
+** condition 'eq' tells whether 'n' holds the key. Returns from the
+** calling function the value of the key or 'absentkey'.
+*/
+#define searchnode(t,h,n,eq) {  \
+  const lu_byte *ctrl_ = getctrl(t);  \
+  unsigned int gmask_ = numgroups(t) - 1;  \
+  unsigned int g_ = (h) & gmask_;  \
+  unsigned int step_ = 0;  \
+  lu_byte c_ = ctrlbyte(h);  \
+  for (;;) {  \
+    const lu_byte *grp_ = ctrl_ + g_ * GROUPSIZE;  \
+    unsigned int m_;  \
+    for (m_ = matchbyte(grp_, c_); m_ != 0; m_ &= m_ - 1) {  \
+      n = gnode(t, g_ * GROUPSIZE + firstbit(m_));  \
+      if (eq) return gval(n);  \
+    }  \
+    if (matchbyte(grp_, CTRLEMPTY) != 0 || step_ == gmask_)  \
+      return &absentkey;  /* key cannot be in any other group */  \
+    g_ = (g_ + ++step_) & gmask_;  \
+  } }
+
+/* }============================================================= */
+
+#endif
+
 
 static const TValue absentkey = {ABSTKEYCONSTANT};
 
@@ -127,6 +275,8 @@ static int l_hashfloat (lua_Number n) {
 #endif
 
 
+#if !defined(LUA_USE_SWISSTABLE)
+
 /*
 ** returns the 'main' position of an element in a table (that is,
 ** the index of its hash value). The key comes broken (tag in 'ktt'
@@ -164,6 +314,42 @@ static Node *mainpositionTV (const Table *t, const TValue *key) {
   return mainposition(t, rawtt(key), valraw(key));
 }
 
+#else
+
+/*
+** Returns the mixed hash of a key. As in 'mainposition', the key comes
+** broken in 'ktt' and 'kvl'.
+*/
+static unsigned int hashkey (int ktt, const Value *kvl) {
+  switch (withvariant(ktt)) {
+    case LUA_VNUMINT: {
+      lua_Unsigned i = l_castS2U(ivalueraw(*kvl));
+      return mixhash(cast_uint(i ^ ((i >> 31) >> 1)));
+    }
+    case LUA_VNUMFLT:
+      return mixhash(cast_uint(l_hashfloat(fltvalueraw(*kvl))));
+    case LUA_VSHRSTR:
+      return mixhash(tsvalueraw(*kvl)->hash);
+    case LUA_VLNGSTR:
+      return mixhash(luaS_hashlongstr(tsvalueraw(*kvl)));
+    case LUA_VFALSE:
+      return mixhash(0);
+    case LUA_VTRUE:
+      return mixhash(1);
+    case LUA_VLIGHTUSERDATA:
+      return mixhash(point2uint(pvalueraw(*kvl)));
+    case LUA_VLCF:
+      return mixhash(point2uint(fvalueraw(*kvl)));
+    default:
+      return mixhash(point2uint(gcvalueraw(*kvl)));
+  }
+}
+
+
+#define hashkeyTV(key)	hashkey(rawtt(key), valraw(key))
+
+#endif
+
 
 /*
 ** Check whether key 'k1' is equal to the key in node 'n2'. This
@@ -267,6 +453,7 @@ static unsigned int setlimittosize (Table *t) {
 ** See explanation about 'deadok' in function 'equalkey'.
 */
 static const TValue *getgeneric (Table *t, const TValue *key, int deadok) {
+#if !defined(LUA_USE_SWISSTABLE)
   Node *n = mainpositionTV(t, key);
   for (;;) {  /* check whether 'key' is somewhere in the chain */
     if (equalkey(key, n, deadok))
@@ -278,6 +465,11 @@ static const TValue *getgeneric (Table *t, const TValue *key, int deadok) {
       n += nx;
     }
   }
+#else
+  Node *n;
+  unsigned int h = hashkeyTV(key);
+  searchnode(t, h, n, equalkey(key, n, deadok));
+#endif
 }
 
 
@@ -297,6 +489,11 @@ static unsigned int arrayindex (lua_Integer k) {
 ** returns the index of a 'key' for table traversals. First goes all
 ** elements in the array part, then elements in the hash part. The
 ** beginning of a traversal is signaled by 0.
+** In a regular traversal, 'key' is the last key returned by 'luaH_next'
+** in this thread, whose node is remembered in 'L->nextnode'; so, a
+** traversal does not need to search for its keys. (The hint is
+** validated by comparing the key with the one in that node, so it
+** does not need to be invalidated when the table changes.)
 */
 static unsigned int findindex (lua_State *L, Table *t, TValue *key,
                                unsigned int asize) {
@@ -305,6 +502,9 @@ static unsigned int findindex (lua_State *L, Table *t, TValue *key,
   i = ttisinteger(key) ? arrayindex(ivalue(key)) : 0;
   if (i - 1u < asize)  /* is 'key' inside array part? */
     return i;  /* yes; that's the index */
+  else if (L->nexttable == t && L->nextnode < cast_uint(sizenode(t)) &&
+           equalkey(key, gnode(t, L->nextnode), 0))
+    return (L->nextnode + 1) + asize;  /* hint is right */
   else {
     const TValue *n = getgeneric(t, key, 1);
     if (unlikely(isabstkey(n)))
@@ -331,6 +531,8 @@ int luaH_next (lua_State *L, Table *t, StkId key) {
       Node *n = gnode(t, i);
       getnodekey(L, s2v(key), n);
       setobj2s(L, key + 1, gval(n));
+      L->nexttable = t;  /* remember where this key is */
+      L->nextnode = i;
       return 1;
     }
   }
@@ -339,8 +541,13 @@ int luaH_next (lua_State *L, Table *t, StkId key) {
 
 
 static void freehash (lua_State *L, Table *t) {
-  if (!isdummy(t))
+  if (!isdummy(t)) {
+#if !defined(LUA_USE_SWISSTABLE)
     luaM_freearray(L, t->node, cast_sizet(sizenode(t)));
+#else
+    luaM_freemem(L, t->node, sizehashpart(t->lsizenode));
+#endif
+  }
 }
 
 
@@ -440,6 +647,31 @@ static int numusehash (const Table *t, unsigned int *nums, unsigned int *pna) {
 }
 
 
+/*
+** Empties all nodes of the (non-dummy) hash part of table 't'.
+*/
+static void clearnodes (Table *t) {
+  int i;
+  int size = sizenode(t);
+  for (i = 0; i < size; i++) {
+    Node *n = gnode(t, i);
+    gnext(n) = 0;
+    setnilkey(n);
+    setempty(gval(n));
+  }
+#if !defined(LUA_USE_SWISSTABLE)
+  t->lastfree = gnode(t, size);  /* all positions are free */
+#else
+  {
+    lu_byte *ctrl = getctrl(t);
+    for (i = 0; i < sizectrl(t->lsizenode); i++)
+      ctrl[i] = (i < size) ? CTRLEMPTY : CTRLPAD;
+    t->lastfree = gnode(t, nodecapacity(size));  /* all nodes available */
+  }
+#endif
+}
+
+
 /*
 ** Creates an array for the hash part of a table with the given
 ** size, or reuses the dummy node if size is zero.
@@ -454,20 +686,21 @@ static void setnodevector (lua_State *L, Table *t, unsigned int size) {
     t->lastfree = NULL;  /* signal that it is using dummy node */
   }
   else {
-    int i;
     int lsize = luaO_ceillog2(size);
+#if defined(LUA_USE_SWISSTABLE)
+    if (lsize <= MAXHBITS && nodecapacity(twoto(lsize)) < cast_int(size))
+      lsize++;  /* keep load factor below maximum */
+#endif
     if (lsize > MAXHBITS || (1u << lsize) > MAXHSIZE)
       luaG_runerror(L, "table overflow");
     size = twoto(lsize);
+#if !defined(LUA_USE_SWISSTABLE)
     t->node = luaM_newvector(L, size, Node);
-    for (i = 0; i < (int)size; i++) {
-      Node *n = gnode(t, i);
-      gnext(n) = 0;
-      setnilkey(n);
-      setempty(gval(n));
-    }
+#else
+    t->node = cast(Node *, luaM_newobject(L, 0, sizehashpart(lsize)));
+#endif
     t->lsizenode = cast_byte(lsize);
-    t->lastfree = gnode(t, size);  /* all positions are free */
+    clearnodes(t);
   }
 }
 
@@ -558,10 +791,30 @@ void luaH_resize (lua_State *L, Table *t, unsigned int newasize,
 
 
 void luaH_resizearray (lua_State *L, Table *t, unsigned int nasize) {
+#if !defined(LUA_USE_SWISSTABLE)
   int nsize = allocsizenode(t);
+#else
+  int nsize = isdummy(t) ? 0 : nodecapacity(sizenode(t));
+#endif
   luaH_resize(L, t, nasize, nsize);
 }
 
+/*
+** Check whether extra key 'ek' is being appended right after the end
+** of the array part of table 't', which has no hash part and whose
+** last element is present (as in 't[#t + 1] = v' on a list). In that
+** case, the array part simply grows to the next power of 2, without
+** counting keys. (If the array has holes, the new array may be less
+** than half full, which only wastes some memory until a later rehash.)
+*/
+static int isappend (const Table *t, const TValue *ek) {
+  unsigned int asize = limitasasize(t);
+  return (isdummy(t) && asize > 0 && asize <= MAXASIZE / 2 &&
+          ttisinteger(ek) && l_castS2U(ivalue(ek)) == asize + 1u &&
+          !isempty(&t->array[asize - 1]));
+}
+
+
 /*
 ** nums[i] = number of keys 'k' where 2^(i - 1) < k <= 2^i
 */
@@ -571,8 +824,12 @@ static void rehash (lua_State *L, Table *t, const TValue *ek) {
   unsigned int nums[MAXABITS + 1];
   int i;
   int totaluse;
-  for (i = 0; i <= MAXABITS; i++) nums[i] = 0;  /* reset counts */
   setlimittosize(t);
+  if (isappend(t, ek)) {  /* growing a list? */
+    luaH_resize(L, t, 1u << luaO_ceillog2(limitasasize(t) + 1), 0);
+    return;
+  }
+  for (i = 0; i <= MAXABITS; i++) nums[i] = 0;  /* reset counts */
   na = numusearray(t, nums);  /* count keys in array part */
   totaluse = na;  /* all those keys are integer keys */
   totaluse += numusehash(t, nums, &na);  /* count keys in hash part */
@@ -600,6 +857,7 @@ Table *luaH_new (lua_State *L) {
   t->flags = cast_byte(maskflags);  /* table has no metamethod fields */
   t->array = NULL;
   t->alimit = 0;
+  t->border = 0;
   setnodevector(L, t, 0);
   return t;
 }
@@ -612,6 +870,8 @@ void luaH_free (lua_State *L, Table *t) {
 }
 
 
+#if !defined(LUA_USE_SWISSTABLE)
+
 static Node *getfreepos (Table *t) {
   if (!isdummy(t)) {
     while (t->lastfree > t->node) {
@@ -623,6 +883,50 @@ static Node *getfreepos (Table *t) {
   return NULL;  /* could not find a free place */
 }
 
+#else
+
+/*
+** Get a node for a new key with mixed hash 'h': the first one in the
+** key's probe sequence that is either never used or a removed entry
+** with the same control byte. Reusing the latter ensures that the new
+** key comes before any dead key equal to it (e.g., a collected object
+** whose address was reused) in the probe sequence, so that 'next' does
+** not confuse them. (While the table is below its maximum load there is
+** at least one never-used node.) Returns NULL if the table is full.
+*/
+static Node *getfreepos (Table *t, unsigned int h) {
+  if (!isdummy(t) && t->lastfree > t->node) {
+    lu_byte *ctrl = getctrl(t);
+    unsigned int gmask = numgroups(t) - 1;
+    unsigned int g = h & gmask;
+    unsigned int step = 0;
+    lu_byte c = ctrlbyte(h);
+    for (;;) {
+      const lu_byte *grp = ctrl + g * GROUPSIZE;
+      unsigned int m = matchbyte(grp, CTRLEMPTY);
+      unsigned int r;
+      for (r = matchbyte(grp, c); r != 0; r &= r - 1) {
+        unsigned int i = firstbit(r);
+        if (m != 0 && i > firstbit(m))
+          break;  /* a never-used node comes first */
+        if (isempty(gval(gnode(t, g * GROUPSIZE + i))))
+          return gnode(t, g * GROUPSIZE + i);  /* reuse removed entry */
+      }
+      if (m != 0) {
+        unsigned int i = g * GROUPSIZE + firstbit(m);
+        ctrl[i] = ctrlbyte(h);
+        t->lastfree--;  /* one less available node */
+        return gnode(t, i);
+      }
+      lua_assert(step < gmask);
+      g = (g + ++step) & gmask;
+    }
+  }
+  return NULL;  /* could not find a free place */
+}
+
+#endif
+
 
 
 /*
@@ -635,7 +939,9 @@ static Node *getfreepos (Table *t) {
 TValue *luaH_newkey (lua_State *L, Table *t, const TValue *key) {
   Node *mp;
   TValue aux;
-  if (unlikely(ttisnil(key)))
+  if (unlikely(isfrozen(t)))
+    luaG_runerror(L, "attempt to modify a frozen table");
+  else if (unlikely(ttisnil(key)))
     luaG_runerror(L, "table index is nil");
   else if (ttisfloat(key)) {
     lua_Number f = fltvalue(key);
@@ -647,6 +953,14 @@ TValue *luaH_newkey (lua_State *L, Table *t, const TValue *key) {
     else if (unlikely(luai_numisnan(f)))
       luaG_runerror(L, "table index is NaN");
   }
+#if defined(LUA_USE_SWISSTABLE)
+  mp = getfreepos(t, hashkeyTV(key));
+  if (mp == NULL) {  /* table is full? */
+    rehash(L, t, key);  /* grow table */
+    /* whatever called 'newkey' takes care of TM cache */
+    return luaH_set(L, t, key);  /* insert key into grown table */
+  }
+#else
   mp = mainpositionTV(t, key);
   if (!isempty(gval(mp)) || isdummy(t)) {  /* main position is taken? */
     Node *othern;
@@ -679,6 +993,7 @@ TValue *luaH_newkey (lua_State *L, Table *t, const TValue *key) {
       mp = f;
     }
   }
+#endif
   setnodekey(L, mp, key);
   luaC_barrierback(L, obj2gco(t), key);
   lua_assert(isempty(gval(mp)));
@@ -686,6 +1001,20 @@ TValue *luaH_newkey (lua_State *L, Table *t, const TValue *key) {
 }
 
 
+/*
+** Remove all entries from table 't', keeping the sizes of its parts.
+** (Only references are removed, so there is no need for barriers.)
+*/
+void luaH_clear (Table *t) {
+  unsigned int i;
+  unsigned int asize = setlimittosize(t);
+  for (i = 0; i < asize; i++)
+    setempty(&t->array[i]);
+  if (!isdummy(t))
+    clearnodes(t);
+}
+
+
 /*
 ** Search function for integers. If integer is inside 'alimit', get it
 ** directly from the array part. Otherwise, if 'alimit' is not equal to
@@ -704,6 +1033,7 @@ const TValue *luaH_getint (Table *t, lua_Integer key) {
     return &t->array[key - 1];
   }
   else {
+#if !defined(LUA_USE_SWISSTABLE)
     Node *n = hashint(t, key);
     for (;;) {  /* check whether 'key' is somewhere in the chain */
       if (keyisinteger(n) && keyival(n) == key)
@@ -715,6 +1045,12 @@ const TValue *luaH_getint (Table *t, lua_Integer key) {
       }
     }
     return &absentkey;
+#else
+    Node *n;
+    lua_Unsigned u = l_castS2U(key);
+    unsigned int h = mixhash(cast_uint(u ^ ((u >> 31) >> 1)));
+    searchnode(t, h, n, keyisinteger(n) && keyival(n) == key);
+#endif
   }
 }
 
@@ -723,6 +1059,7 @@ const TValue *luaH_getint (Table *t, lua_Integer key) {
 ** search function for short strings
 */
 const TValue *luaH_getshortstr (Table *t, TString *key) {
+#if !defined(LUA_USE_SWISSTABLE)
   Node *n = hashstr(t, key);
   lua_assert(key->tt == LUA_VSHRSTR);
   for (;;) {  /* check whether 'key' is somewhere in the chain */
@@ -735,6 +1072,12 @@ const TValue *luaH_getshortstr (Table *t, TString *key) {
       n += nx;
     }
   }
+#else
+  Node *n;
+  unsigned int h = mixhash(key->hash);
+  lua_assert(key->tt == LUA_VSHRSTR);
+  searchnode(t, h, n, keyisshrstr(n) && eqshrstr(keystrval(n), key));
+#endif
 }
 
 
@@ -845,7 +1188,16 @@ static unsigned int binsearch (const TValue *array, unsigned int i,
 
 
 /*
-** Try to find a boundary in table 't'. (A 'boundary' is an integer index
+** Reading a frozen table never writes to it: the hints 'alimit' and
+** 'border' are updated only in tables that are not frozen.
+*/
+#define canupdate(t)	(!isfrozen(t))
+
+#define setborder(t,b)	(canupdate(t) ? ((t)->border = (b)) : (b))
+
+
+/*
+** Search for a boundary in table 't'. (A 'boundary' is an integer index
 ** such that t[i] is present and t[i+1] is absent, or 0 if t[1] is absent
 ** and 'maxinteger' if t[maxinteger] is present.)
 ** (In the next explanation, we use Lua indices, that is, with base 1.
@@ -876,13 +1228,13 @@ static unsigned int binsearch (const TValue *array, unsigned int i,
 ** (In those cases, the boundary is not inside the array part, and
 ** therefore cannot be used as a new limit.)
 */
-lua_Unsigned luaH_getn (Table *t) {
+static lua_Unsigned searchborder (Table *t) {
   unsigned int limit = t->alimit;
   if (limit > 0 && isempty(&t->array[limit - 1])) {  /* (1)? */
     /* there must be a boundary before 'limit' */
     if (limit >= 2 && !isempty(&t->array[limit - 2])) {
       /* 'limit - 1' is a boundary; can it be a new limit? */
-      if (ispow2realasize(t) && !ispow2(limit - 1)) {
+      if (canupdate(t) && ispow2realasize(t) && !ispow2(limit - 1)) {
         t->alimit = limit - 1;
         setnorealasize(t);  /* now 'alimit' is not the real size */
       }
@@ -891,7 +1243,8 @@ lua_Unsigned luaH_getn (Table *t) {
     else {  /* must search for a boundary in [0, limit] */
       unsigned int boundary = binsearch(t->array, 0, limit);
       /* can this boundary represent the real size of the array? */
-      if (ispow2realasize(t) && boundary > luaH_realasize(t) / 2) {
+      if (canupdate(t) && ispow2realasize(t) &&
+          boundary > luaH_realasize(t) / 2) {
         t->alimit = boundary;  /* use it as the new limit */
         setnorealasize(t);
       }
@@ -909,7 +1262,8 @@ lua_Unsigned luaH_getn (Table *t) {
       /* there must be a boundary in the array after old limit,
          and it must be a valid new limit */
       unsigned int boundary = binsearch(t->array, t->alimit, limit);
-      t->alimit = boundary;
+      if (canupdate(t))
+        t->alimit = boundary;
       return boundary;
     }
     /* else, new limit is present in the table; check the hash part */
@@ -924,13 +1278,49 @@ lua_Unsigned luaH_getn (Table *t) {
 }
 
 
+/*
+** Length of table 't'. 't->border' caches the last boundary found
+** inside the array part; it is not updated by stores, so it is only a
+** hint that must be checked before being used. The usual ways a list
+** changes between two calls (an append 't[#t+1]=v' or a pop
+** 't[#t]=nil') move the boundary by one position, and both are checked
+** here in constant time, without depending on the size of the array
+** (which 'alimit' cannot track for arrays whose size is not a power
+** of 2). Any other case falls back to 'searchborder'.
+*/
+lua_Unsigned luaH_getn (Table *t) {
+  unsigned int b = t->border;
+  unsigned int size = luaH_realasize(t);
+  lua_Unsigned n;
+  if (b < size) {  /* 't[b + 1]' is inside the array part? */
+    if (isempty(&t->array[b])) {  /* 't[b + 1]' is absent? */
+      if (b == 0 || !isempty(&t->array[b - 1]))
+        return b;  /* 'b' is still a boundary */
+      else if (b == 1 || !isempty(&t->array[b - 2]))
+        return setborder(t, b - 1);  /* after a pop */
+    }
+    else if (b + 1 < size && isempty(&t->array[b + 1]))
+      return setborder(t, b + 1);  /* after an append */
+  }
+  n = searchborder(t);
+  if (n < size)  /* boundary inside the array part? */
+    setborder(t, cast_uint(n));  /* keep it for the next call */
+  return n;
+}
+
+
 
 #if defined(LUA_DEBUG)
 
 /* export these functions for the test library */
 
 Node *luaH_mainposition (const Table *t, const TValue *key) {
+#if !defined(LUA_USE_SWISSTABLE)
   return mainpositionTV(t, key);
+#else  /* first node of the key's first group */
+  unsigned int g = hashkeyTV(key) & (numgroups(t) - 1);
+  return gnode(t, g * GROUPSIZE);
+#endif
 }
 
 int luaH_isdummy (const Table *t) { return isdummy(t); }
@@ -171,6 +171,73 @@ static int tconcat (lua_State *L) {
 }
 
 
+static int tnew (lua_State *L) {
+  lua_Integer na = luaL_optinteger(L, 1, 0);
+  lua_Integer nh = luaL_optinteger(L, 2, 0);
+  luaL_argcheck(L, 0 <= na && na <= INT_MAX, 1, "out of range");
+  luaL_argcheck(L, 0 <= nh && nh <= INT_MAX, 2, "out of range");
+  lua_createtable(L, (int)na, (int)nh);
+  return 1;
+}
+
+
+static int tclear (lua_State *L) {
+  luaL_checktype(L, 1, LUA_TTABLE);
+  lua_cleartable(L, 1);
+  return 0;
+}
+
+
+/*
+** Add the table at the top of the stack to the list of tables to be
+** frozen (at index 2), if it is not frozen yet; pops the value.
+*/
+static void addtofreeze (lua_State *L, lua_Integer *n) {
+  if (lua_type(L, -1) == LUA_TTABLE && !lua_isfrozen(L, -1))
+    lua_rawseti(L, 2, ++(*n));
+  else
+    lua_pop(L, 1);
+}
+
+
+static int tfreeze (lua_State *L) {
+  int deep = lua_toboolean(L, 2);
+  luaL_checktype(L, 1, LUA_TTABLE);
+  if (deep) {  /* freeze all tables reachable through keys and values */
+    lua_Integer n = 1;  /* number of tables in the list */
+    lua_settop(L, 1);
+    lua_createtable(L, 8, 0);  /* list of tables to be frozen */
+    lua_pushvalue(L, 1);
+    lua_rawseti(L, 2, 1);
+    while (n > 0) {
+      lua_rawgeti(L, 2, n);  /* get next table (at index 3) */
+      lua_pushnil(L);
+      lua_rawseti(L, 2, n--);  /* remove it from the list */
+      if (!lua_isfrozen(L, 3)) {
+        lua_freeze(L, 3);
+        lua_pushnil(L);
+        while (lua_next(L, 3)) {
+          addtofreeze(L, &n);  /* value */
+          lua_pushvalue(L, -1);
+          addtofreeze(L, &n);  /* key */
+        }
+      }
+      lua_pop(L, 1);
+    }
+  }
+  lua_freeze(L, 1);
+  lua_settop(L, 1);
+  return 1;
+}
+
+
+static int tisfrozen (lua_State *L) {
+  luaL_checktype(L, 1, LUA_TTABLE);
+  lua_pushboolean(L, lua_isfrozen(L, 1));
+  return 1;
+}
+
+
 /*
 ** {======================================================
 ** Pack/unpack
@@ -410,8 +477,12 @@ static int sort (lua_State *L) {
 
 
 static const luaL_Reg tab_funcs[] = {
+  {"clear", tclear},
   {"concat", tconcat},
+  {"freeze", tfreeze},
   {"insert", tinsert},
+  {"isfrozen", tisfrozen},
+  {"new", tnew},
   {"pack", tpack},
   {"unpack", tunpack},
   {"remove", tremove},
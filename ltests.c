@@ -794,6 +794,43 @@ static int listlocals (lua_State *L) {
   return i-1;
 }
 
+
+/*
+** Counters for pairs of consecutive opcodes executed by the
+** interpreter, to find candidates for superinstructions. (Pairs cross
+** calls, returns, and coroutine switches.)
+*/
+static l_uint32 oppairs[NUM_OPCODES][NUM_OPCODES];
+static int lastop = OP_RETURN0;
+
+
+void l_countop (int op) {
+  oppairs[lastop][op]++;
+  lastop = op;
+}
+
+
+/*
+** T.oppairs([reset]): returns a table mapping each pair "OP1 OP2"
+** executed since the last reset to its count
+*/
+static int oppairslist (lua_State *L) {
+  int i, j;
+  lua_newtable(L);
+  for (i = 0; i < NUM_OPCODES; i++) {
+    for (j = 0; j < NUM_OPCODES; j++) {
+      if (oppairs[i][j] > 0) {
+        lua_pushfstring(L, "%s %s", opnames[i], opnames[j]);
+        lua_pushinteger(L, oppairs[i][j]);
+        lua_settable(L, -3);
+      }
+    }
+  }
+  if (lua_toboolean(L, 1))
+    memset(oppairs, 0, sizeof(oppairs));
+  return 1;
+}
+
 /* }====================================================== */
 
 
@@ -1031,6 +1068,18 @@ static int string_query (lua_State *L) {
       api_incr_top(L);
       n++;
     }
+    if (tb->old != NULL) {  /* table is growing? */
+      int i = lmod(s, tb->oldsize);  /* old list feeding slot 's' */
+      if (i >= tb->moved) {  /* list not moved yet? */
+        for (ts = tb->old[i]; ts != NULL; ts = ts->u.hnext) {
+          if (lmod(ts->hash, tb->size) == s) {  /* goes to slot 's'? */
+            setsvalue2s(L, L->top, ts);
+            api_incr_top(L);
+            n++;
+          }
+        }
+      }
+    }
     return n;
   }
   else return 0;
@@ -1678,6 +1727,9 @@ static int runC (lua_State *L, lua_State *L1, const char *pc) {
       int idx = getindex;
       lua_setmetatable(L1, idx);
     }
+    else if EQ("setshortlen") {
+      lua_pushboolean(L1, lua_setshortlen(L1, getnum));
+    }
     else if EQ("settable") {
       lua_settable(L1, getindex);
     }
@@ -1908,6 +1960,7 @@ static const struct luaL_Reg tests_funcs[] = {
   {"newstate", newstate},
   {"newuserdata", newuserdata},
   {"num2int", num2int},
+  {"oppairs", oppairslist},
   {"pushuserdata", pushuserdata},
   {"querystr", string_query},
   {"querytab", table_query},
@@ -44,6 +44,10 @@
 #define LUA_RAND32
 
 
+/* count executed instructions and calls (library 'vmstats') */
+#define LUA_VMSTATS
+
+
 /* memory-allocator control variables */
 typedef struct Memcontrol {
   int failnext;
@@ -64,6 +68,14 @@ LUA_API Memcontrol l_memcontrol;
 extern void *l_Trick;
 
 
+/*
+** Count pairs of consecutive opcodes executed by the interpreter
+** (see 'T.oppairs')
+*/
+LUAI_FUNC void l_countop (int op);
+#define luai_opexec(L,i)	l_countop(GET_BASEOP(i))
+
+
 
 /*
 ** Function to traverse and check all memory used by Lua
@@ -125,6 +137,10 @@ LUA_API void *debug_realloc (void *ud, void *block,
 #define LUAI_USER_ALIGNMENT_T   union { char b[sizeof(void*) * 8]; }
 
 
+/* use parallel marking (when enabled) even for tiny heaps */
+#define LUAI_GCPARMINMEM	1
+
+
 /* make stack-overflow tests run faster */
 #undef LUAI_MAXSTACK
 #define LUAI_MAXSTACK   50000
@@ -49,7 +49,7 @@ typedef enum {
 ** Mask with 1 in all fast-access methods. A 1 in any of these bits
 ** in the flag of a (meta)table means the metatable does not have the
 ** corresponding metamethod field. (Bit 7 of the flag is used for
-** 'isrealasize'.)
+** 'isrealasize' and bit 6 for 'isfrozen'.)
 */
 #define maskflags	(~(~0u << (TM_EQ + 1)))
 
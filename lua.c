@@ -36,6 +36,8 @@ static lua_State *globalL = NULL;
 
 static const char *progname = LUA_PROGNAME;
 
+static int vmstatsatexit = 0;  /* option '-X' */
+
 
 /*
 ** Hook set by signal function to stop the interpreter.
@@ -75,6 +77,7 @@ static void print_usage (const char *badoption) {
   "  -v       show version information\n"
   "  -E       ignore environment variables\n"
   "  -W       turn warnings on\n"
+  "  -X       print VM statistics at exit\n"
   "  --       stop handling options\n"
   "  -        stop handling options and execute stdin\n"
   ,
@@ -132,6 +135,10 @@ static int msghandler (lua_State *L) {
 static int docall (lua_State *L, int narg, int nres) {
   int status;
   int base = lua_gettop(L) - narg;  /* function index */
+  if (vmstatsatexit) {  /* keep its statistics alive for the report */
+    lua_pushvalue(L, base);
+    luaL_ref(L, LUA_REGISTRYINDEX);
+  }
   lua_pushcfunction(L, msghandler);  /* push message handler */
   lua_insert(L, base);  /* put it under function and args */
   globalL = L;  /* to be available to 'laction' */
@@ -237,6 +244,7 @@ static int handle_script (lua_State *L, char **argv) {
 #define has_v		4	/* -v */
 #define has_e		8	/* -e */
 #define has_E		16	/* -E */
+#define has_X		32	/* -X */
 
 
 /*
@@ -265,6 +273,11 @@ static int collectargs (char **argv, int *first) {
           return has_error;  /* invalid option */
         args |= has_E;
         break;
+      case 'X':
+        if (argv[i][2] != '\0')  /* extra characters? */
+          return has_error;  /* invalid option */
+        args |= has_X;
+        break;
       case 'W':
         if (argv[i][2] != '\0')  /* extra characters? */
           return has_error;  /* invalid option */
@@ -573,6 +586,18 @@ static void doREPL (lua_State *L) {
 /* }================================================================== */
 
 
+/*
+** Prints the report from library 'vmstats' (option '-X')
+*/
+static int printvmstats (lua_State *L) {
+  luaL_requiref(L, LUA_VMSTATSLIBNAME, luaopen_vmstats, 0);
+  lua_getfield(L, -1, "report");
+  lua_call(L, 0, 1);
+  lua_writestringerror("%s", lua_tostring(L, -1));
+  return 0;
+}
+
+
 /*
 ** Main body of stand-alone interpreter (to be called in protected mode).
 ** Reads the options and handles them all.
@@ -594,6 +619,8 @@ static int pmain (lua_State *L) {
     lua_pushboolean(L, 1);  /* signal for libraries to ignore env. vars. */
     lua_setfield(L, LUA_REGISTRYINDEX, "LUA_NOENV");
   }
+  if (args & has_X)  /* option '-X'? */
+    vmstatsatexit = 1;
   luaL_openlibs(L);  /* open standard libraries */
   createargtable(L, argv, argc, script);  /* create table 'arg' */
   lua_gc(L, LUA_GCGEN, 0, 0);  /* GC in generational mode */
@@ -633,6 +660,10 @@ int main (int argc, char **argv) {
   status = lua_pcall(L, 2, 1, 0);  /* do the call */
   result = lua_toboolean(L, -1);  /* get result */
   report(L, status);
+  if (vmstatsatexit) {
+    lua_pushcfunction(L, &printvmstats);
+    report(L, lua_pcall(L, 0, 0, 0));
+  }
   lua_close(L);
   return (result && status == LUA_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
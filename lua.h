@@ -131,6 +131,29 @@ typedef void * (*lua_Alloc) (void *ud, void *ptr, size_t osize, size_t nsize);
 typedef void (*lua_WarnFunction) (void *ud, const char *msg, int tocont);
 
 
+/*
+** Type for fast versions of C functions, which get unboxed arguments
+** and return their result in 'v[0]' (see 'lua_pushfastcfunction')
+*/
+typedef struct lua_FastValue {
+  lua_Integer i;
+  lua_Number n;
+  struct { const char *s; size_t l; } str;
+} lua_FastValue;
+
+typedef int (*lua_FastCFunction) (lua_FastValue *v);
+
+/* maximum number of arguments of a fast C function */
+#define LUA_FASTMAXARGS	4
+
+/* results of fast C functions */
+#define LUA_FASTFAIL	0	/* call the regular function instead */
+#define LUA_FASTINT	1	/* result is the integer 'v[0].i' */
+#define LUA_FASTFLT	2	/* result is the float 'v[0].n' */
+#define LUA_FASTEXTRA	3	/* results are the extra arguments from the
+                                   'v[0].i'-th one on */
+
+
 
 
 /*
@@ -239,6 +262,8 @@ LUA_API const char *(lua_pushvfstring) (lua_State *L, const char *fmt,
                                                       va_list argp);
 LUA_API const char *(lua_pushfstring) (lua_State *L, const char *fmt, ...);
 LUA_API void  (lua_pushcclosure) (lua_State *L, lua_CFunction fn, int n);
+LUA_API void  (lua_pushfastcfunction) (lua_State *L, lua_CFunction fn,
+                                       lua_FastCFunction ff, const char *sig);
 LUA_API void  (lua_pushboolean) (lua_State *L, int b);
 LUA_API void  (lua_pushlightuserdata) (lua_State *L, void *p);
 LUA_API int   (lua_pushthread) (lua_State *L);
@@ -271,6 +296,9 @@ LUA_API void  (lua_seti) (lua_State *L, int idx, lua_Integer n);
 LUA_API void  (lua_rawset) (lua_State *L, int idx);
 LUA_API void  (lua_rawseti) (lua_State *L, int idx, lua_Integer n);
 LUA_API void  (lua_rawsetp) (lua_State *L, int idx, const void *p);
+LUA_API void  (lua_cleartable) (lua_State *L, int idx);
+LUA_API void  (lua_freeze) (lua_State *L, int idx);
+LUA_API int   (lua_isfrozen) (lua_State *L, int idx);
 LUA_API int   (lua_setmetatable) (lua_State *L, int objindex);
 LUA_API int   (lua_setiuservalue) (lua_State *L, int idx, int n);
 
@@ -327,10 +355,52 @@ LUA_API void (lua_warning)  (lua_State *L, const char *msg, int tocont);
 #define LUA_GCISRUNNING		9
 #define LUA_GCGEN		10
 #define LUA_GCINC		11
+#define LUA_GCPARALLEL		12
+#define LUA_GCDEFERFIN		13
+#define LUA_GCRUNFINALIZERS	14
+#define LUA_GCFINSTATS		15
+#define LUA_GCSTACKSHRINK	16
 
 LUA_API int (lua_gc) (lua_State *L, int what, ...);
 
 
+/*
+** thread-pool function and options
+*/
+
+#define LUA_TPSIZE		0
+#define LUA_TPSTACK		1
+#define LUA_TPCOUNT		2
+#define LUA_TPREUSED		3
+
+LUA_API lua_Integer (lua_threadpool) (lua_State *L, int what, int data);
+
+
+/*
+** thread stack statistics
+*/
+
+#define LUA_STKSIZE		0
+#define LUA_STKINUSE		1
+#define LUA_STKPEAK		2
+#define LUA_STKGROWS		3
+#define LUA_STKSHRINKS		4
+
+LUA_API lua_Integer (lua_stackinfo) (lua_State *L, int what);
+
+
+/*
+** instruction budget
+*/
+
+#define LUA_BUDGETOFF		0
+#define LUA_BUDGETYIELD		1
+#define LUA_BUDGETERROR		2
+
+LUA_API void (lua_setbudget) (lua_State *L, lua_Integer n, int mode);
+LUA_API lua_Integer (lua_getbudget) (lua_State *L, int *mode);
+
+
 /*
 ** miscellaneous functions
 */
@@ -349,6 +419,8 @@ LUA_API void      (lua_setallocf) (lua_State *L, lua_Alloc f, void *ud);
 
 LUA_API void  (lua_toclose) (lua_State *L, int idx);
 
+LUA_API int   (lua_setshortlen) (lua_State *L, int n);
+
 
 /*
 ** {==============================================================
@@ -487,6 +559,25 @@ struct lua_Debug {
   struct CallInfo *i_ci;  /* active function */
 };
 
+
+#if defined(LUA_VMSTATS)
+
+/* an instruction or a function in the execution statistics */
+typedef struct lua_VMSpot {
+  lua_Integer count;	/* number of executions (or calls) */
+  int line;	/* line of the instruction (or where the function starts) */
+  int pc;	/* index of the instruction, from 1 (0 for a function) */
+  const char *op;	/* opcode of the instruction (NULL for a function) */
+  char short_src[LUA_IDSIZE];
+} lua_VMSpot;
+
+LUA_API lua_Integer (lua_vmopcount) (lua_State *L, int op, const char **name);
+LUA_API int (lua_vmspots) (lua_State *L, lua_VMSpot *s, int max, int calls,
+                           lua_Integer *total);
+LUA_API void (lua_vmreset) (lua_State *L);
+
+#endif
+
 /* }====================================================================== */
 
 
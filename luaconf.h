@@ -70,6 +70,23 @@
 #endif
 
 
+/*
+@@ LUA_USE_PARALLELGC allows the collector to mark objects using
+** several threads (POSIX threads) in big collections. It needs an
+** extra library (-lpthread) and a compiler with GCC atomic builtins.
+*/
+/* #define LUA_USE_PARALLELGC */
+
+
+/*
+@@ LUA_USE_SWISSTABLE makes the hash part of tables use open addressing
+** with groups of control bytes (matched with SSE2 instructions when
+** available) instead of chained nodes. Only the memory layout of
+** tables changes (and, with it, the order of traversals).
+*/
+/* #define LUA_USE_SWISSTABLE */
+
+
 /*
 @@ LUAI_IS32INT is true iff 'int' has (at least) 32 bits.
 */
@@ -387,6 +404,9 @@
 ** by prefixing it with one of FLT/DBL/LDBL.
 @@ LUA_NUMBER_FRMLEN is the length modifier for writing floats.
 @@ LUA_NUMBER_FMT is the format for writing floats.
+@@ LUA_NUMBER_FMTPREC is the precision of LUA_NUMBER_FMT, when it
+** has the form "%.<prec>g" and 'prec' <= 15. If defined, Lua uses its
+** own faster conversion for doubles instead of 'snprintf'.
 @@ lua_number2str converts a float to a string.
 @@ l_mathop allows the addition of an 'l' or 'f' to all math operations.
 @@ l_floor takes the floor of a float.
@@ -459,6 +479,7 @@
 
 #define LUA_NUMBER_FRMLEN	""
 #define LUA_NUMBER_FMT		"%.14g"
+#define LUA_NUMBER_FMTPREC	14
 
 #define l_mathop(op)		op
 
@@ -687,6 +708,14 @@
 #define luai_apicheck(l,e)	assert(e)
 #endif
 
+
+/*
+@@ LUA_VMSTATS makes the interpreter count the instructions it executes
+** and the calls to each Lua function (see library 'vmstats'). Define it
+** to profile Lua code; it slows down the interpreter.
+*/
+/* #define LUA_VMSTATS */
+
 /* }================================================================== */
 
 
@@ -26,6 +26,9 @@ LUAMOD_API int (luaopen_table) (lua_State *L);
 #define LUA_IOLIBNAME	"io"
 LUAMOD_API int (luaopen_io) (lua_State *L);
 
+#define LUA_ASYNCLIBNAME	"async"
+LUAMOD_API int (luaopen_async) (lua_State *L);
+
 #define LUA_OSLIBNAME	"os"
 LUAMOD_API int (luaopen_os) (lua_State *L);
 
@@ -41,6 +44,9 @@ LUAMOD_API int (luaopen_math) (lua_State *L);
 #define LUA_DBLIBNAME	"debug"
 LUAMOD_API int (luaopen_debug) (lua_State *L);
 
+#define LUA_VMSTATSLIBNAME	"vmstats"
+LUAMOD_API int (luaopen_vmstats) (lua_State *L);
+
 #define LUA_LOADLIBNAME	"package"
 LUAMOD_API int (luaopen_package) (lua_State *L);
 
@@ -113,8 +113,8 @@ static TString *loadStringN (LoadState *S, Proto *p) {
   size_t size = loadSize(S);
   if (size == 0)  /* no string? */
     return NULL;
-  else if (--size <= LUAI_MAXSHORTLEN) {  /* short string? */
-    char buff[LUAI_MAXSHORTLEN];
+  else if (--size <= G(L)->shortlen) {  /* short string? */
+    char buff[LIMSHORTLEN];
     loadVector(S, buff, size);  /* load string into buffer */
     ts = luaS_newlstr(L, buff, size);  /* create string */
   }
@@ -263,6 +263,7 @@ static void loadFunction (LoadState *S, Proto *f, TString *psource) {
   f->is_vararg = loadByte(S);
   f->maxstacksize = loadByte(S);
   loadCode(S, f);
+  luaF_newcounters(S->L, f);
   loadConstants(S, f);
   loadUpvalues(S, f);
   loadProtos(S, f);
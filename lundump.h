@@ -24,7 +24,13 @@
 #define MYINT(s)	(s[0]-'0')  /* assume one-digit numerals */
 #define LUAC_VERSION	(MYINT(LUA_VERSION_MAJOR)*16+MYINT(LUA_VERSION_MINOR))
 
-#define LUAC_FORMAT	0	/* this is the official format */
+/*
+** Format of precompiled code; 0 is the official format. Change it
+** whenever the instruction set changes.
+** 1: fused opcodes (OP_MOVE_CALL...)
+** 2: OP_FORLOOPGET
+*/
+#define LUAC_FORMAT	2
 
 /* load one chunk; from lundump.c */
 LUAI_FUNC LClosure* luaU_undump (lua_State* L, ZIO* Z, const char* name);
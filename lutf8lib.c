@@ -12,6 +12,7 @@
 
 #include <assert.h>
 #include <limits.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -38,6 +39,17 @@ typedef unsigned long utfint;
 #define iscont(p)	((*(p) & 0xC0) == 0x80)
 
 
+/* mask with the high bit of each byte in a 'size_t' */
+#define HIGHBITS	(~(size_t)0 / 0xFF * 0x80)
+
+/* true if the 'size_t' word at 'p' has only ASCII bytes */
+static int isasciiword (const char *p) {
+  size_t w;
+  memcpy(&w, p, sizeof(w));
+  return (w & HIGHBITS) == 0;
+}
+
+
 /* from strlib */
 /* translate a relative string position: negative means back from end */
 static lua_Integer u_posrelat (lua_Integer pos, size_t len) {
@@ -101,7 +113,16 @@ static int utflen (lua_State *L) {
   luaL_argcheck(L, --posj < (lua_Integer)len, 3,
                    "final position out of bounds");
   while (posi <= posj) {
-    const char *s1 = utf8_decode(s + posi, NULL, !lax);
+    const char *s1;
+    if ((unsigned char)s[posi] < 0x80) {  /* ASCII character? */
+      lua_Integer p0 = posi++;  /* skip it */
+      while (posj - posi >= (lua_Integer)sizeof(size_t) - 1 &&
+             isasciiword(s + posi))  /* skip whole words of ASCII */
+        posi += sizeof(size_t);
+      n += posi - p0;
+      continue;
+    }
+    s1 = utf8_decode(s + posi, NULL, !lax);
     if (s1 == NULL) {  /* conversion error? */
       luaL_pushfail(L);  /* return fail ... */
       lua_pushinteger(L, posi + 1);  /* ... and current position */
@@ -176,6 +197,163 @@ static int utfchar (lua_State *L) {
 }
 
 
+/*
+** {======================================================
+** Character indices for long strings
+** =======================================================
+*/
+
+/*
+** 'utf8.offset' keeps, for a few long strings, the byte position of
+** every UTF8IDXSTEP-th character, so that it can find any character by
+** walking at most UTF8IDXSTEP characters. Like 'utf8.offset' itself,
+** the index considers as a character start any byte that is not a
+** continuation byte, plus the first byte of the string. The indices
+** are kept in a cache (first upvalue of 'utf8.offset'), indexed by the
+** strings. The cache is cleared when it gets UTF8IDXCACHE entries or
+** when its strings add up to more than UTF8IDXBYTES bytes, which
+** bounds the memory it keeps alive.
+**
+** Building an index walks the whole string, so it is done only for
+** lookups of UTF8IDXWALK or more characters, and only when the string
+** was seen before (the first lookup just marks it in the cache) or
+** when that lookup alone would walk a good part of the string.
+*/
+
+/* minimum length of strings that get an index */
+#if !defined(UTF8IDXMIN)
+#define UTF8IDXMIN	256
+#endif
+
+/* maximum number of indices in the cache */
+#if !defined(UTF8IDXCACHE)
+#define UTF8IDXCACHE	16
+#endif
+
+/* maximum total length of the strings in the cache */
+#if !defined(UTF8IDXBYTES)
+#define UTF8IDXBYTES	(1u << 22)
+#endif
+
+/* lookups of fewer characters than this always walk the string */
+#if !defined(UTF8IDXWALK)
+#define UTF8IDXWALK	64
+#endif
+
+#define UTF8IDXSTEP	32
+
+
+typedef struct CharIdx {
+  size_t nchars;  /* number of characters in the string */
+  size_t pos[1];  /* position of each UTF8IDXSTEP-th character */
+} CharIdx;
+
+
+#define ischarstart(s,p)	((p) == 0 || !iscont((s) + (p)))
+
+
+static CharIdx *buildindex (lua_State *L, const char *s, size_t len) {
+  size_t p, n = 0;
+  CharIdx *idx = (CharIdx *)lua_newuserdatauv(L, offsetof(CharIdx, pos) +
+                        (len / UTF8IDXSTEP + 1) * sizeof(size_t), 0);
+  for (p = 0; p < len; p++) {
+    if (ischarstart(s, p)) {
+      if (n % UTF8IDXSTEP == 0)
+        idx->pos[n / UTF8IDXSTEP] = p;
+      n++;
+    }
+  }
+  idx->nchars = n;
+  return idx;
+}
+
+
+/*
+** Get the index for string 's' at index 1 for a lookup of 'n'
+** characters, from the cache or building it (see above). Returns NULL
+** when the lookup should just walk the string. Leaves the index (when
+** there is one) on the top of the stack.
+*/
+static const CharIdx *getindex (lua_State *L, const char *s, size_t len,
+                                lua_Unsigned n) {
+  int cache = lua_upvalueindex(1);
+  lua_Integer count, bytes;
+  lua_pushvalue(L, 1);
+  switch (lua_rawget(L, cache)) {
+    case LUA_TUSERDATA:  /* string has an index? */
+      return (const CharIdx *)lua_touserdata(L, -1);
+    case LUA_TBOOLEAN:  /* string was seen before? */
+      break;  /* build its index */
+    default: {  /* new entry */
+      lua_pop(L, 1);
+      lua_rawgeti(L, cache, 1);  /* number of entries in the cache */
+      lua_rawgeti(L, cache, 2);  /* total length of their strings */
+      count = lua_tointeger(L, -2);
+      bytes = lua_tointeger(L, -1);
+      lua_pop(L, 2);
+      if (count >= UTF8IDXCACHE ||
+          (count > 0 && (size_t)bytes + len > UTF8IDXBYTES)) {  /* full? */
+        lua_cleartable(L, cache);  /* start it again */
+        count = bytes = 0;
+      }
+      lua_pushinteger(L, count + 1);
+      lua_rawseti(L, cache, 1);
+      lua_pushinteger(L, bytes + (lua_Integer)len);
+      lua_rawseti(L, cache, 2);
+      if (n < len / 4) {  /* not worth an index yet? */
+        lua_pushvalue(L, 1);
+        lua_pushboolean(L, 1);
+        lua_rawset(L, cache);  /* mark string as seen */
+        return NULL;
+      }
+    }
+  }
+  buildindex(L, s, len);
+  lua_pushvalue(L, 1);
+  lua_pushvalue(L, -2);
+  lua_rawset(L, cache);  /* cache[s] = index */
+  return (const CharIdx *)lua_touserdata(L, -1);
+}
+
+
+/* number of the character that starts at position 'p' (0-based) */
+static size_t charnumber (const CharIdx *idx, const char *s, size_t len,
+                          size_t p) {
+  size_t lo = 0, hi, q, n;
+  if (p >= len)
+    return idx->nchars;
+  hi = (idx->nchars - 1) / UTF8IDXSTEP;
+  while (lo < hi) {  /* find last indexed character before 'p' */
+    size_t m = (lo + hi + 1) / 2;
+    if (idx->pos[m] <= p) lo = m;
+    else hi = m - 1;
+  }
+  n = lo * UTF8IDXSTEP;
+  for (q = idx->pos[lo] + 1; q <= p; q++)  /* count remaining starts */
+    n += !iscont(s + q);
+  return n;
+}
+
+
+/* position of character number 'n' (0-based) */
+static size_t charposition (const CharIdx *idx, const char *s, size_t len,
+                            size_t n) {
+  size_t p;
+  int k;
+  if (n >= idx->nchars)
+    return len;
+  p = idx->pos[n / UTF8IDXSTEP];
+  for (k = (int)(n % UTF8IDXSTEP); k > 0; k--) {
+    do {  /* find beginning of next character */
+      p++;
+    } while (iscont(s + p));  /* (cannot pass final '\0') */
+  }
+  return p;
+}
+
+/* }====================================================== */
+
+
 /*
 ** offset(s, n, [i])  -> index where n-th character counting from
 **   position 'i' starts; 0 means character at 'i'.
@@ -185,9 +363,22 @@ static int byteoffset (lua_State *L) {
   const char *s = luaL_checklstring(L, 1, &len);
   lua_Integer n  = luaL_checkinteger(L, 2);
   lua_Integer posi = (n >= 0) ? 1 : len + 1;
+  lua_Unsigned an = (n >= 0) ? (lua_Unsigned)n : 0u - (lua_Unsigned)n;
+  const CharIdx *idx;
   posi = u_posrelat(luaL_optinteger(L, 3, posi), len);
   luaL_argcheck(L, 1 <= posi && --posi <= (lua_Integer)len, 3,
                    "position out of bounds");
+  if (an >= UTF8IDXWALK && len >= UTF8IDXMIN && !iscont(s + posi) &&
+      (idx = getindex(L, s, len, an)) != NULL) {
+    size_t c = charnumber(idx, s, len, (size_t)posi);  /* char. at 'posi' */
+    if (n > 0 && an - 1 <= idx->nchars - c)
+      lua_pushinteger(L, charposition(idx, s, len, c + (size_t)(an - 1)) + 1);
+    else if (n < 0 && an <= c)
+      lua_pushinteger(L, charposition(idx, s, len, c - (size_t)an) + 1);
+    else  /* no such character */
+      luaL_pushfail(L);
+    return 1;
+  }
   if (n == 0) {
     /* find beginning of current byte sequence */
     while (posi > 0 && iscont(s + posi)) posi--;
@@ -269,7 +460,7 @@ static int iter_codes (lua_State *L) {
 
 
 static const luaL_Reg funcs[] = {
-  {"offset", byteoffset},
+  {"offset", NULL},  /* place holder */
   {"codepoint", codepoint},
   {"char", utfchar},
   {"len", utflen},
@@ -284,6 +475,9 @@ LUAMOD_API int luaopen_utf8 (lua_State *L) {
   luaL_newlib(L, funcs);
   lua_pushlstring(L, UTF8PATT, sizeof(UTF8PATT)/sizeof(char) - 1);
   lua_setfield(L, -2, "charpattern");
+  lua_newtable(L);  /* cache for character indices */
+  lua_pushcclosure(L, byteoffset, 1);
+  lua_setfield(L, -2, "offset");
   return 1;
 }
 
@@ -334,6 +334,8 @@ void luaV_finishset (lua_State *L, const TValue *t, TValue *key,
     const TValue *tm;  /* '__newindex' metamethod */
     if (slot != NULL) {  /* is 't' a table? */
       Table *h = hvalue(t);  /* save 't' table */
+      if (unlikely(isfrozen(h)))
+        luaG_frozenerror(L, t);
       lua_assert(isempty(slot));  /* slot must be empty */
       tm = fasttm(L, h->metatable, TM_NEWINDEX);  /* get metamethod */
       if (tm == NULL) {  /* no metamethod? */
@@ -358,7 +360,7 @@ void luaV_finishset (lua_State *L, const TValue *t, TValue *key,
       return;
     }
     t = tm;  /* else repeat assignment over 'tm' */
-    if (luaV_fastget(L, t, key, slot, luaH_get)) {
+    if (luaV_fastset(L, t, key, slot, luaH_get)) {
       luaV_finishfastset(L, t, slot, val);
       return;  /* done */
     }
@@ -658,8 +660,8 @@ void luaV_concat (lua_State *L, int total) {
           luaG_runerror(L, "string length overflow");
         tl += l;
       }
-      if (tl <= LUAI_MAXSHORTLEN) {  /* is result a short string? */
-        char buff[LUAI_MAXSHORTLEN];
+      if (tl <= G(L)->shortlen) {  /* is result a short string? */
+        char buff[LIMSHORTLEN];
         copy2buff(top, n, buff);  /* copy strings to buffer */
         ts = luaS_newlstr(L, buff, tl);
       }
@@ -807,7 +809,7 @@ void luaV_finishOp (lua_State *L) {
   CallInfo *ci = L->ci;
   StkId base = ci->func + 1;
   Instruction inst = *(ci->u.l.savedpc - 1);  /* interrupted instruction */
-  OpCode op = GET_OPCODE(inst);
+  OpCode op = GET_BASEOP(inst);
   switch (op) {  /* finish its execution */
     case OP_MMBIN: case OP_MMBINI: case OP_MMBINK: {
       setobjs2s(L, base + GETARG_A(*(ci->u.l.savedpc - 2)), --L->top);
@@ -1018,6 +1020,46 @@ void luaV_finishOp (lua_State *L) {
         }  \
         docondjump(); }
 
+
+/*
+** Indexing operations that may start a superinstruction
+*/
+#define op_gettabup(L) {  \
+        const TValue *slot;  \
+        TValue *upval = cl->upvals[GETARG_B(i)]->v;  \
+        TValue *rc = KC(i);  \
+        TString *key = tsvalue(rc);  /* key must be a string */  \
+        if (luaV_fastget(L, upval, key, slot, luaH_getshortstr)) {  \
+          setobj2s(L, ra, slot);  \
+        }  \
+        else  \
+          Protect(luaV_finishget(L, upval, rc, ra, slot)); }
+
+
+#define op_getfield(L) {  \
+        const TValue *slot;  \
+        TValue *rb = vRB(i);  \
+        TValue *rc = KC(i);  \
+        TString *key = tsvalue(rc);  /* key must be a string */  \
+        if (luaV_fastget(L, rb, key, slot, luaH_getshortstr)) {  \
+          setobj2s(L, ra, slot);  \
+        }  \
+        else  \
+          Protect(luaV_finishget(L, rb, rc, ra, slot)); }
+
+
+#define op_self(L) {  \
+        const TValue *slot;  \
+        TValue *rb = vRB(i);  \
+        TValue *rc = RKC(i);  \
+        TString *key = tsvalue(rc);  /* key must be a string */  \
+        setobj2s(L, ra + 1, rb);  \
+        if (luaV_fastget(L, rb, key, slot, luaH_getstr)) {  \
+          setobj2s(L, ra, slot);  \
+        }  \
+        else  \
+          Protect(luaV_finishget(L, rb, rc, ra, slot)); }
+
 /* }================================================================== */
 
 
@@ -1045,6 +1087,19 @@ void luaV_finishOp (lua_State *L) {
 
 #define updatetrap(ci)  (trap = ci->u.l.trap)
 
+
+/*
+** Advance an integer loop with 'count' (> 0) iterations left, leaving
+** the new value of the control variable in 'idx'.
+*/
+#define forinext(ra,count,idx)  { \
+	lua_Integer step = ivalue(s2v(ra + 2)); \
+	idx = ivalue(s2v(ra));  /* internal index */ \
+	chgivalue(s2v(ra + 1), count - 1);  /* update counter */ \
+	idx = intop(+, idx, step);  /* add step to index */ \
+	chgivalue(s2v(ra), idx);  /* update internal index */ \
+	setivalue(s2v(ra + 3), idx);  /* and control variable */ }
+
 #define updatebase(ci)	(base = ci->func + 1)
 
 
@@ -1059,7 +1114,8 @@ void luaV_finishOp (lua_State *L) {
 
 
 /* for test instructions, execute the jump instruction that follows it */
-#define donextjump(ci)	{ Instruction ni = *pc; dojump(ci, ni, 1); }
+#define donextjump(ci)	{ Instruction ni = *pc; dojump(ci, ni, 1); \
+	  if (GETARG_sJ(ni) < 0) chargebudget(L, ci); }
 
 /*
 ** do a conditional jump: skip next instruction if 'cond' is not what
@@ -1069,6 +1125,14 @@ void luaV_finishOp (lua_State *L) {
 #define docondjump()	if (cond != GETARG_k(i)) pc++; else donextjump(ci);
 
 
+/*
+** Charge one unit of the thread's budget. Used only where the thread
+** can stop: after backward jumps and at the entry of Lua functions.
+*/
+#define chargebudget(L,ci)  \
+	{ if (--L->budget <= 0) Protect(luaD_outofbudget(L)); }
+
+
 /*
 ** Correct global 'pc'.
 */
@@ -1097,6 +1161,14 @@ void luaV_finishOp (lua_State *L) {
 */
 #define halfProtect(exp)  (savestate(L,ci), (exp))
 
+/*
+** Check whether instruction 'ni', following an OP_VARARG that gets all
+** varargs into 'ra', is a call that gets them as its last arguments.
+*/
+#define isvarargcall(ni,ra)  \
+	((GET_OPCODE(ni) == OP_CALL || GET_OPCODE(ni) == OP_TAILCALL) && \
+	 GETARG_B(ni) == 0 && base + GETARG_A(ni) < (ra))
+
 /* 'c' is the limit of live values in the stack */
 #define checkGC(L,c)  \
 	{ luaC_condGC(L, (savepc(L), L->top = (c)), \
@@ -1110,7 +1182,22 @@ void luaV_finishOp (lua_State *L) {
     trap = luaG_traceexec(L, pc);  /* handle hooks */ \
     updatebase(ci);  /* correct stack */ \
   } \
+  vmfetchnext(); \
+}
+
+/* count the execution of instruction 'i' (already fetched) */
+#if defined(LUA_VMSTATS)
+#define vmcount(i)  \
+	(G(L)->opcount[GET_OPCODE(i)]++, cl->p->execcount[pcRel(pc, cl->p)]++)
+#else
+#define vmcount(i)	((void)0)
+#endif
+
+/* fetch the next instruction, with no checks */
+#define vmfetchnext()	{ \
   i = *(pc++); \
+  vmcount(i); \
+  luai_opexec(L, i); \
   ra = RA(i); /* WARNING: any stack reallocation invalidates 'ra' */ \
 }
 
@@ -1118,6 +1205,13 @@ void luaV_finishOp (lua_State *L) {
 #define vmcase(l)	case l:
 #define vmbreak		break
 
+/*
+** Finish a superinstruction, going to the next instruction, whose
+** opcode is 'l'. With a jump table, it jumps directly to the code
+** for 'l', unless it must stop for hooks.
+*/
+#define vmfuse(l)	vmbreak
+
 
 void luaV_execute (lua_State *L, CallInfo *ci) {
   LClosure *cl;
@@ -1144,6 +1238,8 @@ void luaV_execute (lua_State *L, CallInfo *ci) {
     ci->u.l.trap = 1;  /* assume trap is on, for now */
   }
   base = ci->func + 1;
+  if (pc == cl->p->code && !cl->p->is_vararg)  /* entering function? */
+    chargebudget(L, ci);  /* (vararg ones are charged after VARARGPREP) */
   /* main loop of interpreter */
   for (;;) {
     Instruction i;  /* instruction being executed */
@@ -1211,15 +1307,7 @@ void luaV_execute (lua_State *L, CallInfo *ci) {
         vmbreak;
       }
       vmcase(OP_GETTABUP) {
-        const TValue *slot;
-        TValue *upval = cl->upvals[GETARG_B(i)]->v;
-        TValue *rc = KC(i);
-        TString *key = tsvalue(rc);  /* key must be a string */
-        if (luaV_fastget(L, upval, key, slot, luaH_getshortstr)) {
-          setobj2s(L, ra, slot);
-        }
-        else
-          Protect(luaV_finishget(L, upval, rc, ra, slot));
+        op_gettabup(L);
         vmbreak;
       }
       vmcase(OP_GETTABLE) {
@@ -1251,15 +1339,7 @@ void luaV_execute (lua_State *L, CallInfo *ci) {
         vmbreak;
       }
       vmcase(OP_GETFIELD) {
-        const TValue *slot;
-        TValue *rb = vRB(i);
-        TValue *rc = KC(i);
-        TString *key = tsvalue(rc);  /* key must be a string */
-        if (luaV_fastget(L, rb, key, slot, luaH_getshortstr)) {
-          setobj2s(L, ra, slot);
-        }
-        else
-          Protect(luaV_finishget(L, rb, rc, ra, slot));
+        op_getfield(L);
         vmbreak;
       }
       vmcase(OP_SETTABUP) {
@@ -1268,7 +1348,7 @@ void luaV_execute (lua_State *L, CallInfo *ci) {
         TValue *rb = KB(i);
         TValue *rc = RKC(i);
         TString *key = tsvalue(rb);  /* key must be a string */
-        if (luaV_fastget(L, upval, key, slot, luaH_getshortstr)) {
+        if (luaV_fastset(L, upval, key, slot, luaH_getshortstr)) {
           luaV_finishfastset(L, upval, slot, rc);
         }
         else
@@ -1281,8 +1361,8 @@ void luaV_execute (lua_State *L, CallInfo *ci) {
         TValue *rc = RKC(i);  /* value */
         lua_Unsigned n;
         if (ttisinteger(rb)  /* fast track for integers? */
-            ? (cast_void(n = ivalue(rb)), luaV_fastgeti(L, s2v(ra), n, slot))
-            : luaV_fastget(L, s2v(ra), rb, slot, luaH_get)) {
+            ? (cast_void(n = ivalue(rb)), luaV_fastseti(L, s2v(ra), n, slot))
+            : luaV_fastset(L, s2v(ra), rb, slot, luaH_get)) {
           luaV_finishfastset(L, s2v(ra), slot, rc);
         }
         else
@@ -1293,7 +1373,7 @@ void luaV_execute (lua_State *L, CallInfo *ci) {
         const TValue *slot;
         int c = GETARG_B(i);
         TValue *rc = RKC(i);
-        if (luaV_fastgeti(L, s2v(ra), c, slot)) {
+        if (luaV_fastseti(L, s2v(ra), c, slot)) {
           luaV_finishfastset(L, s2v(ra), slot, rc);
         }
         else {
@@ -1308,7 +1388,7 @@ void luaV_execute (lua_State *L, CallInfo *ci) {
         TValue *rb = KB(i);
         TValue *rc = RKC(i);
         TString *key = tsvalue(rb);  /* key must be a string */
-        if (luaV_fastget(L, s2v(ra), key, slot, luaH_getshortstr)) {
+        if (luaV_fastset(L, s2v(ra), key, slot, luaH_getshortstr)) {
           luaV_finishfastset(L, s2v(ra), slot, rc);
         }
         else
@@ -1334,16 +1414,7 @@ void luaV_execute (lua_State *L, CallInfo *ci) {
         vmbreak;
       }
       vmcase(OP_SELF) {
-        const TValue *slot;
-        TValue *rb = vRB(i);
-        TValue *rc = RKC(i);
-        TString *key = tsvalue(rc);  /* key must be a string */
-        setobj2s(L, ra + 1, rb);
-        if (luaV_fastget(L, rb, key, slot, luaH_getstr)) {
-          setobj2s(L, ra, slot);
-        }
-        else
-          Protect(luaV_finishget(L, rb, rc, ra, slot));
+        op_self(L);
         vmbreak;
       }
       vmcase(OP_ADDI) {
@@ -1537,6 +1608,8 @@ void luaV_execute (lua_State *L, CallInfo *ci) {
       }
       vmcase(OP_JMP) {
         dojump(ci, i, 0);
+        if (GETARG_sJ(i) < 0)  /* backward jump? */
+          chargebudget(L, ci);
         vmbreak;
       }
       vmcase(OP_EQ) {
@@ -1612,7 +1685,10 @@ void luaV_execute (lua_State *L, CallInfo *ci) {
           L->top = ra + b;  /* top signals number of arguments */
         /* else previous instruction set top */
         savepc(L);  /* in case of errors */
-        if ((newci = luaD_precall(L, ra, nresults)) == NULL)
+        if (luaD_isfastcall(L, ra) && luaD_fastcall(L, ra, nresults)) {
+          /* fast C call; nothing else to be done */
+        }
+        else if ((newci = luaD_precall(L, ra, nresults)) == NULL)
           updatetrap(ci);  /* C call; nothing else to be done */
         else {  /* Lua call: run function in this same C frame */
           ci = newci;
@@ -1723,17 +1799,16 @@ void luaV_execute (lua_State *L, CallInfo *ci) {
         if (ttisinteger(s2v(ra + 2))) {  /* integer loop? */
           lua_Unsigned count = l_castS2U(ivalue(s2v(ra + 1)));
           if (count > 0) {  /* still more iterations? */
-            lua_Integer step = ivalue(s2v(ra + 2));
-            lua_Integer idx = ivalue(s2v(ra));  /* internal index */
-            chgivalue(s2v(ra + 1), count - 1);  /* update counter */
-            idx = intop(+, idx, step);  /* add step to index */
-            chgivalue(s2v(ra), idx);  /* update internal index */
-            setivalue(s2v(ra + 3), idx);  /* and control variable */
+            lua_Integer idx;
+            forinext(ra, count, idx);
             pc -= GETARG_Bx(i);  /* jump back */
+            chargebudget(L, ci);
           }
         }
-        else if (floatforloop(ra))  /* float loop */
+        else if (floatforloop(ra)) {  /* float loop */
           pc -= GETARG_Bx(i);  /* jump back */
+          chargebudget(L, ci);
+        }
         updatetrap(ci);  /* allows a signal to break the loop */
         vmbreak;
       }
@@ -1743,6 +1818,36 @@ void luaV_execute (lua_State *L, CallInfo *ci) {
           pc += GETARG_Bx(i) + 1;  /* skip the loop */
         vmbreak;
       }
+      vmcase(OP_FORLOOPGET) {
+        if (ttisinteger(s2v(ra + 2))) {  /* integer loop? */
+          lua_Unsigned count = l_castS2U(ivalue(s2v(ra + 1)));
+          if (count > 0) {  /* still more iterations? */
+            lua_Integer idx;
+            forinext(ra, count, idx);
+            pc -= GETARG_Bx(i);  /* jump back */
+            if (!trap) {  /* no hooks? try to run the OP_GETTABLE here */
+              Instruction ni = *pc;
+              TValue *rb = vRB(ni);
+              const TValue *slot;
+              lua_assert(GET_OPCODE(ni) == OP_GETTABLE &&
+                         vRC(ni) == s2v(ra + 3));
+              if (luaV_fastgeti(L, rb, idx, slot)) {
+                setobj2s(L, RA(ni), slot);
+                pc++;  /* skip it */
+                vmcount(ni);
+                luai_opexec(L, ni);
+              }
+            }
+            chargebudget(L, ci);
+          }
+        }
+        else if (floatforloop(ra)) {  /* float loop */
+          pc -= GETARG_Bx(i);  /* jump back */
+          chargebudget(L, ci);
+        }
+        updatetrap(ci);
+        vmbreak;
+      }
       vmcase(OP_TFORPREP) {
         /* create to-be-closed upvalue (if needed) */
         halfProtect(luaF_newtbcupval(L, ra + 3));
@@ -1772,6 +1877,7 @@ void luaV_execute (lua_State *L, CallInfo *ci) {
         if (!ttisnil(s2v(ra + 4))) {  /* continue loop? */
           setobjs2s(L, ra + 2, ra + 4);  /* save control variable */
           pc -= GETARG_Bx(i);  /* jump back */
+          chargebudget(L, ci);
         }
         vmbreak;
       }
@@ -1806,6 +1912,58 @@ void luaV_execute (lua_State *L, CallInfo *ci) {
       }
       vmcase(OP_VARARG) {
         int n = GETARG_C(i) - 1;  /* required results */
+        if (n < 0 && !trap && isvarargcall(*pc, ra)) {
+          /* varargs go to the following call; try to leave them in place */
+          Instruction ni = *pc;
+          StkId func = base + GETARG_A(ni);  /* function being called */
+          int nextra = ci->u.l.nextraargs;
+          StkId extra = ci->func - nextra;  /* first vararg */
+          if (luaD_isfastcall(L, func)) {
+            L->top = ra;  /* fixed arguments end here */
+            savepc(L);  /* in case of errors */
+            if (GET_OPCODE(ni) == OP_CALL) {
+              if (luaD_fastcallv(L, func, GETARG_C(ni) - 1, extra, nextra)) {
+                pc++;  /* skip the call */
+                updatetrap(ci);  /* stack may have been reallocated */
+                vmbreak;
+              }
+            }
+            else if (luaD_fastcallv(L, func, LUA_MULTRET, extra, nextra)) {
+              /* a fast C function in a tail call; finish caller */
+              StkId res = L->top;  /* results end here */
+              lua_assert(GET_OPCODE(ni) == OP_TAILCALL);
+              pc++;  /* skip the tail call */
+              if (TESTARG_k(ni)) {  /* close upvalues (no tbc variables) */
+                if (L->top < ci->top)
+                  L->top = ci->top;
+                luaF_close(L, ci->func + 1, NOCLOSINGMETH);
+                L->top = res;
+              }
+              updatebase(ci);
+              func = base + GETARG_A(ni);
+              ci->func -= nextra + GETARG_C(ni);  /* restore 'func' */
+              luaD_poscall(L, ci, cast_int(res - func));
+              updatetrap(ci);  /* 'luaD_poscall' can change hooks */
+              goto ret;
+            }
+          }
+          else if (GET_OPCODE(ni) == OP_TAILCALL && GETARG_C(ni) == 1 &&
+                   func == ra - 1 && ttisLclosure(s2v(func))) {
+            /* 'return f(...)' with no fixed parameters: the varargs are
+               already in place as the arguments of the callee */
+            pc++;  /* skip the tail call */
+            savepc(ci);
+            L->top = ra;
+            if (TESTARG_k(ni)) {  /* close upvalues (no tbc variables) */
+              luaF_close(L, base, NOCLOSINGMETH);
+              lua_assert(base == ci->func + 1);
+            }
+            ci->func = extra - 1;  /* restore 'func' */
+            setobjs2s(L, ci->func, func);  /* callee goes below its arguments */
+            luaD_pretailcall(L, ci, ci->func, nextra + 1);
+            goto startfunc;
+          }
+        }
         Protect(luaT_getvarargs(L, ci, ra, n));
         vmbreak;
       }
@@ -1816,12 +1974,29 @@ void luaV_execute (lua_State *L, CallInfo *ci) {
           L->oldpc = 1;  /* next opcode will be seen as a "new" line */
         }
         updatebase(ci);  /* function has new base after adjustment */
+        chargebudget(L, ci);
         vmbreak;
       }
       vmcase(OP_EXTRAARG) {
         lua_assert(0);
         vmbreak;
       }
+      vmcase(OP_MOVE_CALL) {
+        setobjs2s(L, ra, RB(i));
+        vmfuse(OP_CALL);
+      }
+      vmcase(OP_GETTABUP_GETFIELD) {
+        op_gettabup(L);
+        vmfuse(OP_GETFIELD);
+      }
+      vmcase(OP_GETFIELD_CALL) {
+        op_getfield(L);
+        vmfuse(OP_CALL);
+      }
+      vmcase(OP_SELF_CALL) {
+        op_self(L);
+        vmfuse(OP_CALL);
+      }
     }
   }
 }
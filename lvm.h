@@ -99,6 +99,18 @@ typedef enum {
       !isempty(slot)))  /* result not empty? */
 
 
+/*
+** Fast track for assignments: like 'luaV_fastget' and 'luaV_fastgeti',
+** but also fail for frozen tables, so that 'luaV_finishset' raises
+** the error.
+*/
+#define luaV_fastset(L,t,k,slot,f) \
+  (luaV_fastget(L,t,k,slot,f) && !isfrozen(hvalue(t)))
+
+#define luaV_fastseti(L,t,k,slot) \
+  (luaV_fastgeti(L,t,k,slot) && !isfrozen(hvalue(t)))
+
+
 /*
 ** Finish a fast set operation (when fast get succeeds). In that case,
 ** 'slot' points to the place to put the value.
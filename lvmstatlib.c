@@ -0,0 +1,250 @@
+/*
+** $Id: lvmstatlib.c $
+** Execution statistics of the interpreter
+** See Copyright Notice in lua.h
+*/
+
+#define lvmstatlib_c
+#define LUA_LIB
+
+#include "lprefix.h"
+
+
+#include <stdio.h>
+
+#include "lua.h"
+
+#include "lauxlib.h"
+#include "lualib.h"
+
+
+#if defined(LUA_VMSTATS)	/* { */
+
+/* default number of entries in lists of hot spots */
+#define NHOT		10
+
+/* maximum number of entries in lists of hot spots */
+#define MAXHOT		10000
+
+/* maximum number of opcodes (they have 7 bits) */
+#define MAXOPS		128
+
+
+static lua_Integer totalops (lua_State *L) {
+  lua_Integer total = 0;
+  lua_Integer c;
+  int op;
+  for (op = 0; (c = lua_vmopcount(L, op, NULL)) >= 0; op++)
+    total += c;
+  return total;
+}
+
+
+static int checkmax (lua_State *L, int arg) {
+  lua_Integer max = luaL_optinteger(L, arg, NHOT);
+  luaL_argcheck(L, 0 < max && max <= MAXHOT, arg, "out of range");
+  return (int)max;
+}
+
+
+/*
+** Collect in a new userdata the 'max' most executed instructions or (if
+** 'calls') most called functions. Returns the number of entries.
+*/
+static lua_VMSpot *collectspots (lua_State *L, int max, int calls, int *n,
+                                 lua_Integer *total) {
+  lua_VMSpot *s = (lua_VMSpot *)lua_newuserdatauv(L,
+                                                  max * sizeof(lua_VMSpot), 0);
+  *n = lua_vmspots(L, s, max, calls, total);
+  return s;
+}
+
+
+/*
+** Push a list with the entries of 's', as tables.
+*/
+static void pushspots (lua_State *L, const lua_VMSpot *s, int n) {
+  int i;
+  lua_createtable(L, n, 0);
+  for (i = 0; i < n; i++) {
+    lua_createtable(L, 0, 5);
+    lua_pushinteger(L, s[i].count);
+    lua_setfield(L, -2, "count");
+    lua_pushstring(L, s[i].short_src);
+    lua_setfield(L, -2, "source");
+    lua_pushinteger(L, s[i].line);
+    lua_setfield(L, -2, "line");
+    if (s[i].op != NULL) {
+      lua_pushinteger(L, s[i].pc);
+      lua_setfield(L, -2, "pc");
+      lua_pushstring(L, s[i].op);
+      lua_setfield(L, -2, "op");
+    }
+    lua_rawseti(L, -2, i + 1);
+  }
+}
+
+
+static int vms_opcodes (lua_State *L) {
+  const char *name;
+  lua_Integer c;
+  int op;
+  lua_newtable(L);
+  for (op = 0; (c = lua_vmopcount(L, op, &name)) >= 0; op++) {
+    if (c > 0) {
+      lua_pushinteger(L, c);
+      lua_setfield(L, -2, name);
+    }
+  }
+  return 1;
+}
+
+
+static int vms_hot (lua_State *L) {
+  int n;
+  lua_VMSpot *s = collectspots(L, checkmax(L, 1), 0, &n, NULL);
+  pushspots(L, s, n);
+  return 1;
+}
+
+
+static int vms_calls (lua_State *L) {
+  int n;
+  lua_VMSpot *s = collectspots(L, checkmax(L, 1), 1, &n, NULL);
+  pushspots(L, s, n);
+  return 1;
+}
+
+
+static int vms_reset (lua_State *L) {
+  lua_vmreset(L);
+  return 0;
+}
+
+
+/*
+** {======================================================
+** Report
+** =======================================================
+*/
+
+#define addcount(b,buff,c,total)  \
+  (snprintf(buff, sizeof(buff), "%14" LUA_INTEGER_FRMLEN "d %6.2f%%  ", \
+            (LUAI_UACINT)(c), (total) ? 100.0 * (c) / (total) : 0.0), \
+   luaL_addstring(b, buff))
+
+
+static void addopcodes (luaL_Buffer *b, lua_State *L, lua_Integer total) {
+  lua_Integer count[MAXOPS];
+  const char *name[MAXOPS];
+  char buff[100];
+  int n = 0;
+  int op, i;
+  lua_Integer c;
+  const char *opname;
+  for (op = 0; op < MAXOPS && (c = lua_vmopcount(L, op, &opname)) >= 0;
+               op++) {
+    if (c == 0) continue;
+    for (i = n++; i > 0 && count[i - 1] < c; i--) {  /* insertion sort */
+      count[i] = count[i - 1];
+      name[i] = name[i - 1];
+    }
+    count[i] = c;
+    name[i] = opname;
+  }
+  luaL_addstring(b, "opcodes:\n");
+  for (i = 0; i < n; i++) {
+    addcount(b, buff, count[i], total);
+    luaL_addstring(b, name[i]);
+    luaL_addchar(b, '\n');
+  }
+}
+
+
+static void addspots (luaL_Buffer *b, const lua_VMSpot *s, int n,
+                      lua_Integer total) {
+  char buff[LUA_IDSIZE + 100];
+  int i;
+  for (i = 0; i < n; i++) {
+    addcount(b, buff, s[i].count, total);
+    luaL_addstring(b, s[i].short_src);
+    snprintf(buff, sizeof(buff), ":%d", s[i].line);
+    luaL_addstring(b, buff);
+    if (s[i].op != NULL) {
+      snprintf(buff, sizeof(buff), " [%d] %s", s[i].pc, s[i].op);
+      luaL_addstring(b, buff);
+    }
+    luaL_addchar(b, '\n');
+  }
+}
+
+
+static int vms_report (lua_State *L) {
+  int max = checkmax(L, 1);
+  lua_Integer total = totalops(L);
+  lua_Integer totalcalls;
+  lua_VMSpot *hot, *fns;
+  int nhot, nfns;
+  luaL_Buffer b;
+  hot = collectspots(L, max, 0, &nhot, NULL);
+  fns = collectspots(L, max, 1, &nfns, &totalcalls);
+  luaL_buffinit(L, &b);
+  lua_pushfstring(L, "instructions executed: %I\n",
+                     (LUAI_UACINT)total);
+  luaL_addvalue(&b);
+  addopcodes(&b, L, total);
+  luaL_addstring(&b, "hot instructions:\n");
+  addspots(&b, hot, nhot, total);
+  luaL_addstring(&b, "most called functions:\n");
+  addspots(&b, fns, nfns, totalcalls);
+  luaL_pushresult(&b);
+  return 1;
+}
+
+/* }====================================================== */
+
+
+static const luaL_Reg vms_funcs[] = {
+  {"opcodes", vms_opcodes},
+  {"hot", vms_hot},
+  {"calls", vms_calls},
+  {"reset", vms_reset},
+  {"report", vms_report},
+  {NULL, NULL}
+};
+
+
+LUAMOD_API int luaopen_vmstats (lua_State *L) {
+  luaL_newlib(L, vms_funcs);
+  lua_pushboolean(L, 1);
+  lua_setfield(L, -2, "enabled");
+  return 1;
+}
+
+#else				/* }{ */
+
+/*
+** Without LUA_VMSTATS, the library exists but all its functions fail.
+*/
+static int vms_notavailable (lua_State *L) {
+  return luaL_error(L, "vmstats not available (Lua built without "
+                       "LUA_VMSTATS)");
+}
+
+
+LUAMOD_API int luaopen_vmstats (lua_State *L) {
+  static const char *const names[] = {"opcodes", "hot", "calls", "reset",
+                                      "report", NULL};
+  int i;
+  lua_createtable(L, 0, 6);
+  for (i = 0; names[i] != NULL; i++) {
+    lua_pushcfunction(L, vms_notavailable);
+    lua_setfield(L, -2, names[i]);
+  }
+  lua_pushboolean(L, 0);
+  lua_setfield(L, -2, "enabled");
+  return 1;
+}
+
+#endif				/* } */
+
@@ -93,6 +93,8 @@
 #include "lstrlib.c"
 #include "ltablib.c"
 #include "lutf8lib.c"
+#include "lasynclib.c"
+#include "lvmstatlib.c"
 #include "linit.c"
 #endif
 
@@ -196,6 +196,8 @@ assert(dofile('events.lua') == 12)
 dofile('vararg.lua')
 dofile('closure.lua')
 dofile('coroutine.lua')
+dofile('async.lua')
+dofile('vmstats.lua')
 dofile('goto.lua', true)
 dofile('errors.lua')
 dofile('math.lua')
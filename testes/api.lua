@@ -388,8 +388,10 @@ assert(to("func2num", 20) == 0)
 assert(to("func2num", T.pushuserdata(10)) == 0)
 assert(to("func2num", io.read) ~= 0)     -- light C function
 assert(to("func2num", hfunc) ~= 0)  -- "heavy" C function (with upvalue)
-a = to("tocfunction", math.deg)
-assert(a(3) == math.deg(3) and a == math.deg)
+a = to("tocfunction", math.ult)
+assert(a(3, 4) == math.ult(3, 4) and a == math.ult)
+a = to("tocfunction", math.deg)    -- function with a fast version
+assert(a(3) == math.deg(3) and a ~= math.deg)
 
 
 print("testing panic function")
@@ -507,10 +509,12 @@ function checkerrnopro (code, msg)
 end
 
 if not _soft then
+  collectgarbage("stop")   -- avoid __gc with full stack
   checkerrnopro("pushnum 3; call 0 0", "attempt to call")
   print"testing stack overflow in unprotected thread"
   function f () f() end
   checkerrnopro("getglobal 'f'; call 0 0;", "stack overflow")
+  collectgarbage("restart")
 end
 print"+"
 
@@ -1436,6 +1440,67 @@ do   -- garbage collection with no extra memory
   T.closestate(L)
 end
 
+do   -- maximum length of short strings
+  local L = T.newstate()
+  -- memory-error message (17 chars) is already a short string
+  assert(not T.testC(L, "setshortlen 16; return 1"))
+  assert(T.testC(L, "setshortlen 17; return 1"))
+  assert(T.testC(L, "setshortlen 100; return 1"))
+  T.loadlib(L)
+  local res = (T.doremote(L, [[
+    _ENV = require"_G"
+    local T = require"T"
+    string = require"string"
+    collectgarbage("stop")
+    local s0 = string.rep("y", 90)   -- create auxiliary strings
+    local _, n = T.querystr()
+    local s1 = string.rep("x", 90)
+    local _, n1 = T.querystr()
+    assert(n1 == n + 1)   -- new string was internalized
+    assert(s1 == string.rep("xx", 45))
+    local s2 = string.rep("x", 101)
+    assert(select(2, T.querystr()) == n1)   -- long string
+    X = {s1, s2}
+    return 'ok'
+  ]]))
+  assert(res == 'ok')
+  assert(not T.testC(L, "setshortlen 89; return 1"))   -- would change 's1'
+  assert(not T.testC(L, "setshortlen 101; return 1"))  -- would change 's2'
+  assert(T.testC(L, "setshortlen 90; return 1"))
+  assert(T.doremote(L, [=[
+    local t = {[string.rep("x", 90)] = 1, [string.rep("x", 101)] = 2}
+    return t[X[1]] + t[X[2]]
+  ]=]) == "3")
+  T.closestate(L)
+end
+
+do   -- string table growing while strings are created and collected
+  local t = {}
+  for i = 1, 20000 do
+    t[i] = "growing" .. i
+    if i % 7 == 0 then t[i // 2] = nil end   -- create garbage
+    if i % 1000 == 0 then collectgarbage("step") end
+  end
+  for i = 1, 20000 do
+    if t[i] then assert(t[i] == "growing" .. i) end
+  end
+  local ks = {}
+  for i = 1, 20000 do ks["growing" .. i] = i end
+  for i = 1, 20000 do assert(ks[t[i] or ("growing" .. i)] == i) end
+  -- 'querystr' sees all strings, including those not moved yet
+  collectgarbage("stop")
+  for i = 1, 8000 do
+    t[i] = "querying" .. i
+    if i % 500 == 0 then
+      local size, nuse = T.querystr()
+      local n = 0
+      for s = 1, size do n = n + select("#", T.querystr(s)) end
+      assert(n == nuse)
+    end
+  end
+  collectgarbage("restart")
+end
+
 print'+'
 
 -- testing some auxlib functions
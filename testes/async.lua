@@ -0,0 +1,218 @@
+-- $Id: testes/async.lua $
+-- See Copyright Notice in file all.lua
+
+print "testing async library"
+
+local async = require"async"
+
+local function checkerror (msg, f, ...)
+  local s, err = pcall(f, ...)
+  assert(not s and string.find(err, msg))
+end
+
+
+do   -- platform without epoll?
+  local st, msg = pcall(async.pipe)
+  if not st then
+    assert(string.find(msg, "not available"))
+    print "async library not available; skipping tests"
+    print "OK"
+    return
+  end
+end
+
+
+do   -- basic scheduling: plain yields interleave tasks
+  local t = {}
+  for i = 1, 3 do
+    async.spawn(function (a, b)
+      assert(a == i and b == "x")
+      for j = 1, 3 do t[#t + 1] = i * 10 + j; coroutine.yield() end
+    end, i, "x")
+  end
+  assert(select(2, async.running()) == 3)
+  async.run()
+  assert(table.concat(t, " ") == "11 21 31 12 22 32 13 23 33")
+  assert(select(2, async.running()) == 0)
+  async.run()   -- no tasks: returns immediately
+end
+
+
+do   -- producer/consumer over a pipe; writes block on a full pipe
+  local r, w = async.pipe()
+  local N = 200000
+  local big = string.rep("abcdefghi\n", N)
+  local got
+  async.spawn(function ()
+    assert(async.running())
+    assert(w:write(big, "end") == w)
+    w:close()
+  end)
+  async.spawn(function ()
+    local n = 0
+    while true do
+      local l = r:read("l")
+      if not l then break end
+      n = n + 1
+      if n <= N then assert(l == "abcdefghi") else got = l end
+    end
+    assert(n == N + 1)
+    r:close()
+  end)
+  async.run()
+  assert(got == "end")
+  assert(tostring(r) == "async file (closed)")
+end
+
+
+do   -- read formats
+  local a, b = async.socketpair()
+  local res
+  async.spawn(function ()
+    res = table.pack(a:read("L", 3, "l", "a"))
+  end)
+  async.spawn(function ()
+    b:write("line 1\n")
+    async.sleep(0.01)
+    b:write("12")
+    async.sleep(0.01)
+    b:write("345\nrest", " of ", 10, "\n")
+    b:close()
+  end)
+  async.run()
+  assert(res.n == 4 and res[1] == "line 1\n" and res[2] == "12" and
+         res[3] == "345" and res[4] == "rest of 10\n")
+  -- at end of file
+  local t = table.pack(a:read("l", "a"))
+  assert(t.n == 1 and t[1] == nil)
+  assert(a:read("a") == "" and a:read(10) == nil)
+  checkerror("invalid format", a.read, a, "x")
+  a:close()
+  checkerror("closed file", a.read, a)
+end
+
+
+do   -- timers
+  local t = {}
+  local clock = os.clock()
+  for _, d in ipairs{0.03, 0.01, 0.02, 0} do
+    async.spawn(function () async.sleep(d); t[#t + 1] = d end)
+  end
+  async.run()
+  assert(table.concat(t, " ") == "0 0.01 0.02 0.03")
+  -- outside a task, 'sleep' just blocks
+  async.sleep(0.001)
+  checkerror("out of range", async.sleep, 1e10)
+end
+
+
+do   -- many tasks waiting at the same time
+  local pairs_ = {}
+  local total = 0
+  for i = 1, 50 do
+    local a, b = async.socketpair()
+    pairs_[i] = {a, b}
+    async.spawn(function ()   -- echo server
+      local l = a:read("L")
+      a:write(l):close()
+    end)
+    async.spawn(function ()
+      async.sleep(0.001 * (i % 5))
+      b:write("msg ", i, "\n")
+      assert(b:read("l") == "msg " .. i)
+      assert(b:read("a") == "")
+      total = total + i
+      b:close()
+    end)
+  end
+  async.run()
+  assert(total == 50 * 51 // 2)
+end
+
+
+do   -- Unix sockets
+  local path = os.tmpname()
+  os.remove(path)
+  local srv = assert(async.listen(path))
+  assert(math.type(srv:fileno()) == "integer")
+  local log = {}
+  async.spawn(function ()
+    for i = 1, 3 do
+      local c = assert(srv:accept())
+      async.spawn(function ()
+        local l = c:read()
+        c:write(string.upper(l), "\n")
+        c:close()
+      end)
+    end
+    srv:close()
+  end)
+  for i = 1, 3 do
+    async.spawn(function ()
+      local c = assert(async.connect(path))
+      c:write("hello ", i, "\n")
+      log[i] = c:read()
+      c:close()
+    end)
+  end
+  async.run()
+  assert(log[1] == "HELLO 1" and log[2] == "HELLO 2" and log[3] == "HELLO 3")
+  os.remove(path)
+  local c, msg = async.connect(path)    -- no server
+  assert(not c and string.find(msg, path, 1, true))
+  checkerror("not a listening socket", async.socketpair().accept,
+             async.socketpair())
+end
+
+
+do   -- closing a file wakes the tasks waiting for it
+  local a, b = async.socketpair()
+  local msg
+  async.spawn(function () msg = select(2, pcall(a.read, a)) end)
+  async.spawn(function () a:close() end)
+  async.run()
+  assert(string.find(msg, "closed file"))
+  -- writing to a closed socket fails without killing the process
+  local st, err = b:write("x")
+  assert(not st and type(err) == "string")
+  b:close()
+end
+
+
+do   -- two tasks cannot wait for the same event
+  local a, b = async.socketpair()
+  async.spawn(function () a:read() end)
+  async.spawn(function () a:read() end)
+  checkerror("already in use", async.run)
+  b:write("x\n")
+  async.run()   -- first task finishes
+  b:close(); a:close()
+end
+
+
+do   -- errors in tasks propagate through 'run'
+  local closed = false
+  async.spawn(function ()
+    local x <close> = setmetatable({}, {__close = function ()
+                                          closed = true end})
+    async.sleep(0.001)
+    error{"my error"}
+  end)
+  local st, err = pcall(async.run)
+  assert(not st and err[1] == "my error" and closed)
+  assert(select(2, async.running()) == 0)
+  async.spawn(function () async.run() end)
+  checkerror("inside a task", async.run)
+  checkerror("function expected", async.spawn, 10)
+end
+
+
+do   -- blocking operations outside tasks
+  local a, b <close> = async.socketpair()
+  b:write("data\n")
+  assert(a:read() == "data")
+  assert(not async.running())
+  local a1 <close> = a
+end
+
+print "OK"
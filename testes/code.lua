@@ -62,6 +62,7 @@ function check (f, ...)
   local arg = {...}
   local c = T.listcode(f)
   for i=1, #arg do
+    -- (a superinstruction 'A_B' matches its first component 'A')
     local opcode = string.match(c[i], "%u%w+")
     -- print(arg[i], opcode)
     assert(arg[i] == opcode)
@@ -417,5 +418,66 @@ do   -- string constants
   assert(T.listk(f2)[1] == nil)
 end
 
+
+do   -- superinstructions
+  local function ops (f)
+    local t = {}
+    for i, l in ipairs(T.listcode(f)) do
+      t[i] = string.match(l, "%u[%w_]+")
+    end
+    return table.concat(t, " ")
+  end
+
+  local function f (o, x)
+    o.g(x)
+    o:m()
+    o.h()
+    return (string.len(x))
+  end
+  local code = "GETFIELD MOVE_CALL CALL SELF_CALL CALL GETFIELD_CALL CALL \z
+                GETTABUP_GETFIELD GETFIELD MOVE_CALL CALL RETURN1 RETURN0"
+  assert(ops(f) == code)
+
+  local log = {}
+  local o = {g = function (x) log[#log + 1] = x end,
+             m = function (self) log[#log + 1] = self end,
+             h = function () log[#log + 1] = "h" end}
+  assert(f(o, "abc") == 3)
+  assert(log[1] == "abc" and log[2] == o and log[3] == "h")
+
+  -- stripped dumps keep superinstructions
+  for _, strip in ipairs{false, true} do
+    local f1 = load(string.dump(f, strip))
+    assert(ops(f1) == code)
+    assert(string.dump(f1, strip) == string.dump(f, strip))
+    log = {}
+    assert(f1(o, "x") == 1 and log[1] == "x" and log[3] == "h")
+  end
+
+  -- a superinstruction stops at hooks between its components
+  local debug = require"debug"
+  local count = 0
+  debug.sethook(function ()
+    if debug.getinfo(2, "f").func == f then count = count + 1 end
+  end, "", 1)
+  f(o, "x")
+  debug.sethook()
+  assert(count == #T.listcode(f) - 1)   -- all but the last 'RETURN0'
+end
+
+
+-- numeric loops whose body starts indexing with the control variable
+check(function (t)
+  local s = 0
+  for i = 1, #t do s = s + t[i] end
+  return s
+end, 'LOADI', 'LOADI', 'LEN', 'LOADI', 'FORPREP', 'GETTABLE', 'ADD',
+     'MMBIN', 'FORLOOPGET', 'RETURN1', 'RETURN0')
+check(function (t, j) for i = 1, 10 do local x = t[j] end end,
+'LOADI', 'LOADI', 'LOADI', 'FORPREP', 'GETTABLE', 'FORLOOP', 'RETURN0')
+check(function (t) for i = 1, 10 do i = i + 1; local x = t[i] end end,
+'LOADI', 'LOADI', 'LOADI', 'FORPREP', 'ADDI', 'MMBINI', 'GETTABLE',
+'FORLOOP', 'RETURN0')
+
 print 'OK'
 
@@ -860,6 +860,329 @@ assert(run(function ()
 
 
 
+do  print("testing pool of coroutines")
+  local size, stacksize = coroutine.pool()
+  assert(size >= 0 and stacksize > 0)
+
+  -- create garbage coroutines in several states
+  local function garbage (n)
+    for i = 1, n do
+      local co = coroutine.create(function (x)
+        local t = {x}
+        local function f () return t end    -- open upvalue
+        coroutine.yield(f)
+        error("dead")
+      end)
+      if i % 3 > 0 then coroutine.resume(co, i) end   -- suspended
+      if i % 3 == 2 then coroutine.resume(co) end     -- dead with error
+    end
+  end
+
+  coroutine.pool(10)
+  garbage(30)
+  collectgarbage()
+  local _, _, count, reused = coroutine.pool()
+  assert(count == 10)
+
+  -- reused coroutines are fresh ones
+  local keep = {}
+  for i = 1, 20 do
+    local co = coroutine.create(function (...)
+      local a = {...}
+      assert(#a == 2 and a[1] == i)
+      local x = coroutine.yield(select('#', ...))
+      return x, debug.traceback()
+    end)
+    assert(coroutine.status(co) == "suspended")
+    assert(debug.getinfo(co, 0) == nil)
+    local _, n = coroutine.resume(co, i, i)
+    assert(n == 2)
+    keep[i] = co
+  end
+  local _, _, count1, reused1 = coroutine.pool()
+  assert(count1 == 0 and reused1 == reused + 10)
+  for i = 1, 20 do
+    local st, x, tb = coroutine.resume(keep[i], i * 10)
+    assert(st and x == i * 10 and not string.find(tb, "dead"))
+    assert(coroutine.status(keep[i]) == "dead")
+  end
+
+  -- dead coroutines still accessible are not reused
+  collectgarbage()
+  garbage(30)
+  for i = 1, 20 do
+    local co = coroutine.wrap(function () return i end)
+    assert(co() == i)
+  end
+  for i = 1, 20 do assert(coroutine.status(keep[i]) == "dead") end
+  keep = nil
+
+  -- hooks in reused coroutines
+  collectgarbage()
+  local calls = 0
+  debug.sethook(function () calls = calls + 1 end, "c")
+  garbage(20)     -- coroutines inherit the hook
+  debug.sethook()
+  collectgarbage()
+  calls = 0
+  local co = coroutine.create(function () return 1 end)
+  assert(select(2, coroutine.resume(co)) == 1 and calls == 0)
+
+  -- changing the stack size empties the pool
+  garbage(20); collectgarbage()
+  assert(select(3, coroutine.pool()) == 10)
+  local _, ss, count2 = coroutine.pool(nil, 1)   -- minimum stack size
+  assert(ss > 1 and ss < stacksize and count2 == 0)
+  garbage(20); collectgarbage()
+  assert(select(3, coroutine.pool()) == 10)
+  local co = coroutine.wrap(function (n)    -- stack grows as needed
+    local function deep (n) if n == 0 then return 0 end
+                              return 1 + deep(n - 1) end
+    coroutine.yield(deep(n))
+    return select('#', table.unpack({}, 1, 200))
+  end)
+  assert(co(1000) == 1000 and co() == 200)
+
+  -- disabling the pool
+  assert(coroutine.pool(0) == 0 and select(3, coroutine.pool()) == 0)
+  garbage(20); collectgarbage()
+  assert(select(3, coroutine.pool()) == 0)
+  local st, msg = pcall(coroutine.pool, -2)
+  assert(not st and string.find(msg, "out of range"))
+  coroutine.pool(size, stacksize)     -- restore defaults
+end
+
+
+do  print("testing stack statistics and shrinking")
+  local function deep (n)
+    if n == 0 then coroutine.yield(); return 0 end
+    return 1 + deep(n - 1)
+  end
+  local co = coroutine.create(function (n)
+    while true do deep(n); n = coroutine.yield() end
+  end)
+  local t = coroutine.stackinfo(co)
+  assert(t.size >= t.inuse and t.peak == t.size)
+  assert(t.grows == 0 and t.shrinks == 0)
+  local t1 = coroutine.stackinfo()    -- running coroutine
+  assert(t1.inuse > 0 and t1.size >= t1.inuse)
+
+  coroutine.resume(co, 1000)
+  t = coroutine.stackinfo(co)
+  local big = t.size
+  assert(t.grows > 0 and t.peak == big and t.inuse > 1000)
+
+  -- now shallow: stack shrinks only after some collections
+  coroutine.resume(co); coroutine.resume(co, 1)
+  local old = collectgarbage("stackshrink", 3)
+  assert(old > 0 and collectgarbage("stackshrink") == 3)
+  collectgarbage(); collectgarbage()
+  assert(coroutine.stackinfo(co).size == big)
+  collectgarbage()
+  t = coroutine.stackinfo(co)
+  assert(t.size < big and t.shrinks == 1 and t.peak == big)
+  assert(t.size >= t.inuse)
+
+  -- growing again restarts the count
+  collectgarbage(); collectgarbage()
+  coroutine.resume(co); coroutine.resume(co, 1000)   -- grows again
+  big = coroutine.stackinfo(co).size
+  coroutine.resume(co); coroutine.resume(co, 1)
+  collectgarbage(); collectgarbage()
+  t = coroutine.stackinfo(co)
+  assert(t.size == big and t.shrinks == 1)
+
+  -- immediate shrinking
+  collectgarbage("stackshrink", 1)
+  collectgarbage()
+  t = coroutine.stackinfo(co)
+  assert(t.size < big and t.shrinks == 2)
+  collectgarbage("stackshrink", old)
+  assert(not pcall(coroutine.stackinfo, 10))
+end
+
+
+do  print("testing instruction budgets")
+  local function count (co, ...)   -- resumes 'co' until it ends
+    local n = 0
+    local res
+    repeat
+      res = table.pack(coroutine.resume(co, ...))
+      assert(res[1])
+      n = n + 1
+    until coroutine.status(co) == "dead"
+    return n, table.unpack(res, 2, res.n)
+  end
+
+  assert(coroutine.getbudget() == nil)
+  -- one unit for the call plus one for each backward jump
+  local co = coroutine.create(function (n)
+    local s = 0
+    for i = 1, n do s = s + i end
+    return s
+  end)
+  coroutine.setbudget(co, 100)
+  local n, a, b = coroutine.getbudget(co)
+  assert(n == 100 and a == "yield" and b == nil)
+  n, a = count(co, 1000)
+  assert(n == 11 and a == 500500)
+  assert(coroutine.getbudget(co) == 100)
+
+  -- all kinds of loops and calls are charged
+  local function body (n)
+    local i = 0
+    while i < n do i = i + 1 end
+    repeat i = i - 1 until i == 0
+    for _ in pairs{1, 2, 3} do i = i + 1 end
+    ::L:: i = i + 1; if i < n then goto L end
+    local function fib (x) if x < 2 then return x else
+                             return fib(x - 1) + fib(x - 2) end end
+    return fib(15)
+  end
+  co = coroutine.create(body)
+  coroutine.setbudget(co, 10)
+  n, a = count(co, 20)
+  assert(n > 10 and a == 610)
+  co = coroutine.create(function (...) return body(...) end)
+  coroutine.setbudget(co, 1)   -- yields at every charge
+  assert(select(2, count(co, 20)) == 610)
+
+  -- vararg functions keep their arguments through yields
+  co = coroutine.create(function ()
+    local function f (...) return select('#', ...), ... end
+    local t = {}
+    for i = 1, 5 do
+      local n, a, b, c = f(1, i, nil)
+      assert(n == 3 and a == 1 and c == nil)
+      t[i] = b
+    end
+    return table.concat(t)
+  end)
+  coroutine.setbudget(co, 1)
+  n, a = count(co, 10, 20)   -- (values given to resume are ignored)
+  assert(n == 11 and a == "12345")
+
+  -- round-robin scheduling of tasks that never yield
+  local log = {}
+  local tasks = {}
+  for i = 1, 3 do
+    tasks[i] = coroutine.create(function ()
+      for j = 1, 3000 do
+        if j % 1000 == 0 then log[#log + 1] = i end
+      end
+    end)
+    coroutine.setbudget(tasks[i], 1000)
+  end
+  while #tasks > 0 do
+    for i = #tasks, 1, -1 do
+      assert(coroutine.resume(tasks[i]))
+      if coroutine.status(tasks[i]) == "dead" then
+        table.remove(tasks, i)
+      end
+    end
+  end
+  assert(table.concat(log) == "321321321")
+
+  -- coroutines created by a coroutine inherit only an error budget
+  co = coroutine.create(function ()
+    local co1 = coroutine.create(function () end)
+    return coroutine.getbudget(co1)
+  end)
+  coroutine.setbudget(co, 1000, "error")
+  local _, n1, m1 = coroutine.resume(co)
+  assert(n1 == 1000 and m1 == "error")
+  co = coroutine.create(function ()
+    local co1 = coroutine.create(function () end)
+    return coroutine.getbudget(co1)
+  end)
+  coroutine.setbudget(co, 1000)
+  assert(select(2, count(co)) == nil)
+
+  -- budget yields of the task do not disturb its iterators
+  co = coroutine.create(function ()
+    local n = 0
+    for i in coroutine.wrap(function ()
+               for i = 1, 10000 do coroutine.yield(i) end
+             end) do
+      n = n + 1
+      assert(i == n)
+    end
+    return n
+  end)
+  coroutine.setbudget(co, 1000)
+  n, a = count(co)
+  assert(n > 1 and a == 10000)
+
+  -- cannot yield across C calls: it just goes on
+  co = coroutine.create(function ()
+    local t = {5, 4, 3, 2, 1}
+    table.sort(t, function (x, y)
+      for _ = 1, 10 do end
+      return x < y
+    end)
+    return table.concat(t)
+  end)
+  coroutine.setbudget(co, 5)
+  n, a = count(co)
+  assert(n == 1 and a == "12345")
+
+  -- error mode: the error repeats until the budget is reset
+  co = coroutine.create(function ()
+    while not pcall(function () while true do end end) do end
+  end)
+  coroutine.setbudget(co, 1000, "error")
+  local st, msg = coroutine.resume(co)
+  assert(not st and string.find(msg, "budget exhausted"))
+  assert(coroutine.getbudget(co) == 0)
+
+  -- error mode: message handlers and '__close' still run
+  co = coroutine.create(function ()
+    local closed = false
+    local st, msg = xpcall(function ()
+      local x <close> = setmetatable({}, {__close = function ()
+        for _ = 1, 10 do end
+        closed = true
+      end})
+      while true do end
+    end, function (m)
+      for _ = 1, 10 do end
+      return "handled: " .. m
+    end)
+    return closed, st, msg
+  end)
+  coroutine.setbudget(co, 1000, "error")
+  local _, closed, st1, msg1 = coroutine.resume(co)
+  assert(closed and not st1 and
+         string.find(msg1, "^handled: .*budget exhausted"))
+  -- but only once: the grace allowance is not renewed
+  co = coroutine.create(function ()
+    while true do pcall(function () while true do end end) end
+  end)
+  coroutine.setbudget(co, 1000, "error")
+  st, msg = coroutine.resume(co)
+  assert(not st and string.find(msg, "budget exhausted"))
+
+  st, msg = pcall(function ()
+    coroutine.setbudget(10000, "error")   -- the main thread
+    local i = 0
+    while true do i = i + 1 end
+  end)
+  coroutine.setbudget(nil)
+  assert(not st and string.find(msg, "budget exhausted"))
+  assert(coroutine.getbudget() == nil)
+
+  -- yield mode in the main thread (not yieldable) does nothing
+  coroutine.setbudget(1, "yield")
+  for i = 1, 10 do end
+  coroutine.setbudget(nil)
+
+  st, msg = pcall(coroutine.setbudget, co, 0)
+  assert(not st and string.find(msg, "out of range"))
+  st, msg = pcall(coroutine.setbudget, co, 10, "stop")
+  assert(not st and string.find(msg, "invalid option"))
+end
+
+
 -- tests for coroutine API
 if T==nil then
   (Message or print)('\n >>> testC not active: skipping coroutine API tests <<<\n')
@@ -868,6 +1191,22 @@ end
 
 print('testing coroutine API')
 
+do   -- CallInfo entries are allocated in chunks of growing sizes
+  local function nci () return select(4, T.stacklevel()) end
+  local function valid (n)   -- 4, 4 + 8, 4 + 8 + 16, then 32 more each
+    return n == 4 or n == 12 or n == 28 or (n >= 60 and (n - 60) % 32 == 0)
+  end
+  local function deep (n)
+    if n == 0 then return nci() end
+    return 0 + deep(n - 1)
+  end
+  for _, n in ipairs{0, 1, 5, 10, 30, 100, 300} do
+    local co = coroutine.wrap(deep)
+    local c = co(n)
+    assert(valid(c) and c >= n)
+  end
+end
+
 local function apico (...)
   local x = {...}
   return coroutine.wrap(function ()
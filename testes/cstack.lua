@@ -101,6 +101,8 @@ end
 
 if T then
   print("testing stack recovery")
+  -- (a finalizer running with the stack at its limit would overflow it)
+  collectgarbage("stop")
   local N = 0      -- trace number of calls
   local LIM = -1   -- will store N just before stack overflow
 
@@ -143,6 +145,7 @@ if T then
   LIM = N      -- will stop recursion at maximum level
   N = 0        -- to count again
   f()
+  collectgarbage("restart")
   print"+"
 end
 
@@ -836,6 +836,34 @@ do   -- testing for-iterator name
 end
 
 
+do   -- debug information in code with superinstructions
+  local function f (o, x)
+    o.g(x)
+    o:m()
+    o.h()
+    return (string.len(x))
+  end
+  local function err (msg, ...)
+    local st, m = pcall(f, ...)
+    assert(not st and string.find(m, msg, 1, true))
+  end
+  err("field 'g'", {}, 1)
+  err("method 'm'", {g = type}, 1)
+  err("field 'h'", {g = type, m = type}, 1)
+  err("index a nil value (local 'o')", nil)
+  local o = {g = type, m = type, h = os.clock}
+  local lines = {}
+  debug.sethook(function (_, l)
+    if debug.getinfo(2, "f").func == f then lines[#lines + 1] = l end
+  end, "l")
+  f(o, "x")
+  debug.sethook()
+  local line = debug.getinfo(f, "S").linedefined
+  assert(table.concat(lines, " ") ==
+         string.format("%d %d %d %d", line + 1, line + 2, line + 3, line + 4))
+end
+
+
 do   -- testing debug info for finalizers
   local name = nil
 
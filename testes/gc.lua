@@ -625,9 +625,79 @@ if T then
   t = T.totalmem("function")
   a = function () end   -- create 1 new closure
   assert(T.totalmem("function") == t + 1)
+  local psize = coroutine.pool(0)   -- pooled threads are not new objects
   t = T.totalmem("thread")
   a = coroutine.create(function () end)   -- create 1 new coroutine
   assert(T.totalmem("thread") == t + 1)
+  coroutine.pool(psize)
+end
+
+
+print("parallel marking")
+do
+  -- (actual parallelism only for big heaps or with internal tests)
+  local oldn = collectgarbage("parallel", 4)
+  if oldn == 0 then
+    print("  (no support for parallel marking)")
+  else
+    assert(collectgarbage("parallel", 0) == 4)   -- 0 keeps current value
+    local a = {}
+    local wk = setmetatable({}, {__mode = "k"})
+    local wv = setmetatable({}, {__mode = "v"})
+    for i = 1, 2000 do
+      local x = {i, tostring(i), function () return i end}
+      a[i] = x
+      if i % 10 == 0 then
+        wk[x] = coroutine.wrap(function () return i end)
+        wv[i] = {}
+      end
+    end
+    collectgarbage()
+    for i = 1, 2000 do
+      assert(a[i][1] == i and a[i][2] == tostring(i) and a[i][3]() == i)
+    end
+    assert(next(wv) == nil)
+    local n = 0
+    for k, f in pairs(wk) do n = n + 1; assert(f() == k[1]) end
+    assert(n == 200)
+    a = nil
+    collectgarbage()
+    assert(next(wk) == nil)
+    collectgarbage("parallel", oldn)
+  end
+end
+
+
+print("deferred finalizers")
+do
+  assert(collectgarbage("deferfinalizers", true) == false)
+  local n = 0
+  local mt = {__gc = function (o) n = n + o[1] end}
+  for i = 1, 10 do setmetatable({1}, mt) end
+  local _, count = collectgarbage("finalizers")
+  collectgarbage()
+  local pending = collectgarbage("finalizers")
+  assert(n == 0 and pending >= 10)
+  -- run a few, from a coroutine
+  local co = coroutine.wrap(function (k)
+    return collectgarbage("runfinalizers", k)
+  end)
+  assert(co(3) == 3 and n <= 3)
+  assert(collectgarbage("finalizers") == pending - 3)
+  -- run all remaining ones
+  assert(collectgarbage("runfinalizers") == pending - 3 and n == 10)
+  local left, newcount, total, max = collectgarbage("finalizers")
+  assert(left == 0 and newcount == count + pending)
+  assert(total >= max and max >= 0)
+  if T then   -- errors in finalizers still generate warnings
+    warn("@on"); warn("@store")
+    setmetatable({}, {__gc = function () error("@expected@") end})
+    collectgarbage()
+    assert(collectgarbage("runfinalizers") >= 1)
+    assert(string.find(_WARN, "error in __gc metamethod")); _WARN = false
+    warn("@normal")
+  end
+  assert(collectgarbage("deferfinalizers", false) == true)
 end
 
 
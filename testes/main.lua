@@ -257,6 +257,26 @@ RUN('lua -W %s 2> %s', prog, out)
 checkprogout("ZYX)\nXYZ)\n")
 
 
+-- test option '-X'
+prepfile[[
+local function f (n) local s = 0; for i = 1, n do s = s + i end; return s end
+assert(f(1000) == 500500)
+]]
+RUN('lua -X %s 2> %s', prog, out)
+do
+  local t = getoutput()
+  if vmstats.enabled then
+    assert(string.find(t, "^instructions executed: %d+\n") and
+           string.find(t, "%s1000 .*%] FORLOOP\n"))
+  else
+    assert(string.find(t, "not available"))
+  end
+  -- statistics are printed even after errors
+  NoRun(vmstats.enabled and "instructions executed" or "not available",
+        'lua -X -e "error(0)"')
+end
+
+
 -- test many arguments
 prepfile[[print(({...})[30])]]
 RUN('lua %s %s > %s', prog, string.rep(" a", 30), out)
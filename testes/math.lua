@@ -371,6 +371,32 @@ do
 end
 
 
+if floatbits == 53 and not _port then
+  -- conversions between floats and strings (with default format)
+  assert(tostring(0.1) == "0.1" and tostring(-1/3) == "-0.33333333333333")
+  assert(tostring(1e15) == "1e+15" and tostring(1e14) == "1e+14")
+  assert(tostring(123456789012345.0) == "1.2345678901234e+14")
+  assert(tostring(99999999999999.5) == "1e+14")
+  assert(tostring(0.0001) == "0.0001" and tostring(0.00001) == "1e-05")
+  assert(tostring(1e-100) == "1e-100" and tostring(-1e200) == "-1e+200")
+  assert(tostring(2^-1074) == "4.9406564584125e-324")
+  assert(tostring(-0.0) == "-0.0" and tostring(2^53) == "9.007199254741e+15")
+  assert(tostring(1234.5) == "1234.5" and tostring(100.0) == "100.0")
+  assert(tonumber("1.7976931348623157e308") == 0x1.fffffffffffffp1023)
+  assert(tonumber("2.2250738585072014e-308") == 2^-1022)
+  assert(tonumber("  123456789.987654321  ") == 123456789.987654321)
+  assert(tonumber("9007199254740993") == (1 << 53) + 1)   -- an integer
+  assert(tonumber("9007199254740993.0") == 2^53)   -- ties to even
+  assert(eqT(tonumber("-0.0"), -0.0) and 1/tonumber("-0e10") < 0)
+  for i = 1, 1000 do
+    local x = math.random() * 10.0^math.random(-40, 40)
+    assert(tonumber(string.format("%.17g", x)) == x)
+    local s = string.format("%.14g", x)
+    assert(tostring(x) == s or tostring(x) == s .. ".0")
+  end
+end
+
+
 -- testing 'tonumber'
 
 -- 'tonumber' with numbers
@@ -1019,5 +1045,55 @@ assert(not pcall(random, maxint, maxint - 1))
 assert(not pcall(random, maxint, minint))
 
 
+do   print("testing fast C functions")
+  -- 'pcall' does regular calls; direct calls from Lua may use fast ones
+  local function same (a, b) return eqT(a, b) or (a ~= a and b ~= b) end
+  local function check (f, ...)
+    local ok, res = pcall(function (...) return table.pack(f(...)) end, ...)
+    local res1 = table.pack(pcall(f, ...))
+    assert(ok == res1[1])
+    if not ok then return end
+    assert(res.n == res1.n - 1)
+    for i = 1, res.n do assert(same(res[i], res1[i + 1])) end
+    ok, res = pcall(function (...)
+      local r1, r2 = f(...)     -- adjust to two results
+      assert(r2 == nil)
+      return r1
+    end, ...)
+    assert(ok and same(res, res1[2]))
+  end
+  local values = {0, -0.0, 1, -1, 0.5, -3.7, 2^53, -2^63, 2^63, 1e300,
+                  1/0, -1/0, 0/0, maxint, minint, 3, "10", "2.5"}
+  for _, name in ipairs{"abs", "acos", "asin", "atan", "ceil", "cos", "deg",
+                        "exp", "floor", "log", "rad", "sin", "sqrt", "tan",
+                        "tointeger", "type"} do
+    local f = math[name]
+    for _, x in ipairs(values) do check(f, x) end
+  end
+  for _, name in ipairs{"fmod", "max", "min", "atan", "log"} do
+    local f = math[name]
+    for _, x in ipairs(values) do
+      for _, y in ipairs(values) do
+        if not (name == "fmod" and math.type(x) == "integer" and y == 0) then
+          check(f, x, y)
+        end
+      end
+    end
+  end
+  assert(eqT(math.floor(-0.5), -1) and eqT(math.floor(2^70), 2^70))
+  assert(eqT(math.max(1, 2.0), 2.0) and eqT(math.max(2, 1.0), 2))
+  assert(eqT(math.min(-0.0, 0.0), -0.0) and eqT(1/math.max(-0.0, 0.0), -1/0))
+  assert(not pcall(math.sin) and not pcall(math.floor, {}))
+  checkerror("number expected", math.floor, "x")
+
+  -- with hooks, fast functions are called as regular ones
+  local debug = require"debug"
+  local calls = 0
+  debug.sethook(function () calls = calls + 1 end, "c")
+  local x = math.sqrt(4) + math.floor(2.5)
+  debug.sethook()
+  assert(x == 4 and calls >= 2)
+end
+
 
 print('OK')
@@ -57,8 +57,21 @@ local function mp2 (n)   -- minimum power of 2 >= n
 end
 
 
+-- hash parts with control bytes (LUA_USE_SWISSTABLE) are kept at most
+-- 7/8 full, so they can be twice as large as chained ones and they
+-- are rehashed at other moments
+local swiss = (function ()
+  local t = {}
+  for i = 1, 8 do t["x" .. i] = i end
+  return select(2, T.querytab(t)) == 16
+end)()
+
 local function check (t, na, nh)
   local a, h = T.querytab(t)
+  if swiss then
+    assert(a <= na and h <= 2 * (na + nh))
+    return
+  end
   if a ~= na or h ~= nh then
     print(na, nh, a, h)
     assert(nil)
@@ -152,6 +165,18 @@ do
   check(a, 0, 4)   -- only 2 elements ([15] and [16])
 end
 
+-- presizing and clearing
+a = table.new(100, 10)
+check(a, 100, 16)
+for i = 1, 100 do a[i] = i end
+for i = 1, 10 do a["x" .. i] = i end
+check(a, 100, 16)
+table.clear(a)
+check(a, 100, 16)
+assert(next(a) == nil and #a == 0)
+for i = 1, 10 do a["y" .. i] = i end   -- reuse cleared nodes
+check(a, 100, 16)
+
 -- reverse filling
 for i=1,lim do
   local a = {}
@@ -176,8 +201,8 @@ for i=1,lim do a[i] = true; foo(i, table.unpack(a)) end
 
 -- Table length with limit smaller than maximum value at array
 local a = {}
-for i = 1,64 do a[i] = true end    -- make its array size 64
-for i = 1,64 do a[i] = nil end     -- erase all elements
+for i = 1,64 do a[#a + 1] = true end    -- make its array size 64
+for i = 1,64 do a[i] = nil end     -- erase all elements (and old border)
 assert(T.querytab(a) == 64)    -- array part has 64 elements
 a[32] = true; a[48] = true;    -- binary search will find these ones
 a[51] = true                   -- binary search will miss this one
@@ -185,7 +210,9 @@ assert(#a == 48)               -- this will set the limit
 assert(select(4, T.querytab(a)) == 48)  -- this is the limit now
 a[50] = true                   -- this will set a new limit
 assert(select(4, T.querytab(a)) == 50)  -- this is the limit now
--- but the size is larger (and still inside the array part)
+assert(#a == 48)               -- old border is still valid
+a[49] = true                   -- but not anymore
+-- new border is beyond the limit (and still inside the array part)
 assert(#a == 51)
 
 end  --]
@@ -198,6 +225,29 @@ assert(#{nil, nil} == 0)
 assert(#{nil, nil, nil} == 0)
 assert(#{nil, nil, nil, nil} == 0)
 assert(#{1, 2, 3, nil, nil} == 3)
+
+-- length after the list changes around a previous border
+do
+  local function isborder (t, n)
+    return (n == 0 or t[n] ~= nil) and t[n + 1] == nil
+  end
+  for _, size in ipairs{0, 5, 8, 100} do
+    local a = table.new(size, 0)
+    for i = 1, 150 do a[#a + 1] = i; assert(#a == i) end
+    for i = 150, 1, -1 do assert(#a == i); a[#a] = nil end
+    assert(#a == 0)
+    for i = 1, 20 do a[i] = i end
+    assert(#a == 20)
+    a[10] = nil; assert(isborder(a, #a))   -- hole before the border
+    a[20] = nil; a[19] = nil; assert(isborder(a, #a))
+    a[10] = 10; a[19] = 19; a[20] = 20; a[21] = 21
+    assert(#a == 21)
+    a[22] = 22; a[23] = 23; assert(#a == 23)   -- jump over one append
+    for i = 1, 23 do a[i] = nil end
+    assert(#a == 0)
+    a[1] = 1; assert(#a == 1)
+  end
+end
 print'+'
 
 
@@ -391,6 +441,39 @@ do
 end
 
 
+do   -- interleaved traversals
+  local a, b = {}, {}
+  for i = 1, 100 do a["x" .. i] = i; b[i + 0.5] = i end
+  local ka, kb = next(a), next(b)
+  local n = 0
+  while ka do
+    n = n + 1
+    assert(a[ka] and b[kb])
+    local k = next(b, n % 100 + 1.5)   -- out of order
+    assert(k == nil or b[k])
+    local oldka = ka
+    ka, kb = next(a, ka), next(b, kb)
+    a[oldka] = nil   -- clearing fields during traversal
+  end
+  assert(n == 100 and kb == nil and next(a) == nil)
+end
+
+
+do   -- dead key x new key reusing its address
+  local t = {}
+  for i = 1, 100 do t[i * 1.5] = i end
+  for round = 1, 50 do
+    local k = {}
+    t[k] = true; t[k] = nil; k = nil
+    collectgarbage()   -- key becomes dead and is freed
+    t[{}] = true   -- new key may get the same address
+    local n = 0
+    for _ in pairs(t) do n = n + 1; assert(n <= 100 + round) end
+    assert(n == 100 + round)
+  end
+end
+
+
 local function test (a)
   assert(not pcall(table.insert, a, 2, 20));
   table.insert(a, 10); table.insert(a, 2, 20);
@@ -686,6 +769,84 @@ do   -- testing other strange cases for numeric 'for'
 end
 
 
+do   -- numeric loops whose body starts indexing with the control variable
+  local function sum (t, a, b, step)
+    local s = 0
+    for i = a, b, step or 1 do s = s + (t[i] or 0) end
+    return s
+  end
+  local t = {}
+  for i = 1, 100 do t[i] = i end
+  assert(sum(t, 1, 100) == 5050 and sum(t, 100, 1, -1) == 5050)
+  assert(sum(t, 1.0, 100) == 5050.0)    -- float loop
+  assert(sum(t, 2, 100, 2) == 2550 and sum(t, 0, 101) == 5050)
+  t[200] = 200    -- in the hash part
+  assert(sum(t, 1, 300) == 5250)
+  -- holes and non-tables go through metamethods
+  setmetatable(t, {__index = function (_, k) return -k end})
+  t[50] = nil
+  assert(sum(t, 1, 100) == 5050 - 100)
+  assert(sum(setmetatable({}, {__index = t}), 1, 100) == 5050 - 100)
+  assert(sum("abc", 1, 3) == 0)    -- string.1, string.2, ... are nil
+  checkerror("local 't'", sum, nil, 1, 2)
+  checkerror("local 't'", sum, 10, 1, 2)
+
+  -- the table changes shape during the loop
+  t = {1, 2, 3}
+  local s = 0
+  for i = 1, 9 do
+    local v = t[i]
+    s = s + v
+    t[#t + 1] = v    -- array grows
+  end
+  assert(s == 18 and #t == 12)
+  s = 0
+  for i = 1, 4 do
+    local v = t[i] or 100
+    s = s + v
+    for j = 1, #t do t[j] = nil end    -- array becomes empty
+    t = (i == 2) and {10, 20, 30, 40} or t    -- other table
+  end
+  assert(s == 1 + 100 + 30 + 100)
+
+  -- changing the control variable does not change the next index
+  local seen = {}
+  t = {10, 20, 30}
+  for i = 1, 3 do
+    local v = t[i]
+    seen[#seen + 1] = v
+    i = 10
+  end
+  assert(seen[1] == 10 and seen[2] == 20 and seen[3] == 30)
+
+  -- hooks see every instruction
+  local debug = require"debug"
+  local function f (t)
+    local s = 0
+    for i = 1, #t do
+      s = s + t[i]
+    end
+    return s
+  end
+  t = {1, 2, 3, 4, 5}
+  local count = 0
+  debug.sethook(function () count = count + 1 end, "", 1)
+  assert(f(t) == 15)
+  debug.sethook()
+  assert(count > 5 * 4)   -- GETTABLE, ADD, FORLOOPGET + calls
+  local lines = {}
+  debug.sethook(function (_, l) lines[#lines + 1] = l end, "l")
+  f(t)
+  debug.sethook()
+  local line = debug.getinfo(f, "S").linedefined
+  local body = 0
+  for _, l in ipairs(lines) do
+    if l == line + 3 then body = body + 1 end
+  end
+  assert(body == 5)
+end
+
+
 checkerror("'for' step is zero", function ()
   for i = 1, 10, 0 do end
 end)
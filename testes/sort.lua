@@ -88,6 +88,86 @@ a = table.pack(nil, nil, nil, nil)
 assert(a[1] == nil and a.n == 4)
 
 
+print "testing new and clear"
+
+do
+  local a = table.new(10, 5)
+  assert(next(a) == nil and #a == 0)
+  for i = 1, 10 do a[i] = i end
+  a.x = 1; a.y = 2
+  assert(#a == 10)
+  setmetatable(a, {__index = function () return "mt" end})
+  table.clear(a)
+  assert(next(a) == nil and rawlen(a) == 0 and a.x == "mt")
+  for i = 1, 20 do a[i] = i end
+  assert(#a == 20 and rawget(a, "x") == nil)
+  table.clear(a); table.clear(a)
+  assert(next(a) == nil)
+  a = table.new()
+  assert(next(a) == nil)
+  checkerror("out of range", table.new, -1)
+  checkerror("out of range", table.new, 1, -1)
+  checkerror("table expected", table.clear, 10)
+end
+
+
+print "testing freeze"
+
+do
+  local t = {10, 20, x = {y = {}}, [{}] = 1}
+  assert(not table.isfrozen(t))
+  assert(table.freeze(t) == t and table.isfrozen(t))
+  assert(not table.isfrozen(t.x))
+  t.x.z = 1    -- inner tables are not frozen
+  checkerror("frozen table", function () t[1] = 1 end)
+  checkerror("frozen table", function () t[3] = 1 end)
+  checkerror("frozen table", function () t.x = 1 end)
+  checkerror("frozen table", function () t.w = 1 end)
+  checkerror("frozen table", rawset, t, 1, 1)
+  checkerror("frozen table", table.insert, t, 1)
+  checkerror("frozen table", table.remove, t)
+  checkerror("frozen table", table.sort, t, function (a, b) return a > b end)
+  checkerror("frozen table", table.clear, t)
+  checkerror("frozen table", setmetatable, t, {})
+  assert(t[1] == 10 and t[2] == 20 and #t == 2 and t.x.z == 1)
+  local n = 0
+  for k, v in pairs(t) do n = n + 1 end
+  assert(n == 4)
+
+  -- deep freeze, with cycles
+  local a = {b = {}}
+  a.b.a = a
+  a.b[a.b] = {{}}
+  setmetatable(a, {__index = {}})
+  table.freeze(a, true)
+  assert(table.isfrozen(a) and table.isfrozen(a.b))
+  assert(table.isfrozen(a.b[a.b]) and table.isfrozen(a.b[a.b][1]))
+  assert(not table.isfrozen(getmetatable(a)))
+  checkerror("frozen table", function () a.b[a.b][1].x = 1 end)
+
+  -- '__newindex' is not called for frozen tables
+  local u = setmetatable({}, {__newindex = function () error"no" end})
+  table.freeze(u)
+  checkerror("frozen table", function () u.x = 1 end)
+  -- frozen table in a '__newindex' chain
+  local v = setmetatable({}, {__newindex = u})
+  checkerror("frozen table", function () v.x = 1 end)
+  v = setmetatable({}, {__newindex = t})
+  checkerror("frozen table", function () v[1] = 1 end)
+
+  -- length of frozen tables (which does not change their size hints)
+  for _, n in ipairs{0, 1, 2, 7, 64, 100} do
+    local t = {}
+    for i = 1, 128 do t[i] = true end
+    for i = n + 1, 128 do t[i] = nil end
+    table.freeze(t)
+    local lim = T and select(4, T.querytab(t))
+    assert(#t == n and #t == n)
+    assert(not T or select(4, T.querytab(t)) == lim)
+  end
+end
+
+
 -- testing move
 do
 
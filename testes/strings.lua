@@ -83,6 +83,19 @@ assert(string.byte("\0\0alo\0x", -1) == string.byte('x'))
 assert(string.byte("ba", 2) == 97)
 assert(string.byte("\n\n", 2, -1) == 10)
 assert(string.byte("\n\n", 2, 2) == 10)
+do    -- string.byte with one position (may use a fast call)
+  local s = "abc"
+  for i = -5, 5 do
+    local b = table.pack(string.byte(s, i))
+    local b1 = table.pack(select(2, pcall(string.byte, s, i)))
+    assert(b.n == b1.n and b[1] == b1[1])
+    assert(b.n == (i ~= 0 and -3 <= i and i <= 3 and 1 or 0))
+  end
+  assert(string.byte("", 1) == nil and s:byte(-1) == 99)
+  assert(string.byte(s, 2.0) == 98 and string.byte(s, "3") == 99)
+  assert(string.byte(12, 2) == 50 and string.len(123) == 3)
+  assert(string.len(s) == 3 and s:len() == 3)
+end
 assert(string.byte("") == nil)
 assert(string.byte("hi", -3) == nil)
 assert(string.byte("hi", 3) == nil)
@@ -429,6 +442,102 @@ do
 end
 
 
+do  print("testing compiled formats")
+  -- formats are compiled once and kept in a cache
+  for i = 1, 200 do
+    local f = string.rep("%d", i % 7) .. "<" .. i .. "%%>%s"
+    local args = {}
+    for j = 1, i % 7 do args[j] = -j end
+    args[#args + 1] = i
+    local r = ""
+    for j = 1, i % 7 do r = r .. -j end
+    for _ = 1, 2 do
+      assert(string.format(f, table.unpack(args)) == r .. "<" .. i .. "%>" .. i)
+    end
+  end
+  assert(string.format("%d|%i", math.mininteger, math.maxinteger) ==
+         math.mininteger .. "|" .. math.maxinteger)
+  assert(string.format("%d%d%d", 0, -0, 10) == "0010")
+  assert(string.format("a\0b%d\0", 1) == "a\0b1\0")
+  -- errors are raised in the order of the format
+  for _ = 1, 2 do
+    checkerror("no value", string.format, "%d %y", 1)
+    checkerror("invalid conversion '%%y'", string.format, "%d %y", 1, 2)
+    checkerror("too long", string.format, "%d %100d", 1, 2)
+    checkerror("number expected", string.format, "%d %100d", "x")
+    checkerror("invalid conversion '%%' to", string.format, "abc%", 1)
+    checkerror("cannot have modifiers", string.format, "%10q", 1)
+  end
+end
+
+
+do  print("testing string buffers")
+  local b = string.buffer()
+  assert(#b == 0 and tostring(b) == "" and b:tostring() == "")
+  assert(b:append("abc", 12, 1.5, -0.0) == b)
+  assert(tostring(b) == "abc121.5-0.0" and #b == 12)
+  b:reset()
+  assert(#b == 0 and tostring(b) == "")
+  b:format("%d-%s-%5.1f|", 10, "x", 3.14159):rep("ab", 3, ","):rep("x", 0)
+  b:concat({1, "2", 3}, "+"):concat({}):concat({"a", "b", "c"}, "", 2)
+  assert(tostring(b) == "10-x-  3.1|ab,ab,ab1+2+3bc")
+  -- appending buffers (including itself)
+  b:reset():append("xy"):append(b, b)
+  assert(tostring(b) == "xyxyxyxy")
+  local c = string.buffer(100):append(b, "!")
+  assert(tostring(c) == "xyxyxyxy!")
+  -- errors do not change the buffer
+  checkerror("no value", b.format, b, "%d %d", 1)
+  checkerror("string expected", b.append, b, "a", {})
+  checkerror("invalid value %(table%) at index 2", b.concat, b, {1, {}, 3})
+  assert(tostring(b) == "xyxyxyxy")
+  checkerror("out of range", string.buffer, -1)
+  -- the buffer can be used while a piece is being formatted
+  local z = "xyxyxyxy" .. string.rep("z", 1000)
+  local t = setmetatable({}, {__tostring = function ()
+    b:append(string.rep("z", 1000)); return "<" .. tostring(b) .. ">" end})
+  b:format("[%s]", t)
+  assert(tostring(b) == z .. "[<" .. z .. ">]")
+  -- long contents
+  b:reset()
+  for i = 1, 1000 do b:append(i, ","):format("%s;", i) end
+  local t = {}
+  for i = 1, 1000 do t[#t + 1] = i .. "," .. i .. ";" end
+  assert(tostring(b) == table.concat(t))
+  do local d <close> = string.buffer(); d:append("a") end
+  -- writing a buffer to a file
+  local f = io.tmpfile()
+  assert(f:write(c, "-", b:reset():rep("ab", 3)) == f)
+  f:seek("set")
+  assert(f:read("a") == "xyxyxyxy!-ababab")
+  f:close()
+end
+
+
+if T then
+  print"testing string hashes"
+  -- low bits (used to index tables) must be well distributed even
+  -- when keys differ only in a few bytes, wherever they are
+  local function spread (f)
+    local n, nb = 4096, 256
+    local b = {}
+    for i = 1, n do
+      local h = T.hash(f(i)) % nb
+      b[h] = (b[h] or 0) + 1
+    end
+    for _, c in pairs(b) do assert(c < 3 * n // nb) end
+  end
+  spread(function (i) return tostring(i) end)
+  spread(function (i) return "key_" .. i end)
+  spread(function (i) return "x" .. i .. "y" end)
+  spread(function (i) return "some/long/path/name" .. i .. ".lua" end)
+  spread(function (i) return string.pack("<i4", i) end)
+  spread(function (i) return string.pack(">i8", i) end)
+  -- equal strings built in different ways have equal hashes
+  assert(T.hash("abcdefghijklmnop") == T.hash("abcdefgh" .. ("ijklmnop")))
+end
+
+
 if T==nil then
   (Message or print)
      ("\n >>> testC not active: skipping 'pushfstring' tests <<<\n")
@@ -318,5 +318,53 @@ do    -- testing initial position
  
 end
 
+print("testing packers")
+do
+  -- packers must behave exactly like 'pack'/'unpack' with their formats
+  local function check (fmt, ...)
+    local p = string.packer(fmt)
+    local s = pack(fmt, ...)
+    assert(p:pack(...) == s)
+    for _, pos in ipairs{1, 9} do
+      local d = string.rep("\0", pos - 1) .. s .. "xyz"
+      local r1 = table.pack(unpack(fmt, d, pos))
+      local r2 = table.pack(p:unpack(d, pos))
+      local t = {}
+      assert(p:unpackinto(t, d, pos) == r1[r1.n])
+      assert(r1.n == r2.n and #t == r1.n - 1)
+      for i = 1, r1.n do
+        assert(r1[i] == r2[i] and math.type(r1[i]) == math.type(r2[i]))
+      end
+      for i = 1, r1.n - 1 do assert(t[i] == r1[i]) end
+    end
+    if not fmt:find("[sz]") then
+      assert(p:size() == packsize(fmt))
+    end
+  end
+  check("<i4I2d", -5, 1000, 0.25)
+  check(">i4 I2 d", -5, 1000, 0.25)
+  check("<I8 i8 >I8 i8 =f n", 1, -2, 3, -4, 0.5, 1/3)
+  check("b B h H i3 I3 i16 j J", -1, 255, -2, 65535, -3, 7, -4, 5, 6)
+  check("!4 i8 b x h Xi4 c3", math.mininteger, 7, 1000, "abc")
+  check(">!8 b Xd d", 1, 2.5)
+  check("<s4 z B s1", "hello", "zz", 7, "")
+  check("!2 b s2 h z i4", 1, "ab", 2, "xyz", 3)
+  check("")
+
+  local p = string.packer("<i4 i4")
+  checkerror("too short", p.unpack, p, "abc")
+  checkerror("too short", p.unpackinto, p, {}, "abcdefg", 2)
+  checkerror("out of string", p.unpack, p, "abcdefgh", 10)
+  checkerror("number expected", p.pack, p, 1)
+  checkerror("table expected", p.unpackinto, p, "abcdefgh")
+  checkerror("invalid format option 'y'", string.packer, "i4y")
+  checkerror("invalid next option", string.packer, "Xz")
+  checkerror("variable%-length", string.packer("z").size, string.packer("z"))
+  assert(select("#", p:unpack(pack("<i4 i4 i4", 1, 2, 3), 5)) == 3)
+  local t = setmetatable({}, {__newindex = function (t, k, v)
+    rawset(t, k, v * 10) end})
+  assert(p:unpackinto(t, pack("<i4 i4", 1, 2)) == 9 and t[1] == 10)
+end
+
 print "OK"
 
@@ -237,5 +237,93 @@ for p, c in string.gmatch(x, "()(" .. utf8.charpattern .. ")") do
   end
 end
 
+
+do  print("testing offsets in long strings")
+  -- reference implementation of 'utf8.offset'
+  local function offset (s, n, i)
+    i = i or (n >= 0 and 1 or #s + 1)
+    local function iscont (p) return (s:byte(p) or 0) & 0xC0 == 0x80 end
+    if n > 0 then
+      n = n - 1
+      while n > 0 and i <= #s do
+        repeat i = i + 1 until not iscont(i)
+        n = n - 1
+      end
+    else
+      while n < 0 and i > 1 do
+        repeat i = i - 1 until i == 1 or not iscont(i)
+        n = n + 1
+      end
+    end
+    if n == 0 then return i else return nil end
+  end
+
+  local function checkoffsets (s)
+    local l = utf8.len(s, 1, -1, true) or #s
+    local function iscont (p) return (s:byte(p) or 0) & 0xC0 == 0x80 end
+    for i = -l - 2, l + 2, 7 do
+      if i <= 0 or not iscont(1) then
+        assert(utf8.offset(s, i) == offset(s, i))
+      end
+    end
+    for p = 1, #s + 1, 5 do
+      if not iscont(p) then
+        for _, n in ipairs{1, 2, 33, 100, -1, -2, -33, -100, l, -l} do
+          assert(utf8.offset(s, n, p) == offset(s, n, p))
+        end
+      end
+    end
+  end
+
+  checkoffsets(string.rep("ação €", 200))
+  checkoffsets(string.rep("x", 1000))
+  checkoffsets(string.rep("𦧺\x80\xff", 100))    -- invalid sequences
+  local s = "\x80\x80" .. string.rep("日本語 ", 100)
+  checkoffsets(s)
+  assert(utf8.offset(s, -401) == 1 and not utf8.offset(s, -402))
+  checkerror("continuation byte", utf8.offset, s, 1)
+
+  -- many strings, beyond the capacity of the index cache
+  for i = 1, 40 do
+    local s = string.rep("á", 200 + i) .. "x"
+    assert(utf8.offset(s, -1) == #s and utf8.offset(s, 201 + i) == #s)
+    assert(utf8.offset(s, 100) == 199 and utf8.offset(s, 100, 3) == 201)
+  end
+
+  -- huge counts; lookups across collections of the cache
+  local s = string.rep("ação €", 100)
+  for _ = 1, 3 do
+    assert(not utf8.offset(s, math.maxinteger))
+    assert(not utf8.offset(s, math.mininteger))
+    assert(utf8.offset(s, -600) == 1 and utf8.offset(s, 601) == #s + 1)
+    assert(utf8.offset(s, 300) == offset(s, 300))
+    collectgarbage()
+  end
+
+  -- the index survives collections
+  local _, cache = require"debug".getupvalue(utf8.offset, 1)
+  s = string.rep("ação €", 101)
+  assert(utf8.offset(s, 100) == offset(s, 100))   -- just marks 's'
+  assert(cache[s] == true)
+  assert(utf8.offset(s, 200) == offset(s, 200))   -- builds index
+  collectgarbage()
+  assert(type(cache[s]) == "userdata")
+  assert(utf8.offset(s, 300) == offset(s, 300))
+
+  -- word-at-a-time counting
+  for i = 0, 40 do
+    local s = string.rep("a", i) .. "ç" .. string.rep("b", i)
+    assert(utf8.len(s) == 2 * i + 1)
+    for j = 1, #s do
+      if j ~= i + 2 then
+        assert(utf8.len(s, j) == utf8.len(s:sub(j)))
+        assert(utf8.len(s, 1, j) == utf8.len(s:sub(1, j)) or j == i + 1)
+      end
+    end
+    local s = string.rep("a", i) .. "\xff" .. string.rep("b", i)
+    assert(select(2, utf8.len(s)) == i + 1)
+  end
+end
+
 print'ok'
 
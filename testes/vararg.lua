@@ -147,5 +147,99 @@ do
   local a, b = g()
   assert(a == nil and b == 2)
 end
+
+
+do   print("testing varargs passed in place")
+  local function checkerror (msg, f, ...)
+    local st, err = pcall(f, ...)
+    assert(not st and string.find(err, msg))
+  end
+  local function pack (...) return {n = select('#', ...), ...} end
+  local function eqpack (t, ...)
+    local t1 = table.pack(...)
+    if t.n ~= t1.n then return false end
+    for i = 1, t.n do if t[i] ~= t1[i] then return false end end
+    return true
+  end
+
+  -- forwarding in tail calls
+  local function fwd (...) return pack(...) end
+  local function fwd2 (...) return fwd(...) end
+  assert(eqpack(fwd()))
+  assert(eqpack(fwd(nil), nil))
+  assert(eqpack(fwd2(1, nil, 3, nil), 1, nil, 3, nil))
+  local t = {}
+  for i = 1, 500 do t[i] = i end
+  assert(eqpack(fwd2(table.unpack(t)), table.unpack(t)))
+
+  -- forwarding with upvalues to be closed
+  local function fwdclose (...)
+    local x = {...}
+    local function f (...) return x, ... end
+    return f(...)
+  end
+  local x, a, b = fwdclose(10, 20)
+  assert(x[1] == 10 and x[2] == 20 and a == 10 and b == 20)
+  local function selclose (...)
+    local x = ...
+    local function f () return x end
+    return f, select(2, ...)
+  end
+  local function countclose (...)
+    local x = ...
+    local function f () x = x + 1; return x end
+    f()
+    return select('#', ...)
+  end
+  assert(countclose(1, 2, 3) == 3)
+  local f, a, b = selclose(10, 20, 30)
+  assert(f() == 10 and a == 20 and b == 30)
+
+  -- errors through forwarded calls
+  local function fwderr (...) return error(...) end
+  local st, msg = pcall(fwderr, "xuxu", 0)
+  assert(not st and msg == "xuxu")
+  local function bad (...) local x = ... .. {} end
+  local function fwdbad (...) return bad(...) end
+  st, msg = pcall(fwdbad, "a")
+  assert(not st and string.find(msg, "concatenate"))
+
+  -- 'select' on varargs
+  local function sel (n, ...) return select(n, ...) end
+  local function selall (...) return {select(1, ...)} end
+  local function sel2 (...) local a, b, c = select(2, ...); return a, b, c end
+  local function count (...) return select('#', ...) end
+  local function count1 (...) local n = select('#', ...); return n end
+  assert(count() == 0 and count(nil, nil) == 2 and count1(1, 2, 3) == 3)
+  assert(count(table.unpack(t)) == 500 and count1(table.unpack(t)) == 500)
+  assert(eqpack(table.pack(sel(1))))
+  assert(eqpack(table.pack(sel(1, 1, 2, 3)), 1, 2, 3))
+  assert(eqpack(table.pack(sel(3, 1, 2, 3)), 3))
+  assert(eqpack(table.pack(sel(4, 1, 2, 3))))
+  assert(eqpack(table.pack(sel(-1, 1, 2, 3)), 3))
+  assert(eqpack(table.pack(sel(-3, 1, 2, 3)), 1, 2, 3))
+  assert(eqpack(table.pack(sel(2.0, 1, 2, 3)), 2, 3))
+  assert(eqpack(table.pack(sel("2", 1, 2, 3)), 2, 3))
+  assert(eqpack(table.pack(sel("#x", 1, 2, 3)), 3))
+  assert(eqpack(table.pack(sel2(1, 2, 3, 4)), 2, 3, 4))
+  assert(eqpack(table.pack(sel2(1, 2)), 2, nil, nil))
+  assert(#selall(table.unpack(t)) == 500)
+  assert(eqpack(table.pack(sel(400, table.unpack(t))), table.unpack(t, 400)))
+  checkerror("out of range", sel, 0, 1, 2)
+  checkerror("out of range", sel, -4, 1, 2, 3)
+  checkerror("number expected", sel, "x", 1, 2, 3)
+  checkerror("integer representation", sel, 1.5, 1, 2, 3)
+  -- explicit arguments
+  assert(select(-1, 1, 2, 3) == 3 and select('#', 1, nil) == 2)
+  assert(eqpack(table.pack(select(2, 1, 2, 3)), 2, 3))
+
+  -- same results with hooks
+  local debug = require"debug"
+  debug.sethook(function () end, "c")
+  assert(eqpack(fwd2(1, nil, 3), 1, nil, 3))
+  assert(count(1, 2) == 2 and sel(2, 1, 2, 3) == 2)
+  debug.sethook()
+end
+
 print('OK')
 
@@ -0,0 +1,106 @@
+-- $Id: testes/vmstats.lua $
+-- See Copyright Notice in file all.lua
+
+print "testing execution statistics"
+
+local vmstats = require"vmstats"
+local debug = require"debug"
+
+local function checkerror (msg, f, ...)
+  local s, err = pcall(f, ...)
+  assert(not s and string.find(err, msg))
+end
+
+
+if not vmstats.enabled then
+  checkerror("not available", vmstats.opcodes)
+  checkerror("not available", vmstats.report)
+  print "vmstats not available; skipping tests"
+  print "OK"
+  return
+end
+
+
+local function sum (n)
+  local s = 0
+  for i = 1, n do s = s + i end
+  return s
+end
+
+local function caller (n)
+  for _ = 1, n do sum(10) end
+end
+
+
+do   -- opcode counters
+  vmstats.reset()
+  local t = vmstats.opcodes()
+  assert(t.FORLOOP == nil)
+  sum(1000)
+  t = vmstats.opcodes()
+  assert(t.FORLOOP >= 1000 and t.ADD >= 1000 and t.FORPREP >= 1)
+  assert(t.NOSUCHOPCODE == nil)
+  vmstats.reset()
+  t = vmstats.opcodes()
+  assert(t.FORLOOP == nil and t.ADD == nil)
+end
+
+
+do   -- hot instructions
+  vmstats.reset()
+  sum(5000)
+  local h = vmstats.hot(2)
+  assert(#h == 2)
+  local line = debug.getinfo(sum, "S").linedefined + 2
+  table.sort(h, function (a, b) return a.pc < b.pc end)
+  assert(h[1].count == 5000 and h[1].op == "ADD" and h[1].line == line)
+  assert(h[2].count == 5000 and h[2].op == "FORLOOP" and h[2].line == line)
+  assert(h[1].pc < h[2].pc and string.find(h[1].source, "vmstats.lua"))
+  assert(#vmstats.hot() <= 10)
+  checkerror("out of range", vmstats.hot, 0)
+  checkerror("out of range", vmstats.hot, 1e6)
+end
+
+
+do   -- call counters
+  vmstats.reset()
+  caller(100)
+  local c = vmstats.calls(2)
+  assert(#c == 2)
+  assert(c[1].count == 100 and c[1].line == debug.getinfo(sum, "S").linedefined)
+  assert(c[2].count == 1 and c[2].line == debug.getinfo(caller, "S").linedefined)
+  assert(c[1].pc == nil and c[1].op == nil)
+  -- tail calls are counted too
+  vmstats.reset()
+  local function tail (n) return sum(n) end
+  for i = 1, 10 do tail(i) end
+  c = vmstats.calls(1)
+  assert(c[1].count == 10)
+end
+
+
+do   -- counters of loaded binary chunks and coroutines
+  local f = load(string.dump(sum, true))
+  vmstats.reset()
+  local co = coroutine.wrap(function (n)
+    for i = 1, n do f(10); coroutine.yield(i) end
+  end)
+  for i = 1, 7 do assert(co(7) == i) end
+  local c = vmstats.calls(2)
+  assert(c[1].count == 7 and c[2].count == 1)
+  local h = vmstats.hot(1)
+  assert(h[1].count == 70 and h[1].line == -1)   -- no line information
+end
+
+
+do   -- report
+  vmstats.reset()
+  caller(20)
+  local r = vmstats.report(3)
+  assert(string.find(r, "^instructions executed: %d+\n"))
+  assert(string.find(r, "\nopcodes:\n.*%s200 .*ADD\n"))
+  assert(string.find(r, "\nhot instructions:\n.*%s200 .*%] ADD\n"))
+  assert(string.find(r, "\nmost called functions:\n%s+20 .*vmstats.lua:%d+\n"))
+end
+
+print "OK"